@@ -95,6 +95,13 @@ enum gbms_property {
 	GBMS_PROP_BATT_ID,              /* GBMS battery id */
 };
 
+/*
+ * Or'ed to the property in power_supply_get_property() to read the device,
+ * skipping the property cache of the provider. Providers that support it
+ * clear the flag, the others return -EINVAL: see GPSY_GET_INT_PROP_UNCACHED().
+ */
+#define GBMS_PROP_UNCACHED	0x10000
+
 union gbms_propval {
 	union power_supply_propval prop;
 	int64_t int64val;
@@ -1233,6 +1233,9 @@ static int __init gbms_storage_init(void)
 
 	pr_info("initialize gbms_storage\n");
 
+	/* BMS workqueues are in the same module */
+	gbms_wq_init();
+
 	spin_lock_init(&providers_lock);
 
 	mutex_init(&bee_lock);
@@ -1346,6 +1349,8 @@ static void __exit gbms_storage_exit(void)
 	}
 
 	gbms_providers_count = 0;
+
+	gbms_wq_exit();
 }
 
 module_init(gbms_storage_init);
@@ -233,6 +233,28 @@ enum bpst_batt_status {
 	BPST_BATT_CELL_FAULT = 3,
 };
 
+/*
+ * Streaming single battery disconnect detector: losing one of the parallel
+ * cells roughly doubles the pack resistance seen as dV/dI on current steps.
+ * r_base and r_fast are EWMAs of dV/dI in mOhm << BPST_DET_R_SHIFT, cusum is
+ * a one sided CUSUM on r_fast/r_base in 1/256 units. The cell resistance
+ * depends on temperature: the baseline is valid for one session and for
+ * temp_base only.
+ */
+struct batt_bpst_det {
+	bool last_valid;
+	int vbatt_last;
+	int ibatt_last;
+	s64 last_ms;
+	int temp_base;
+	u32 samples;
+	u32 rejected;
+	s32 r_base;
+	s32 r_fast;
+	s32 cusum;
+	u32 trips;
+};
+
 struct batt_bpst {
 	struct mutex lock;
 	bool bpst_enable;
@@ -243,6 +265,8 @@ struct batt_bpst {
 	int bpst_count_threshold;
 	int bpst_chg_rate;
 	u8 bpst_count;
+	bool bpst_count_valid;
+	struct batt_bpst_det det;
 };
 
 #define DEV_SN_LENGTH 20
@@ -273,6 +297,23 @@ enum batt_aacr_state {
 	BATT_AACR_MAX,
 };
 
+/*
+ * AACR capacity for the last cycle count, one entry per algo. An entry is
+ * valid only for the cycle count and grace/max it was computed with, the
+ * entries are dropped when the FullCapNom sampled from the gauge changes.
+ */
+struct batt_aacr_cache {
+	spinlock_t lock;
+	int full_cap_nom;	/* mAh, last sampled */
+	int cycle_count;
+	int cycle_grace;
+	int cycle_max;
+	int capacity[BATT_AACR_MAX];
+	bool valid[BATT_AACR_MAX];
+	u32 hits;
+	u32 misses;
+};
+
 #define BATT_TEMP_RECORD_THR 3
 /* discharge saved after charge */
 #define SD_CHG_START 0
@@ -400,7 +441,84 @@ struct power_metrics {
 	unsigned int interval;
 	unsigned int idx;
 	struct power_metrics_data data[POWER_METRICS_MAX_DATA];
-	struct delayed_work work;
+	struct gbms_delayed_work work;
+};
+
+/*
+ * Energy integrator: charge counter and voltage sampled every rate_ms and
+ * integrated in 64 bit running totals. Charge is in uAh (mAh in Q.3 decimal),
+ * energy is in uAh * uV = pWh (mWh in Q.9 decimal). The totals are
+ * checkpointed every ckpt_s in a ring: the difference of two checkpoints
+ * (prefix sums) is the charge and energy in the window between them.
+ */
+#define BATT_ENERGY_RATE_DEFAULT_MS	5000
+#define BATT_ENERGY_RATE_MIN_MS		1000
+#define BATT_ENERGY_CKPT_DEFAULT_S	60
+#define BATT_ENERGY_CKPT_MAX		32
+/* drop the sample when the charge counter jumps (e.g. model reload) */
+#define BATT_ENERGY_MAX_DELTA_UAH	500000
+
+/*
+ * Layout of the *_bin attributes: a header followed by fixed width records
+ * filled field by field from the internal structs. Bump the version on any
+ * change to a record.
+ */
+#define BATT_ATTR_BIN_VERSION	4
+
+struct batt_attr_bin_hdr {
+	u32 version;
+	u32 seq;		/* bumped on every snapshot */
+	u32 count;		/* number of records after the header */
+	u32 rec_size;
+};
+
+enum batt_energy_src {
+	BATT_ENERGY_SRC_NONE = 0,	/* not connected */
+	BATT_ENERGY_SRC_WIRED,
+	BATT_ENERGY_SRC_WLC,
+	BATT_ENERGY_SRC_DC,
+	BATT_ENERGY_SRC_EXT,		/* dock, pogo */
+	BATT_ENERGY_SRC_COUNT,
+};
+
+struct batt_energy_totals {
+	u64 time_ms;			/* boottime of the last sample */
+	u64 chg_in_uah;
+	u64 chg_out_uah;
+	u64 nrg_in_pwh;
+	u64 nrg_out_pwh;
+	u64 src_nrg_in_pwh[BATT_ENERGY_SRC_COUNT];
+	u64 src_nrg_out_pwh[BATT_ENERGY_SRC_COUNT];
+} __packed;
+
+/*
+ * Layout of energy_bin, ckpt[] is a ring of hdr.count records and ckpt_next
+ * is the oldest. hdr.seq is the number of checkpoints taken.
+ */
+struct batt_energy_bin {
+	struct batt_attr_bin_hdr hdr;
+	u32 rate_ms;
+	u32 ckpt_s;
+	u32 ckpt_count;			/* total checkpoints taken */
+	u32 ckpt_next;
+	struct batt_energy_totals now;
+	struct batt_energy_totals ckpt[BATT_ENERGY_CKPT_MAX];
+} __packed;
+
+struct batt_energy {
+	struct mutex lock;
+	struct gbms_delayed_work work;
+	u32 rate_ms;
+	u32 ckpt_s;
+
+	/* previous sample */
+	bool prev_valid;
+	int prev_cc;
+	int prev_vbat;
+
+	u32 dropped;
+	u64 ckpt_last_ms;
+	struct batt_energy_bin bin;
 };
 
 #define CSI_THERMAL_SEVERITY_MAX 5
@@ -453,6 +571,141 @@ struct batt_temp_filter {
 	int last_idx;
 };
 #define NB_FAN_BT_LIMITS 4
+
+/* sysfs attributes with read latency accounting */
+enum batt_attr_lat_idx {
+	BATT_ATTR_CHG_STATS = 0,
+	BATT_ATTR_CHG_STATS_BIN,
+	BATT_ATTR_CHG_DETAILS,
+	BATT_ATTR_CHG_DETAILS_BIN,
+	BATT_ATTR_SSOC_DETAILS,
+	BATT_ATTR_SSOC_DETAILS_BIN,
+	BATT_ATTR_HEALTH_INDEX_STATS,
+	BATT_ATTR_HEALTH_INDEX_STATS_BIN,
+
+	BATT_ATTR_LAT_COUNT,
+};
+
+struct batt_attr_lat {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+};
+
+/*
+ * Copy of a charge event taken in a short critical section and formatted
+ * after the lock is released (ce.chg_profile is cleared in the copy).
+ * Internal only, the *_bin attributes export the batt_bin_* records.
+ */
+struct batt_ce_snapshot {
+	u32 valid;
+	u32 capacity;			/* aacr_filtered_capacity() */
+	struct batt_chg_health chg_health;	/* of the current session */
+	struct gbms_charging_event ce;
+};
+
+struct batt_ce_snapshots {
+	u32 seq;			/* bumped on every snapshot */
+	u32 count;
+	struct batt_ce_snapshot rec[2];	/* current (details only), qual */
+};
+
+#define BATT_BIN_MSC_COUNT	20
+#define BATT_BIN_TIER_COUNT	3
+#define BATT_BIN_SOC_LEN	101
+
+/* struct gbms_ce_tier_stats */
+struct batt_bin_tier {
+	s8 temp_idx;
+	s8 vtier_idx;
+	s16 soc_in;		/* 8.8 */
+	u16 cc_in;
+	u16 cc_total;
+	u32 time_fast;
+	u32 time_taper;
+	u32 time_other;
+	s16 temp_in;
+	s16 temp_min;
+	s16 temp_max;
+	s16 ibatt_min;
+	s16 ibatt_max;
+	u16 icl_min;
+	u16 icl_max;
+	u16 reserved;
+	s64 icl_sum;
+	s64 temp_sum;
+	s64 ibatt_sum;
+	u32 sample_count;
+	u16 msc_cnt[BATT_BIN_MSC_COUNT];
+	u32 msc_elap[BATT_BIN_MSC_COUNT];
+} __packed;
+
+/* struct batt_chg_health and a summary of its plan */
+struct batt_bin_health {
+	s32 rest_soc;
+	s32 rest_voltage;
+	s32 always_on_soc;
+	s32 rest_rate;
+	s32 rest_rate_before_trigger;
+	s32 rest_state;
+	s32 rest_cc_max;
+	s32 rest_fv_uv;
+	s64 rest_deadline;
+	s64 dry_run_deadline;
+	s64 active_time;
+	u32 plan_valid;
+	u32 plan_nb_seg;
+	u32 plan_replan_count;
+	u32 plan_check_count;
+	s64 plan_planned_at;
+	s64 plan_ttf;
+} __packed;
+
+enum batt_bin_ce_stats {
+	BATT_BIN_CE_HEALTH = 0,
+	BATT_BIN_CE_HEALTH_PAUSE,
+	BATT_BIN_CE_HEALTH_DRYRUN,
+	BATT_BIN_CE_FULL_CHARGE,
+	BATT_BIN_CE_HIGH_SOC,
+	BATT_BIN_CE_OVERHEAT,
+	BATT_BIN_CE_CC_LVL,
+	BATT_BIN_CE_TRICKLE,
+	BATT_BIN_CE_TEMP_FILTER,
+
+	BATT_BIN_CE_STATS_COUNT,
+};
+
+/* record of charge_stats_bin and charge_details_bin */
+struct batt_bin_ce {
+	u32 valid;
+	u32 capacity;			/* aacr_filtered_capacity() */
+	u32 adapter_details;
+	u16 voltage_in;
+	u16 ssoc_in;
+	u16 cc_in;
+	u16 voltage_out;
+	u16 ssoc_out;
+	u16 cc_out;
+	s32 last_soc;
+	u32 bd_clear_trickle;
+	s64 first_update;
+	s64 last_update;
+	struct batt_bin_health ce_health;	/* set on close */
+	struct batt_bin_health chg_health;	/* current session, details */
+	struct batt_bin_tier tier_stats[BATT_BIN_TIER_COUNT];
+	struct batt_bin_tier stats[BATT_BIN_CE_STATS_COUNT];
+	u8 soc_ti[BATT_BIN_SOC_LEN];
+	u8 reserved;
+	u16 soc_cc[BATT_BIN_SOC_LEN];
+	u16 reserved2;
+	u32 soc_elap[BATT_BIN_SOC_LEN];
+} __packed;
+
+struct batt_bin_ce_snapshot {
+	struct batt_attr_bin_hdr hdr;
+	struct batt_bin_ce rec[2];	/* current (details only), qual */
+} __packed;
+
 /* battery driver state */
 struct batt_drv {
 	struct device *device;
@@ -463,7 +716,7 @@ struct batt_drv {
 	struct notifier_block fg_nb;
 
 	struct delayed_work init_work;
-	struct delayed_work batt_work;
+	struct gbms_delayed_work batt_work;
 
 	struct wakeup_source *msc_ws;
 	struct wakeup_source *batt_ws;
@@ -545,11 +798,27 @@ struct batt_drv {
 	int msc_state;
 	int msc_irdrop_state;
 	struct mutex stats_lock;
-	struct gbms_charging_event ce_data;
-	struct gbms_charging_event ce_qual;
+	struct gbms_charging_event ce_event[3];
+	struct gbms_charging_event *ce_data;	/* in ce_event[], stats_lock */
+	struct gbms_charging_event __rcu *ce_qual; /* ce_pub or NULL */
+	struct gbms_charging_event *ce_pub;	/* last published, stats_lock */
+	struct gbms_charging_event *ce_spare;	/* reused after a grace period */
+	struct rcu_head ce_spare_rcu;
+	bool ce_spare_ready;
 	uint32_t chg_sts_qual_time;
 	uint32_t chg_sts_delta_soc;
 
+	/* read latency of the stats attributes */
+	spinlock_t attr_lat_lock;
+	struct batt_attr_lat attr_lat[BATT_ATTR_LAT_COUNT];
+	/* preallocated snapshots for charge_stats, charge_details, ttf_details */
+	struct mutex attr_snap_lock;
+	struct batt_ce_snapshots attr_snap;
+	/* charge_stats_bin, charge_details_bin: filled on pos 0 for filp */
+	struct batt_bin_ce_snapshot attr_bin[2];
+	const struct file *attr_bin_filp[2];
+	struct batt_ttf_stats attr_ttf;
+
 	/* health charge margin time */
 	int health_safety_margin;
 
@@ -595,6 +864,7 @@ struct batt_drv {
 	int aacr_cycle_grace;
 	int aacr_cycle_max;
 	int aacr_algo;
+	struct batt_aacr_cache aacr_cache;
 
 	/* BHI: updated on disconnect, EOC */
 	struct health_data health_data;
@@ -612,6 +882,7 @@ struct batt_drv {
 
 	/* battery power metrics */
 	struct power_metrics power_metrics;
+	struct batt_energy energy;
 
 	/* battery pack status */
 	struct batt_bpst bpst_state;
@@ -750,7 +1021,7 @@ static int psy_changed(struct notifier_block *nb,
 
 	if (action == PSY_EVENT_PROP_CHANGED &&
 	    (!strcmp(psy->desc->name, batt_drv->fg_psy_name))) {
-		mod_delayed_work(system_wq, &batt_drv->batt_work, 0);
+		gbms_mod_delayed_work(&batt_drv->batt_work, 0);
 	}
 
 	return NOTIFY_OK;
@@ -1516,7 +1787,7 @@ static void batt_rl_update_status(struct batt_drv *batt_drv)
 
 static void bat_log_ttf_change(ktime_t estimate, int max_ratio, struct batt_drv *batt_drv)
 {
-	const struct gbms_charging_event *ce_data = &batt_drv->ce_data;
+	const struct gbms_charging_event *ce_data = batt_drv->ce_data;
 	char buff[LOG_BUFFER_ENTRY_SIZE];
 	long elap, ibatt_avg, icl_avg;
 	int i, len = 0;
@@ -1594,7 +1865,7 @@ static int batt_ttf_estimate(ktime_t *res, struct batt_drv *batt_drv)
 	 * negative return value (usually) means data corruption
 	 */
 	rc = ttf_soc_estimate(&estimate, &batt_drv->ttf_stats,
-			      &batt_drv->ce_data, soc_raw, raw_full);
+			      batt_drv->ce_data, soc_raw, raw_full);
 	if (rc < 0)
 		estimate = -1;
 	else
@@ -1646,14 +1917,14 @@ static void cev_stats_init(struct gbms_charging_event *ce_data,
 static void batt_chg_stats_start(struct batt_drv *batt_drv)
 {
 	union gbms_ce_adapter_details ad;
-	struct gbms_charging_event *ce_data = &batt_drv->ce_data;
+	struct gbms_charging_event *ce_data = batt_drv->ce_data;
 	const ktime_t now = get_boot_sec();
 	int vin, cc_in;
 
 	mutex_lock(&batt_drv->stats_lock);
-	ad.v = batt_drv->ce_data.adapter_details.v;
+	ad.v = batt_drv->ce_data->adapter_details.v;
 	cev_stats_init(ce_data, &batt_drv->chg_profile);
-	batt_drv->ce_data.adapter_details.v = ad.v;
+	batt_drv->ce_data->adapter_details.v = ad.v;
 
 	vin = GPSY_GET_PROP(batt_drv->fg_psy, POWER_SUPPLY_PROP_VOLTAGE_NOW);
 	ce_data->charging_stats.voltage_in = (vin < 0) ? -1 : vin / 1000;
@@ -1675,7 +1946,7 @@ static void batt_chg_stats_start(struct batt_drv *batt_drv)
 /* call holding stats_lock */
 static bool batt_chg_stats_qual(const struct batt_drv *batt_drv)
 {
-	const struct gbms_charging_event *ce_data = &batt_drv->ce_data;
+	const struct gbms_charging_event *ce_data = batt_drv->ce_data;
 	const long elap = ce_data->last_update - ce_data->first_update;
 	const long ssoc_delta = ce_data->charging_stats.ssoc_out -
 				ce_data->charging_stats.ssoc_in;
@@ -1718,7 +1989,7 @@ static void batt_chg_stats_update(struct batt_drv *batt_drv, int temp_idx,
 {
 	const int soc_real = ssoc_get_real(&batt_drv->ssoc_state);
 	const int msc_state = batt_drv->msc_state; /* last msc_state */
-	struct gbms_charging_event *ce_data = &batt_drv->ce_data;
+	struct gbms_charging_event *ce_data = batt_drv->ce_data;
 	struct gbms_ce_tier_stats *tier = NULL;
 	int cc, soc_in;
 
@@ -1939,7 +2210,7 @@ static bool batt_chg_stats_close(struct batt_drv *batt_drv,
 	 * NOTE: vbatt_idx != -1 -> temp_idx != -1
 	 */
 	if (batt_drv->vbatt_idx != -1 && batt_drv->temp_idx != -1) {
-		const ktime_t elap = now - batt_drv->ce_data.last_update;
+		const ktime_t elap = now - batt_drv->ce_data->last_update;
 		const int tier_idx = batt_chg_vbat2tier(batt_drv->vbatt_idx);
 		int ibatt, temp, rc = 0;
 
@@ -1955,33 +2226,30 @@ static bool batt_chg_stats_close(struct batt_drv *batt_drv,
 		batt_chg_stats_update(batt_drv,
 				      batt_drv->temp_idx, tier_idx,
 				      ibatt / 1000, temp, elap);
-		batt_drv->ce_data.last_update = now;
+		batt_drv->ce_data->last_update = now;
 	}
 
 	/* record the closing in data (and qual) */
-	batt_drv->ce_data.charging_stats.voltage_out =
+	batt_drv->ce_data->charging_stats.voltage_out =
 				(vout < 0) ? -1 : vout / 1000;
-	batt_drv->ce_data.charging_stats.ssoc_out =
+	batt_drv->ce_data->charging_stats.ssoc_out =
 				ssoc_get_capacity(&batt_drv->ssoc_state);
-	batt_drv->ce_data.charging_stats.cc_out =
+	batt_drv->ce_data->charging_stats.cc_out =
 				(cc_out < 0) ? -1 : cc_out / 1000;
 
 	/* close/fix heath charge data (if enabled) */
-	memcpy(&batt_drv->ce_data.ce_health, &batt_drv->chg_health,
-	       sizeof(batt_drv->ce_data.ce_health));
-	batt_drv->ce_data.health_stats.vtier_idx =
+	memcpy(&batt_drv->ce_data->ce_health, &batt_drv->chg_health,
+	       sizeof(batt_drv->ce_data->ce_health));
+	batt_drv->ce_data->health_stats.vtier_idx =
 				batt_chg_health_vti(&batt_drv->chg_health);
-	batt_drv->ce_data.health_dryrun_stats.vtier_idx =
+	batt_drv->ce_data->health_dryrun_stats.vtier_idx =
 		(now > dry_run_deadline) ? GBMS_STATS_AC_TI_V2_PREDICT_SUCCESS :
 						 GBMS_STATS_AC_TI_V2_PREDICT;
 
 	/* TODO: add a field to ce_data to qual weird charge sessions */
 	publish = force || batt_chg_stats_qual(batt_drv);
 	if (publish) {
-		struct gbms_charging_event *ce_qual = &batt_drv->ce_qual;
-
-		/* all charge tiers including health */
-		memcpy(ce_qual, &batt_drv->ce_data, sizeof(*ce_qual));
+		const struct gbms_charging_event *ce_qual = batt_drv->ce_data;
 
 		pr_info("MSC_STAT %s: elap=%lld ssoc=%d->%d v=%d->%d c=%d->%d hdl=%lld hrs=%d hti=%d/%d\n",
 			reason,
@@ -2067,23 +2335,86 @@ static void bat_log_chg_stats(struct logbuffer *log,
 	}
 }
 
+static void batt_chg_stats_spare_release(struct rcu_head *head)
+{
+	struct batt_drv *batt_drv =
+		container_of(head, struct batt_drv, ce_spare_rcu);
+
+	WRITE_ONCE(batt_drv->ce_spare_ready, true);
+}
+
+/*
+ * Publish the (closed) ce_data as ce_qual, call holding stats_lock with
+ * ce_spare_ready set. ce_qual readers use RCU and never take stats_lock.
+ * When the charging session ends ce_data is published as is and the spare
+ * buffer becomes the new ce_data (no copy). A session that continues after
+ * publish (ex. at 100%) copies ce_data into the spare buffer and publishes
+ * the copy. ce_qual is replaced, never cleared, and the previous published
+ * buffer becomes the spare once the readers that might hold it are gone.
+ */
+static struct gbms_charging_event *batt_chg_stats_publish(struct batt_drv *batt_drv,
+							  bool session_end)
+{
+	struct gbms_charging_event *ce_data = batt_drv->ce_data;
+	struct gbms_charging_event *ce_next = batt_drv->ce_spare;
+	struct gbms_charging_event *ce_qual;
+	union gbms_ce_adapter_details ad;
+
+	if (!session_end) {
+		memcpy(ce_next, ce_data, sizeof(*ce_next));
+		ce_qual = ce_next;
+	} else {
+		ad.v = ce_data->adapter_details.v;
+		cev_stats_init(ce_next, &batt_drv->chg_profile);
+		ce_next->adapter_details.v = ad.v;
+		batt_drv->ce_data = ce_next;
+		ce_qual = ce_data;
+	}
+
+	rcu_assign_pointer(batt_drv->ce_qual, ce_qual);
+	batt_drv->ce_spare = batt_drv->ce_pub;
+	batt_drv->ce_pub = ce_qual;
+
+	WRITE_ONCE(batt_drv->ce_spare_ready, false);
+	call_rcu(&batt_drv->ce_spare_rcu, batt_chg_stats_spare_release);
+
+	return ce_qual;
+}
+
 /* End of charging: close stats, qualify event publish data */
 static void batt_chg_stats_pub(struct batt_drv *batt_drv, char *reason,
-			       bool force, bool skip_uevent)
+			       bool force, bool skip_uevent, bool session_end)
 {
+	struct gbms_charging_event *ce_data;
 	bool publish;
 
+	/*
+	 * The spare buffer is busy for a grace period after a publish, wait
+	 * for it without holding stats_lock (only back to back publish).
+	 */
 	mutex_lock(&batt_drv->stats_lock);
+	while (!READ_ONCE(batt_drv->ce_spare_ready)) {
+		mutex_unlock(&batt_drv->stats_lock);
+		rcu_barrier();
+		mutex_lock(&batt_drv->stats_lock);
+	}
+
 	publish = batt_chg_stats_close(batt_drv, reason, force);
+
+	/* log before publish, ce_data is recycled at the end of the session */
+	ce_data = batt_drv->ce_data;
+	bat_log_chg_stats(batt_drv->ttf_stats.ttf_log, ce_data);
+
 	if (publish) {
-		ttf_stats_update(&batt_drv->ttf_stats,
-				 &batt_drv->ce_qual, false);
+		struct gbms_charging_event *ce_qual;
+
+		ce_qual = batt_chg_stats_publish(batt_drv, session_end);
+		ttf_stats_update(&batt_drv->ttf_stats, ce_qual, false);
 
 		if (skip_uevent == false)
 			kobject_uevent(&batt_drv->device->kobj, KOBJ_CHANGE);
 	}
 
-	bat_log_chg_stats(batt_drv->ttf_stats.ttf_log, &batt_drv->ce_data);
 	mutex_unlock(&batt_drv->stats_lock);
 }
 
@@ -2485,7 +2816,7 @@ static void batt_init_csi_stat(struct batt_drv *batt_drv)
 
 static void batt_update_csi_stat(struct batt_drv *batt_drv)
 {
-	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data.adapter_details;
+	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data->adapter_details;
 	const int ssoc = ssoc_get_capacity(&batt_drv->ssoc_state);
 	struct csi_stats *csi_stats = &batt_drv->csi_stats;
 	struct power_supply *fg_psy = batt_drv->fg_psy;
@@ -2816,7 +3147,7 @@ static void batt_update_csi_status(struct batt_drv *batt_drv)
 	const bool is_hot = batt_drv->batt_temp >= profile->temp_limits[temp_hot_idx];
 	const bool is_trickle = batt_is_trickle(&batt_drv->ssoc_state);
 	const bool is_disconnected = chg_state_is_disconnected(&batt_drv->chg_state);
-	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data.adapter_details;
+	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data->adapter_details;
 
 	if (!batt_drv->csi_status_votable) {
 		batt_drv->csi_status_votable =
@@ -2903,7 +3234,7 @@ static int batt_calc_charging_speed(struct batt_drv *batt_drv)
 	vbatt_idx = ttf_pwr_vtier_idx(&batt_drv->ttf_stats, soc);
 
 	/* Wait 1 min to get avg_ibat */
-	ibatt = ttf_pwr_ibatt(&batt_drv->ce_data.tier_stats[vbatt_idx]);
+	ibatt = ttf_pwr_ibatt(&batt_drv->ce_data->tier_stats[vbatt_idx]);
 	if (ibatt == 0)
 		return -1;
 
@@ -2996,6 +3327,7 @@ static inline void batt_reset_rest_state(struct batt_chg_health *chg_health)
 
 	chg_health->dry_run_deadline = 0;
 	chg_health->active_time = 0;
+	chg_health->plan.valid = false;
 }
 
 /* should not reset rl state */
@@ -3308,10 +3640,35 @@ static enum chg_health_state msc_health_active(const struct batt_drv *batt_drv)
 #define HEALTH_PAUSE_DEBOUNCE 180
 #define HEALTH_PAUSE_MAX_SSOC 95
 #define HEALTH_PAUSE_TIME 3
+
+/*
+ * Index of the segment of the plan for state at now: the current one or the
+ * next one with that state, the last one with state if they all ended.
+ * Returns -1 when there is no plan or the plan doesn't have state.
+ */
+static int batt_health_plan_lookup(const struct batt_chg_health_plan *plan,
+				   ktime_t now, enum chg_health_state state)
+{
+	int i, idx = -1;
+
+	if (!plan->valid)
+		return -1;
+
+	for (i = 0; i < plan->nb_seg; i++) {
+		if (plan->seg[i].state != state)
+			continue;
+
+		idx = i;
+		if (i == plan->nb_seg - 1 || now < plan->seg[i + 1].start)
+			break;
+	}
+
+	return idx;
+}
 static bool msc_health_pause(struct batt_drv *batt_drv, const ktime_t ttf,
 			      const ktime_t now,
 			      const enum chg_health_state rest_state) {
-	const struct gbms_charging_event *ce_data = &batt_drv->ce_data;
+	const struct gbms_charging_event *ce_data = batt_drv->ce_data;
 	const struct gbms_ce_tier_stats	*h = &ce_data->health_stats;
 	struct batt_chg_health *rest = &batt_drv->chg_health;
 	const ktime_t deadline = rest->rest_deadline;
@@ -3355,9 +3712,21 @@ static bool msc_health_pause(struct batt_drv *batt_drv, const ktime_t ttf,
 	if (rest->active_time > (HEALTH_PAUSE_TIME * HEALTH_PAUSE_DEBOUNCE))
 		return false;
 
-	/* check if time meets the PAUSE condition or not */
-	if (ttf > 0 && deadline > now + ttf + safety_margin)
+	/*
+	 * check if time meets the PAUSE condition or not: the plan has the
+	 * time to resume charging, fall back to the estimate without a plan.
+	 */
+	if (rest->plan.valid) {
+		const struct batt_chg_health_plan *plan = &rest->plan;
+		const int idx = batt_health_plan_lookup(plan, now,
+							CHG_HEALTH_PAUSE);
+
+		if (idx >= 0 && idx < plan->nb_seg - 1 &&
+		    now < plan->seg[idx + 1].start)
+			return true;
+	} else if (ttf > 0 && deadline > now + ttf + safety_margin) {
 		return true;
+	}
 
 	/* record time for next pause check */
 	rest->active_time = elap_h;
@@ -3416,6 +3785,181 @@ static bool batt_health_set_chg_deadline(struct batt_chg_health *chg_health,
 	return new_deadline || rest_state != chg_health->rest_state;
 }
 
+static void batt_health_plan_seg(struct batt_chg_health_plan *plan,
+				 ktime_t start, enum chg_health_state state,
+				 int cc_max, int fv_uv)
+{
+	struct batt_chg_health_seg *seg;
+
+	if (plan->nb_seg >= CHG_HEALTH_PLAN_SEG_MAX)
+		return;
+
+	seg = &plan->seg[plan->nb_seg++];
+	seg->start = start;
+	seg->state = state;
+	seg->cc_max = cc_max;
+	seg->fv_uv = fv_uv;
+}
+
+/*
+ * Build the schedule for deadline from a ttf estimate: charge at the
+ * pre-trigger rate to the rest SOC, pause when there is enough slack before
+ * the deadline, then charge at the rest rate until full.
+ */
+static void batt_health_plan(const struct batt_drv *batt_drv,
+			     struct batt_chg_health_plan *plan,
+			     ktime_t deadline, ktime_t ttf, ktime_t now)
+{
+	const struct batt_chg_health *rest = &batt_drv->chg_health;
+	const struct gbms_chg_profile *profile = &batt_drv->chg_profile;
+	const int capacity_ma = batt_drv->battery_capacity;
+	const int fv_uv = profile->volt_limits[profile->volt_nb_limits - 1];
+	const int rest_cc_max = capacity_ma * rest->rest_rate * 10;
+	const ktime_t margin = (ktime_t)batt_drv->health_safety_margin;
+	const int ssoc = ssoc_get_capacity(&batt_drv->ssoc_state);
+	const int rest_soc = CHG_HEALTH_REST_SOC(rest);
+	ktime_t t = now, remaining = ttf, elap = 0;
+
+	plan->valid = ttf > 0;
+	plan->planned_at = now;
+	plan->deadline = deadline;
+	plan->ttf = ttf;
+	plan->charging_s = 0;
+	plan->last_tick = now;
+	plan->ssoc = ssoc;
+	plan->rest_rate = rest->rest_rate;
+	plan->rest_rate_before_trigger = rest->rest_rate_before_trigger;
+	plan->nb_seg = 0;
+	plan->replan_count += 1;
+	if (!plan->valid)
+		return;
+
+	if (rest_soc > ssoc && rest_soc <= SSOC_FULL) {
+		const qnum_t soc_raw = ssoc_get_real_raw(&batt_drv->ssoc_state);
+		int rc;
+
+		rc = ttf_soc_estimate(&elap, &batt_drv->ttf_stats,
+				      batt_drv->ce_data, soc_raw,
+				      qnum_fromint(rest_soc));
+		if (rc < 0 || elap > ttf)
+			elap = 0;
+
+		batt_health_plan_seg(plan, t, CHG_HEALTH_ENABLED, capacity_ma *
+				     rest->rest_rate_before_trigger * 10, -1);
+		t += elap;
+		remaining -= elap;
+	}
+
+	batt_health_plan_seg(plan, t, CHG_HEALTH_ACTIVE, rest_cc_max, fv_uv);
+
+	/* same conditions as msc_health_pause() */
+	if (rest->always_on_soc == -1 && margin > 0 && deadline > 0 &&
+	    rest_soc <= HEALTH_PAUSE_MAX_SSOC &&
+	    deadline > t + HEALTH_PAUSE_DEBOUNCE + remaining + margin) {
+		t += HEALTH_PAUSE_DEBOUNCE;
+		batt_health_plan_seg(plan, t, CHG_HEALTH_PAUSE, 0, -1);
+
+		t = deadline - remaining - margin;
+		batt_health_plan_seg(plan, t, CHG_HEALTH_ACTIVE, rest_cc_max,
+				     fv_uv);
+	}
+
+	batt_health_plan_seg(plan, t + remaining, CHG_HEALTH_DONE,
+			     rest_cc_max, fv_uv);
+}
+
+#define HEALTH_PLAN_TTF_ERR	300
+
+/* segments depend on the deadline and on the rates */
+static bool batt_health_plan_same(const struct batt_chg_health_plan *plan,
+				  const struct batt_chg_health *rest)
+{
+	return plan->deadline == rest->rest_deadline &&
+	       plan->rest_rate == rest->rest_rate &&
+	       plan->rest_rate_before_trigger == rest->rest_rate_before_trigger;
+}
+
+/*
+ * TTF for msc_logic_health() from the plan: time spent charging since
+ * the plan was made comes off the planned ttf, PAUSE doesn't. The real
+ * estimate runs only when ssoc changes and a replan happens when it is off
+ * by more than HEALTH_PLAN_TTF_ERR or when the deadline changed.
+ */
+static int batt_health_plan_ttf(struct batt_drv *batt_drv, ktime_t now,
+				ktime_t *ttf)
+{
+	struct batt_chg_health *rest = &batt_drv->chg_health;
+	struct batt_chg_health_plan *plan = &rest->plan;
+	const int ssoc = ssoc_get_capacity(&batt_drv->ssoc_state);
+	ktime_t projected = 0, estimate;
+	bool same;
+	int ret;
+
+	if (batt_drv->ssoc_state.buck_enabled != 1)
+		return -EINVAL;
+
+	/* 0 when full, -1 during debounce: nothing to plan */
+	if (ssoc == SSOC_FULL || batt_drv->ttf_debounce ||
+	    batt_drv->ttf_stats.ttf_fake != -1) {
+		plan->valid = false;
+		return batt_ttf_estimate(ttf, batt_drv);
+	}
+
+	if (plan->valid) {
+		if (rest->rest_state != CHG_HEALTH_PAUSE)
+			plan->charging_s += now - plan->last_tick;
+		plan->last_tick = now;
+
+		projected = max_t(ktime_t, plan->ttf - plan->charging_s, 1);
+		if (batt_health_plan_same(plan, rest) && plan->ssoc == ssoc) {
+			*ttf = projected;
+			return 0;
+		}
+	}
+
+	ret = batt_ttf_estimate(&estimate, batt_drv);
+	if (ret < 0)
+		return ret;
+
+	plan->check_count += 1;
+	same = batt_health_plan_same(plan, rest);
+	if (plan->valid && estimate > 0 && same &&
+	    abs(estimate - projected) <= HEALTH_PLAN_TTF_ERR) {
+		plan->ssoc = ssoc;
+		*ttf = projected;
+		return 0;
+	}
+
+	batt_health_plan(batt_drv, plan, rest->rest_deadline, estimate, now);
+	*ttf = estimate;
+	return 0;
+}
+
+static int batt_health_plan_cstr(char *buf, int size,
+				 const struct batt_chg_health_plan *plan,
+				 ktime_t now)
+{
+	int i, len = 0;
+
+	len += scnprintf(&buf[len], size - len,
+			 "valid=%d planned_at=%lld deadline=%lld ttf=%lld replan=%u check=%u\n",
+			 plan->valid, plan->planned_at, plan->deadline,
+			 plan->ttf, plan->replan_count, plan->check_count);
+
+	for (i = 0; i < plan->nb_seg; i++) {
+		const struct batt_chg_health_seg *seg = &plan->seg[i];
+		const bool cur = now >= seg->start &&
+			(i == plan->nb_seg - 1 || now < plan->seg[i + 1].start);
+
+		len += scnprintf(&buf[len], size - len,
+				 "%c%lld state=%d cc_max=%d fv_uv=%d\n",
+				 cur ? '*' : ' ', seg->start, seg->state,
+				 seg->cc_max, seg->fv_uv);
+	}
+
+	return len;
+}
+
 #define HEALTH_CHG_RATE_BEFORE_TRIGGER 80
 /* health based charging trade charging speed for battery cycle life. */
 static bool msc_logic_health(struct batt_drv *batt_drv)
@@ -3470,7 +4014,7 @@ static bool msc_logic_health(struct batt_drv *batt_drv)
 	 * The estimate will be negative when BD is triggered and during the
 	 * debounce period.
 	 */
-	ret = batt_ttf_estimate(&ttf, batt_drv);
+	ret = batt_health_plan_ttf(batt_drv, now, &ttf);
 	if (ret < 0)
 		return false;
 
@@ -3537,6 +4081,18 @@ done_exit:
 		cc_max = 0;
 	}
 
+	/* charge with the limits of the segment of the plan (when planned) */
+	if (rest_state == CHG_HEALTH_ACTIVE || rest_state == CHG_HEALTH_DONE ||
+	    rest_state == CHG_HEALTH_ENABLED || rest_state == CHG_HEALTH_PAUSE) {
+		const int idx = batt_health_plan_lookup(&rest->plan, now,
+							rest_state);
+
+		if (idx >= 0) {
+			cc_max = rest->plan.seg[idx].cc_max;
+			fv_uv = rest->plan.seg[idx].fv_uv;
+		}
+	}
+
 done_no_op:
 	/* send a power supply event when rest_state changes */
 	changed = rest->rest_state != rest_state;
@@ -3555,8 +4111,8 @@ done_no_op:
 			     rest->active_time);
 
 	rest->rest_state = rest_state;
-	memcpy(&batt_drv->ce_data.ce_health, &batt_drv->chg_health,
-			sizeof(batt_drv->ce_data.ce_health));
+	memcpy(&batt_drv->ce_data->ce_health, &batt_drv->chg_health,
+			sizeof(batt_drv->ce_data->ce_health));
 	return true;
 }
 
@@ -3619,15 +4175,37 @@ static u32 aacr_get_reference_capacity(const struct batt_drv *batt_drv, int cycl
 	return design_capacity - (design_capacity * fade10 / 1000);
 }
 
+/* full_cap_nom in mAh */
+static int aacr_capacity_from(const struct batt_drv *batt_drv, int aacr_algo,
+			      int reference_capacity, int full_cap_nom)
+{
+	const int design_capacity = batt_drv->battery_capacity; /* mAh */
+	const int min_capacity = (batt_drv->battery_capacity * 80) / 100;
+	int full_capacity, aacr_capacity;
+
+	if (aacr_algo == BATT_AACR_ALGO_LOW_B)
+		full_capacity = min(min(full_cap_nom, design_capacity), reference_capacity);
+	else
+		full_capacity = max(min(full_cap_nom, design_capacity), reference_capacity);
+
+	aacr_capacity = max(full_capacity, min_capacity);
+	aacr_capacity = (aacr_capacity / 50) * 50; /* 50mAh, ~1% capacity */
+
+	pr_debug("%s: design=%d reference=%d full_cap_nom=%d full=%d aacr=%d algo=%d\n",
+		 __func__, design_capacity, reference_capacity, full_cap_nom,
+		 full_capacity, aacr_capacity, aacr_algo);
+
+	return aacr_capacity;
+}
+
 /* 80% of design_capacity min, design_capacity in grace, aacr or negative */
 static int aacr_get_capacity_for_algo(const struct batt_drv *batt_drv, int cycle_count,
 				      int aacr_algo)
 {
 	const int design_capacity = batt_drv->battery_capacity; /* mAh */
 	const int min_capacity = (batt_drv->battery_capacity * 80) / 100;
-	int reference_capacity, full_cap_nom, full_capacity;
 	struct power_supply *fg_psy = batt_drv->fg_psy;
-	int aacr_capacity;
+	int reference_capacity, full_cap_nom;
 
 	/* peg at 80% of design when over limit (if set) */
 	if (batt_drv->aacr_cycle_max && (cycle_count >= batt_drv->aacr_cycle_max))
@@ -3641,21 +4219,92 @@ static int aacr_get_capacity_for_algo(const struct batt_drv *batt_drv, int cycle
 	full_cap_nom = GPSY_GET_PROP(fg_psy, POWER_SUPPLY_PROP_CHARGE_FULL);
 	if (full_cap_nom < 0)
 		return full_cap_nom;
-	full_cap_nom /= 1000;
 
-	if (aacr_algo == BATT_AACR_ALGO_LOW_B)
-		full_capacity = min(min(full_cap_nom, design_capacity), reference_capacity);
-	else
-		full_capacity = max(min(full_cap_nom, design_capacity), reference_capacity);
+	return aacr_capacity_from(batt_drv, aacr_algo, reference_capacity,
+				  full_cap_nom / 1000);
+}
 
-	aacr_capacity = max(full_capacity, min_capacity);
-	aacr_capacity = (aacr_capacity / 50) * 50; /* 50mAh, ~1% capacity */
+/*
+ * aacr_get_capacity_for_algo() through the cache: recomputed only when the
+ * cycle count, the algo, the grace/max parameters or FullCapNom change.
+ */
+static int aacr_cached_capacity_for_algo(struct batt_drv *batt_drv,
+					 int cycle_count, int aacr_algo)
+{
+	struct batt_aacr_cache *cache = &batt_drv->aacr_cache;
+	const int cycle_grace = batt_drv->aacr_cycle_grace;
+	const int cycle_max = batt_drv->aacr_cycle_max;
+	unsigned long flags;
+	int capacity = -EINVAL;
+	bool hit;
+
+	if (aacr_algo < 0 || aacr_algo >= BATT_AACR_MAX)
+		return aacr_get_capacity_for_algo(batt_drv, cycle_count, aacr_algo);
+
+	spin_lock_irqsave(&cache->lock, flags);
+	hit = cache->valid[aacr_algo] && cache->cycle_count == cycle_count &&
+	      cache->cycle_grace == cycle_grace && cache->cycle_max == cycle_max;
+	if (hit) {
+		capacity = cache->capacity[aacr_algo];
+		cache->hits += 1;
+	} else {
+		cache->misses += 1;
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
 
-	pr_debug("%s: design=%d reference=%d full_cap_nom=%d full=%d aacr=%d algo=%d\n",
-		 __func__, design_capacity, reference_capacity, full_cap_nom,
-		 full_capacity, aacr_capacity, aacr_algo);
+	if (hit)
+		return capacity;
 
-	return aacr_capacity;
+	capacity = aacr_get_capacity_for_algo(batt_drv, cycle_count, aacr_algo);
+	if (capacity < 0)
+		return capacity;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	if (cache->cycle_count != cycle_count ||
+	    cache->cycle_grace != cycle_grace || cache->cycle_max != cycle_max) {
+		memset(cache->valid, 0, sizeof(cache->valid));
+		cache->cycle_count = cycle_count;
+		cache->cycle_grace = cycle_grace;
+		cache->cycle_max = cycle_max;
+	}
+	cache->capacity[aacr_algo] = capacity;
+	cache->valid[aacr_algo] = true;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return capacity;
+}
+
+static void aacr_cache_invalidate(struct batt_drv *batt_drv)
+{
+	struct batt_aacr_cache *cache = &batt_drv->aacr_cache;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	memset(cache->valid, 0, sizeof(cache->valid));
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/*
+ * FullCapNom changes with learning and when the gauge loads a model: sample
+ * it with the cycle count and on connect, drop the cache when it changes.
+ */
+static void aacr_cache_update_full_cap_nom(struct batt_drv *batt_drv)
+{
+	struct batt_aacr_cache *cache = &batt_drv->aacr_cache;
+	unsigned long flags;
+	int full_cap_nom;
+
+	full_cap_nom = GPSY_GET_PROP(batt_drv->fg_psy, POWER_SUPPLY_PROP_CHARGE_FULL);
+	if (full_cap_nom < 0)
+		return;
+	full_cap_nom /= 1000;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	if (cache->full_cap_nom != full_cap_nom) {
+		memset(cache->valid, 0, sizeof(cache->valid));
+		cache->full_cap_nom = full_cap_nom;
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
 }
 
 static int aacr_get_capacity_at_cycle(const struct batt_drv *batt_drv, int cycle_count)
@@ -3688,7 +4337,8 @@ static u32 aacr_get_capacity(struct batt_drv *batt_drv)
 	} else {
 		int aacr_capacity;
 
-		aacr_capacity = aacr_get_capacity_at_cycle(batt_drv, cycle_count);
+		aacr_capacity = aacr_cached_capacity_for_algo(batt_drv, cycle_count,
+							      batt_drv->aacr_algo);
 		if (aacr_capacity < 0) {
 			batt_drv->aacr_state = BATT_AACR_INVALID_CAP;
 		} else {
@@ -3917,13 +4567,13 @@ static int bhi_calc_cap_index(int algo, struct batt_drv *batt_drv)
 			if (capacity_health < capacity_bound)
 				capacity_health = capacity_bound;
 		} else if (algo == BHI_ALGO_ACHI_RAVG_B) {
-			capacity_bound = aacr_get_capacity_for_algo(batt_drv, cycle_count,
-								    BATT_AACR_ALGO_LOW_B);
+			capacity_bound = aacr_cached_capacity_for_algo(batt_drv, cycle_count,
+								       BATT_AACR_ALGO_LOW_B);
 			if (capacity_health > capacity_bound)
 				capacity_health = capacity_bound;
 		} else {
-			capacity_bound = aacr_get_capacity_for_algo(batt_drv, cycle_count,
-								    BATT_AACR_ALGO_DEFAULT);
+			capacity_bound = aacr_cached_capacity_for_algo(batt_drv, cycle_count,
+								       BATT_AACR_ALGO_DEFAULT);
 			if (capacity_health < capacity_bound)
 				capacity_health = capacity_bound;
 		}
@@ -4363,8 +5013,120 @@ static int batt_bhi_stats_update_all(struct batt_drv *batt_drv)
 
 /* ------------------------------------------------------------------------ */
 
+#define BPST_DET_DI_MIN_UA	100000	/* smallest current step used */
+#define BPST_DET_WARMUP		16	/* samples before the baseline is used */
+#define BPST_DET_R_SHIFT	4
+#define BPST_DET_BASE_SHIFT	6	/* baseline EWMA weight 1/64 */
+#define BPST_DET_FAST_SHIFT	2	/* fast EWMA weight 1/4 */
+#define BPST_DET_RATIO_ONE	256
+#define BPST_DET_CUSUM_K	384	/* drift allowance, 1.5x baseline */
+#define BPST_DET_CUSUM_H	1024	/* decision threshold */
+#define BPST_DET_TEMP_MIN	150	/* deci deg C, ~2x resistance when cold */
+#define BPST_DET_TEMP_MAX	450
+#define BPST_DET_TEMP_DELTA	50	/* restart the baseline on change */
+#define BPST_DET_DT_MAX_MS	5000	/* dI step window, limits OCV drift */
+
+/* new connect or temperature change: restart from a new baseline */
+static void batt_bpst_det_reset(struct batt_bpst_det *det)
+{
+	det->last_valid = false;
+	det->samples = 0;
+	det->r_base = 0;
+	det->r_fast = 0;
+	det->cusum = 0;
+}
+
+/*
+ * O(1) per sample, called from msc_logic() with vbatt, ibatt (negative
+ * when charging) and temp. Uses only the current steps that happen within
+ * BPST_DET_DT_MAX_MS inside the temperature window. Sets bpst_sbd_status
+ * when the CUSUM trips. The count in GBMS_TAG_BPST is written only once,
+ * on disconnect.
+ */
+static void batt_bpst_det_sample(struct batt_bpst *bpst_state, int vbatt,
+				 int ibatt, int temp)
+{
+	struct batt_bpst_det *det = &bpst_state->det;
+	const s64 now_ms = ktime_to_ms(ktime_get_boottime());
+	s32 dv, di, r, ratio;
+	s64 dt_ms;
+
+	mutex_lock(&bpst_state->lock);
+	if (!bpst_state->bpst_enable || bpst_state->bpst_detect_disable)
+		goto exit_done;
+
+	if (temp < BPST_DET_TEMP_MIN || temp > BPST_DET_TEMP_MAX) {
+		det->rejected += 1;
+		det->last_valid = false;
+		goto exit_done;
+	}
+
+	if (det->samples && abs(temp - det->temp_base) > BPST_DET_TEMP_DELTA)
+		batt_bpst_det_reset(det);
+
+	dv = vbatt - det->vbatt_last;
+	di = ibatt - det->ibatt_last;
+	dt_ms = now_ms - det->last_ms;
+	if (!det->last_valid) {
+		det->last_valid = true;
+		goto exit_last;
+	}
+
+	if (dt_ms > BPST_DET_DT_MAX_MS || abs(di) < BPST_DET_DI_MIN_UA) {
+		det->rejected += 1;
+		goto exit_last;
+	}
+
+	/* uV/uA is Ohm, more charge current (di < 0) raises vbatt */
+	r = div_s64((s64)-dv * 1000 * (1 << BPST_DET_R_SHIFT), di);
+	if (r <= 0) {
+		det->rejected += 1;
+		goto exit_last;
+	}
+
+	if (det->samples == 0) {
+		det->r_base = r;
+		det->r_fast = r;
+		det->temp_base = temp;
+	} else {
+		det->r_fast += (r - det->r_fast) >> BPST_DET_FAST_SHIFT;
+		/* freeze the baseline while the test is accumulating */
+		if (det->cusum == 0)
+			det->r_base += (r - det->r_base) >> BPST_DET_BASE_SHIFT;
+	}
+
+	det->samples += 1;
+	if (det->samples < BPST_DET_WARMUP || det->r_base <= 0)
+		goto exit_last;
+
+	ratio = (det->r_fast * BPST_DET_RATIO_ONE) / det->r_base;
+	det->cusum = max(det->cusum + ratio - BPST_DET_CUSUM_K, 0);
+	if (det->cusum > BPST_DET_CUSUM_H && !bpst_state->bpst_sbd_status) {
+		const int threshold = bpst_state->bpst_count_threshold;
+
+		bpst_state->bpst_sbd_status = 1;
+		det->trips += 1;
+
+		/* this session will be counted on disconnect */
+		if (threshold > 0 && bpst_state->bpst_count + 1 >= threshold)
+			bpst_state->bpst_cell_fault = true;
+
+		pr_info("MSC_BPST: sbd r_fast=%d r_base=%d cusum=%d fault=%d\n",
+			det->r_fast >> BPST_DET_R_SHIFT,
+			det->r_base >> BPST_DET_R_SHIFT, det->cusum,
+			bpst_state->bpst_cell_fault);
+	}
+
+exit_last:
+	det->vbatt_last = vbatt;
+	det->ibatt_last = ibatt;
+	det->last_ms = now_ms;
+exit_done:
+	mutex_unlock(&bpst_state->lock);
+}
 
 /* TODO: factor msc_logic_irdop from the logic about tier switch */
+
 static int msc_logic(struct batt_drv *batt_drv)
 {
 	bool sw_jeita;
@@ -4375,7 +5137,7 @@ static int msc_logic(struct batt_drv *batt_drv)
 	int temp, ibatt, vbatt, ioerr;
 	int update_interval = MSC_DEFAULT_UPDATE_INTERVAL;
 	const ktime_t now = get_boot_sec();
-	ktime_t elap = now - batt_drv->ce_data.last_update;
+	ktime_t elap = now - batt_drv->ce_data->last_update;
 	bool changed;
 
 	ioerr = gbatt_get_raw_temp(batt_drv, &temp);
@@ -4400,15 +5162,19 @@ static int msc_logic(struct batt_drv *batt_drv)
 		batt_drv->jeita_stop_charging = 0;
 	}
 
-	ibatt = GPSY_GET_INT_PROP(fg_psy, POWER_SUPPLY_PROP_CURRENT_NOW,
-					  &ioerr);
+	/* charging decisions use fresh values, not the gauge cache */
+	ibatt = GPSY_GET_INT_PROP_UNCACHED(fg_psy, POWER_SUPPLY_PROP_CURRENT_NOW,
+					   &ioerr);
 	if (ioerr < 0)
 		return -EIO;
 
-	vbatt = GPSY_GET_PROP(fg_psy, POWER_SUPPLY_PROP_VOLTAGE_NOW);
+	vbatt = GPSY_GET_INT_PROP_UNCACHED(fg_psy, POWER_SUPPLY_PROP_VOLTAGE_NOW,
+					   NULL);
 	if (vbatt < 0)
 		return -EIO;
 
+	batt_bpst_det_sample(&batt_drv->bpst_state, vbatt, ibatt, temp);
+
 	/*
 	 * Multi Step Charging with IRDROP compensation when vchrg is != 0
 	 * vbatt_idx = batt_drv->vbatt_idx, fv_uv = batt_drv->fv_uv
@@ -4506,7 +5272,7 @@ static int msc_logic(struct batt_drv *batt_drv)
 		}
 
 		mutex_lock(&batt_drv->stats_lock);
-		gbms_chg_stats_tier(&batt_drv->ce_data.tier_stats[tier_idx],
+		gbms_chg_stats_tier(&batt_drv->ce_data->tier_stats[tier_idx],
 				    batt_drv->msc_irdrop_state, elap);
 		batt_drv->msc_irdrop_state = msc_state;
 		mutex_unlock(&batt_drv->stats_lock);
@@ -4603,7 +5369,7 @@ static int msc_logic(struct batt_drv *batt_drv)
 	}
 
 	batt_drv->msc_state = msc_state;
-	batt_drv->ce_data.last_update = now;
+	batt_drv->ce_data->last_update = now;
 	mutex_unlock(&batt_drv->stats_lock);
 
 	changed = batt_drv->temp_idx != temp_idx ||
@@ -4696,15 +5462,15 @@ static void google_battery_dump_profile(const struct gbms_chg_profile *profile)
 	}
 }
 
-/* cell fault: disconnect of one of the battery cells */
+/*
+ * cell fault: disconnect of one of the battery cells, bpst_sbd_status is set
+ * by batt_bpst_det_sample() while charging or faked with
+ * "echo 1 > /d/bpst/bpst_sbd_status"
+ */
 static bool batt_cell_fault_detect(struct batt_bpst *bpst_state)
 {
 	int bpst_sbd_status;
 
-	/*
-	 * fake bpst_sbd_status by "echo 1 > /d/bpst/bpst_sbd_status"
-	 * TODO: will implement the code from the algo in b/203019566
-	 */
 	bpst_sbd_status = bpst_state->bpst_sbd_status;
 
 	return !!bpst_sbd_status && !bpst_state->bpst_detect_disable;
@@ -4719,6 +5485,12 @@ static int batt_bpst_detect_begin(struct batt_bpst *bpst_state)
 	if (bpst_state->bpst_detect_disable)
 		return 0;
 
+	/* the count changes only in batt_bpst_detect_update() and reset */
+	if (bpst_state->bpst_count_valid) {
+		data = bpst_state->bpst_count;
+		goto count_done;
+	}
+
 	ret = gbms_storage_read(GBMS_TAG_BPST, &data, sizeof(data));
 	if (ret < 0)
 		return -EINVAL;
@@ -4730,6 +5502,9 @@ static int batt_bpst_detect_begin(struct batt_bpst *bpst_state)
 			return -EINVAL;
 	}
 	bpst_state->bpst_count = data;
+	bpst_state->bpst_count_valid = true;
+
+count_done:
 	if (bpst_count_threshold > 0) {
 		bpst_state->bpst_cell_fault = (data >= (u8)bpst_count_threshold);
 		pr_debug("%s: MSC_BPST: single battery disconnect %d\n",
@@ -4738,6 +5513,7 @@ static int batt_bpst_detect_begin(struct batt_bpst *bpst_state)
 
 	/* reset detection status */
 	bpst_state->bpst_sbd_status = 0;
+	batt_bpst_det_reset(&bpst_state->det);
 
 	pr_debug("%s: MSC_BPST: %d in connected\n", __func__, data);
 	return 0;
@@ -4753,6 +5529,8 @@ static int batt_bpst_detect_update(struct batt_drv *batt_drv)
 		ret = gbms_storage_write(GBMS_TAG_BPST, &data, sizeof(data));
 		if (ret < 0)
 			return -EINVAL;
+
+		bpst_state->bpst_count = data;
 	}
 
 	pr_debug("%s: MSC_BPST: %d in disconnected\n", __func__, data);
@@ -4761,13 +5539,20 @@ static int batt_bpst_detect_update(struct batt_drv *batt_drv)
 
 static int batt_bpst_reset(struct batt_bpst *bpst_state)
 {
+	int ret = 0;
+
+	mutex_lock(&bpst_state->lock);
 	if (bpst_state->bpst_enable) {
 		u8 data = 0;
 
-		return gbms_storage_write(GBMS_TAG_BPST, &data, sizeof(data));
+		/* read back on the next connect if the write fails */
+		bpst_state->bpst_count = 0;
+		bpst_state->bpst_count_valid = false;
+		ret = gbms_storage_write(GBMS_TAG_BPST, &data, sizeof(data));
 	}
+	mutex_unlock(&bpst_state->lock);
 
-	return 0;
+	return ret;
 }
 
 #define BATT_BPST_DEFAULT_CHG_RATE 100
@@ -4830,7 +5615,7 @@ static int batt_chg_logic(struct batt_drv *batt_drv)
 
 		/* here on: disconnect */
 		batt_log_csi_ttf_info(batt_drv);
-		batt_chg_stats_pub(batt_drv, "disconnect", false, false);
+		batt_chg_stats_pub(batt_drv, "disconnect", false, false, true);
 
 		/* change curve before changing the state. */
 		ssoc_change_curve(&batt_drv->ssoc_state, ssoc_delta,
@@ -4839,6 +5624,7 @@ static int batt_chg_logic(struct batt_drv *batt_drv)
 		batt_drv->chg_health.rest_deadline = 0;
 		batt_reset_chg_drv_state(batt_drv);
 		batt_update_cycle_count(batt_drv);
+		aacr_cache_update_full_cap_nom(batt_drv);
 		batt_rl_reset(batt_drv);
 
 		/* charging_policy: vote AC false when disconnected */
@@ -4888,6 +5674,7 @@ static int batt_chg_logic(struct batt_drv *batt_drv)
 		if (bhi_data->res_state.estimate_filter)
 			batt_res_state_set(&bhi_data->res_state, true);
 
+		aacr_cache_update_full_cap_nom(batt_drv);
 		capacity = aacr_get_capacity(batt_drv);
 		if (capacity != batt_drv->chg_profile.capacity_ma) {
 			gbms_init_chg_table(&batt_drv->chg_profile, node, capacity);
@@ -4903,8 +5690,8 @@ static int batt_chg_logic(struct batt_drv *batt_drv)
 		/* released in battery_work() */
 		__pm_stay_awake(batt_drv->poll_ws);
 		batt_drv->batt_fast_update_cnt = BATT_WORK_FAST_RETRY_CNT;
-		mod_delayed_work(system_wq, &batt_drv->batt_work,
-				 msecs_to_jiffies(BATT_WORK_FAST_RETRY_MS));
+		gbms_mod_delayed_work(&batt_drv->batt_work,
+				      msecs_to_jiffies(BATT_WORK_FAST_RETRY_MS));
 
 		/* TODO: move earlier and include the change to the curve */
 		ssoc_change_state(&batt_drv->ssoc_state, 1);
@@ -5715,7 +6502,71 @@ static ssize_t debug_get_power_metrics(struct file *filp, char __user *buf,
 
 BATTERY_DEBUG_ATTRIBUTE(debug_power_metrics_fops, debug_get_power_metrics, NULL);
 
-static int debug_bpst_sbd_status_read(void *data, u64 *val)
+#define AACR_TABLE_CYCLE_STEP	100
+#define AACR_TABLE_CYCLE_END	1500
+
+/* capacity vs cycle count for each algo, with the current full_cap_nom */
+static ssize_t debug_get_aacr_table(struct file *filp, char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct batt_drv *batt_drv = (struct batt_drv *)filp->private_data;
+	const int design_capacity = batt_drv->battery_capacity;
+	const int min_capacity = (design_capacity * 80) / 100;
+	struct batt_aacr_cache *cache = &batt_drv->aacr_cache;
+	int cycle_end = AACR_TABLE_CYCLE_END;
+	int full_cap_nom, cycle, len = 0;
+	char *tmp;
+
+	full_cap_nom = GPSY_GET_PROP(batt_drv->fg_psy, POWER_SUPPLY_PROP_CHARGE_FULL);
+	if (full_cap_nom < 0)
+		return full_cap_nom;
+	full_cap_nom /= 1000;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	if (batt_drv->aacr_cycle_max > cycle_end)
+		cycle_end = batt_drv->aacr_cycle_max;
+
+	len += scnprintf(&tmp[len], PAGE_SIZE - len,
+			 "state=%d algo=%d grace=%d max=%d fcn=%d hits=%u misses=%u\n",
+			 batt_drv->aacr_state, batt_drv->aacr_algo,
+			 batt_drv->aacr_cycle_grace, batt_drv->aacr_cycle_max,
+			 full_cap_nom, cache->hits, cache->misses);
+	len += scnprintf(&tmp[len], PAGE_SIZE - len, "cycle ref default low_b\n");
+
+	for (cycle = 0; cycle <= cycle_end; cycle += AACR_TABLE_CYCLE_STEP) {
+		int ref, cap_def, cap_low;
+
+		ref = aacr_get_reference_capacity(batt_drv, cycle);
+		if (cycle <= batt_drv->aacr_cycle_grace) {
+			cap_def = cap_low = design_capacity;
+		} else if (batt_drv->aacr_cycle_max &&
+			   cycle >= batt_drv->aacr_cycle_max) {
+			cap_def = cap_low = min_capacity;
+		} else if (ref <= 0) {
+			cap_def = cap_low = design_capacity;
+		} else {
+			cap_def = aacr_capacity_from(batt_drv, BATT_AACR_ALGO_DEFAULT,
+						     ref, full_cap_nom);
+			cap_low = aacr_capacity_from(batt_drv, BATT_AACR_ALGO_LOW_B,
+						     ref, full_cap_nom);
+		}
+
+		len += scnprintf(&tmp[len], PAGE_SIZE - len, "%d %d %d %d\n",
+				 cycle, ref, cap_def, cap_low);
+	}
+
+	len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+	kfree(tmp);
+
+	return len;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_aacr_table_fops, debug_get_aacr_table, NULL);
+
+static int debug_bpst_sbd_status_read(void *data, u64 *val)
 {
 	struct batt_drv *batt_drv = (struct batt_drv *)data;
 
@@ -5741,6 +6592,37 @@ DEFINE_SIMPLE_ATTRIBUTE(debug_bpst_sbd_status_fops,
 			debug_bpst_sbd_status_read,
 			debug_bpst_sbd_status_write, "%llu\n");
 
+static ssize_t debug_get_bpst_det(struct file *filp, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct batt_drv *batt_drv = (struct batt_drv *)filp->private_data;
+	struct batt_bpst *bpst_state = &batt_drv->bpst_state;
+	const struct batt_bpst_det *det = &bpst_state->det;
+	char *tmp;
+	int len;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	mutex_lock(&bpst_state->lock);
+	len = scnprintf(tmp, PAGE_SIZE,
+			"samples=%u rejected=%u r_base=%d r_fast=%d cusum=%d trips=%u sbd=%d count=%d fault=%d\n",
+			det->samples, det->rejected,
+			det->r_base >> BPST_DET_R_SHIFT,
+			det->r_fast >> BPST_DET_R_SHIFT, det->cusum, det->trips,
+			bpst_state->bpst_sbd_status, bpst_state->bpst_count,
+			bpst_state->bpst_cell_fault);
+	mutex_unlock(&bpst_state->lock);
+
+	len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+	kfree(tmp);
+
+	return len;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_bpst_det_fops, debug_get_bpst_det, NULL);
+
 static int debug_ravg_fops_write(void *data, u64 val)
 {
 	struct batt_drv *batt_drv = (struct batt_drv *)data;
@@ -5851,7 +6733,7 @@ static ssize_t debug_set_pairing_state(struct file *filp,
 
 	if (val == BATT_PAIRING_ENABLED) {
 		batt_drv->pairing_state = BATT_PAIRING_ENABLED;
-		mod_delayed_work(system_wq, &batt_drv->batt_work, 0);
+		gbms_mod_delayed_work(&batt_drv->batt_work, 0);
 	} else if (val == BATT_PAIRING_RESET) {
 
 		/* send a paring enable to re-pair OR reboot */
@@ -5991,7 +6873,8 @@ static ssize_t batt_ctl_chg_stats_actual(struct device *dev,
 	switch (buf[0]) {
 	case 'p': /* publish data to qual */
 	case 'P': /* force publish data to qual */
-		batt_chg_stats_pub(batt_drv, "debug cmd", buf[0] == 'P', false);
+		batt_chg_stats_pub(batt_drv, "debug cmd", buf[0] == 'P', false,
+				   false);
 		break;
 	default:
 		count = -EINVAL;
@@ -6010,8 +6893,8 @@ static ssize_t batt_show_chg_stats_actual(struct device *dev,
 	int len;
 
 	mutex_lock(&batt_drv->stats_lock);
-	len = batt_chg_stats_cstr(buf, PAGE_SIZE, &batt_drv->ce_data, false,
-			aacr_filtered_capacity(batt_drv, &batt_drv->ce_data));
+	len = batt_chg_stats_cstr(buf, PAGE_SIZE, batt_drv->ce_data, false,
+			aacr_filtered_capacity(batt_drv, batt_drv->ce_data));
 	mutex_unlock(&batt_drv->stats_lock);
 
 	return len;
@@ -6035,8 +6918,8 @@ static ssize_t batt_ctl_chg_stats(struct device *dev,
 	mutex_lock(&batt_drv->stats_lock);
 	switch (buf[0]) {
 	case 0:
-	case '0': /* invalidate current qual */
-		cev_stats_init(&batt_drv->ce_qual, &batt_drv->chg_profile);
+	case '0': /* invalidate current qual, readers will see -ENODATA */
+		RCU_INIT_POINTER(batt_drv->ce_qual, NULL);
 		break;
 	}
 	mutex_unlock(&batt_drv->stats_lock);
@@ -6058,27 +6941,287 @@ static ssize_t batt_chg_qual_stats_cstr(char *buff, int size,
 	return len;
 }
 
+static void batt_attr_lat_update(struct batt_drv *batt_drv,
+				 enum batt_attr_lat_idx idx, ktime_t start)
+{
+	struct batt_attr_lat *lat = &batt_drv->attr_lat[idx];
+	const u32 elap_us = ktime_us_delta(ktime_get(), start);
+
+	spin_lock(&batt_drv->attr_lat_lock);
+	lat->count += 1;
+	lat->total_us += elap_us;
+	if (elap_us > lat->max_us)
+		lat->max_us = elap_us;
+	spin_unlock(&batt_drv->attr_lat_lock);
+}
+
+static const char *batt_attr_lat_names[BATT_ATTR_LAT_COUNT] = {
+	[BATT_ATTR_CHG_STATS] = "charge_stats",
+	[BATT_ATTR_CHG_STATS_BIN] = "charge_stats_bin",
+	[BATT_ATTR_CHG_DETAILS] = "charge_details",
+	[BATT_ATTR_CHG_DETAILS_BIN] = "charge_details_bin",
+	[BATT_ATTR_SSOC_DETAILS] = "ssoc_details",
+	[BATT_ATTR_SSOC_DETAILS_BIN] = "ssoc_details_bin",
+	[BATT_ATTR_HEALTH_INDEX_STATS] = "health_index_stats",
+	[BATT_ATTR_HEALTH_INDEX_STATS_BIN] = "health_index_stats_bin",
+};
+
+static struct batt_drv *batt_bin_attr_drvdata(struct kobject *kobj)
+{
+	struct device *dev = container_of(kobj, struct device, kobj);
+	struct power_supply *psy = container_of(dev, struct power_supply, dev);
+
+	return power_supply_get_drvdata(psy);
+}
+
+/* call holding stats_lock or rcu_read_lock() */
+static void batt_ce_snapshot_copy(struct batt_drv *batt_drv,
+				  struct batt_ce_snapshot *snap,
+				  struct gbms_charging_event *ce)
+{
+	snap->valid = 1;
+	snap->capacity = aacr_filtered_capacity(batt_drv, ce);
+	snap->ce = *ce;
+	snap->ce.chg_profile = NULL;
+}
+
+/* call holding attr_snap_lock, the qual record is valid when it has data */
+static void batt_ce_snapshot_qual(struct batt_drv *batt_drv,
+				  struct batt_ce_snapshot *snap)
+{
+	struct gbms_charging_event *ce_qual;
+
+	snap->valid = 0;
+
+	rcu_read_lock();
+	ce_qual = rcu_dereference(batt_drv->ce_qual);
+	if (ce_qual && ce_qual->last_update - ce_qual->first_update)
+		batt_ce_snapshot_copy(batt_drv, snap, ce_qual);
+	rcu_read_unlock();
+}
+
+/* call holding attr_snap_lock, the current record is always valid */
+static void batt_ce_snapshot_data(struct batt_drv *batt_drv,
+				  struct batt_ce_snapshot *snap)
+{
+	mutex_lock(&batt_drv->stats_lock);
+	batt_ce_snapshot_copy(batt_drv, snap, batt_drv->ce_data);
+	snap->chg_health = batt_drv->chg_health;
+	mutex_unlock(&batt_drv->stats_lock);
+}
+
+/* call holding attr_snap_lock */
+static void batt_ce_snapshot(struct batt_drv *batt_drv, bool details)
+{
+	struct batt_ce_snapshots *snap = &batt_drv->attr_snap;
+	int count = 0;
+
+	if (details)
+		batt_ce_snapshot_data(batt_drv, &snap->rec[count++]);
+	batt_ce_snapshot_qual(batt_drv, &snap->rec[count++]);
+
+	snap->seq += 1;
+	snap->count = count;
+}
+
+static void batt_bin_tier_fill(struct batt_bin_tier *rec,
+			       const struct gbms_ce_tier_stats *ts)
+{
+	int i;
+
+	rec->temp_idx = ts->temp_idx;
+	rec->vtier_idx = ts->vtier_idx;
+	rec->soc_in = ts->soc_in;
+	rec->cc_in = ts->cc_in;
+	rec->cc_total = ts->cc_total;
+	rec->time_fast = ts->time_fast;
+	rec->time_taper = ts->time_taper;
+	rec->time_other = ts->time_other;
+	rec->temp_in = ts->temp_in;
+	rec->temp_min = ts->temp_min;
+	rec->temp_max = ts->temp_max;
+	rec->ibatt_min = ts->ibatt_min;
+	rec->ibatt_max = ts->ibatt_max;
+	rec->icl_min = ts->icl_min;
+	rec->icl_max = ts->icl_max;
+	rec->reserved = 0;
+	rec->icl_sum = ts->icl_sum;
+	rec->temp_sum = ts->temp_sum;
+	rec->ibatt_sum = ts->ibatt_sum;
+	rec->sample_count = ts->sample_count;
+
+	for (i = 0; i < BATT_BIN_MSC_COUNT; i++) {
+		rec->msc_cnt[i] = ts->msc_cnt[i];
+		rec->msc_elap[i] = ts->msc_elap[i];
+	}
+}
+
+static void batt_bin_health_fill(struct batt_bin_health *rec,
+				 const struct batt_chg_health *h)
+{
+	rec->rest_soc = h->rest_soc;
+	rec->rest_voltage = h->rest_voltage;
+	rec->always_on_soc = h->always_on_soc;
+	rec->rest_rate = h->rest_rate;
+	rec->rest_rate_before_trigger = h->rest_rate_before_trigger;
+	rec->rest_state = h->rest_state;
+	rec->rest_cc_max = h->rest_cc_max;
+	rec->rest_fv_uv = h->rest_fv_uv;
+	rec->rest_deadline = h->rest_deadline;
+	rec->dry_run_deadline = h->dry_run_deadline;
+	rec->active_time = h->active_time;
+	rec->plan_valid = h->plan.valid;
+	rec->plan_nb_seg = h->plan.nb_seg;
+	rec->plan_replan_count = h->plan.replan_count;
+	rec->plan_check_count = h->plan.check_count;
+	rec->plan_planned_at = h->plan.planned_at;
+	rec->plan_ttf = h->plan.ttf;
+}
+
+static void batt_bin_ce_fill(struct batt_bin_ce *rec,
+			     const struct batt_ce_snapshot *snap)
+{
+	const struct gbms_charging_event *ce = &snap->ce;
+	const struct gbms_ce_tier_stats *stats[BATT_BIN_CE_STATS_COUNT] = {
+		[BATT_BIN_CE_HEALTH] = &ce->health_stats,
+		[BATT_BIN_CE_HEALTH_PAUSE] = &ce->health_pause_stats,
+		[BATT_BIN_CE_HEALTH_DRYRUN] = &ce->health_dryrun_stats,
+		[BATT_BIN_CE_FULL_CHARGE] = &ce->full_charge_stats,
+		[BATT_BIN_CE_HIGH_SOC] = &ce->high_soc_stats,
+		[BATT_BIN_CE_OVERHEAT] = &ce->overheat_stats,
+		[BATT_BIN_CE_CC_LVL] = &ce->cc_lvl_stats,
+		[BATT_BIN_CE_TRICKLE] = &ce->trickle_stats,
+		[BATT_BIN_CE_TEMP_FILTER] = &ce->temp_filter_stats,
+	};
+	int i;
+
+	/* the internal structs changed: update the records and the version */
+	BUILD_BUG_ON(MSC_STATES_COUNT != BATT_BIN_MSC_COUNT);
+	BUILD_BUG_ON(GBMS_STATS_TIER_COUNT != BATT_BIN_TIER_COUNT);
+	BUILD_BUG_ON(GBMS_SOC_STATS_LEN != BATT_BIN_SOC_LEN);
+
+	memset(rec, 0, sizeof(*rec));
+	rec->valid = snap->valid;
+	if (!snap->valid)
+		return;
+
+	rec->capacity = snap->capacity;
+	rec->adapter_details = ce->adapter_details.v;
+	rec->voltage_in = ce->charging_stats.voltage_in;
+	rec->ssoc_in = ce->charging_stats.ssoc_in;
+	rec->cc_in = ce->charging_stats.cc_in;
+	rec->voltage_out = ce->charging_stats.voltage_out;
+	rec->ssoc_out = ce->charging_stats.ssoc_out;
+	rec->cc_out = ce->charging_stats.cc_out;
+	rec->last_soc = ce->last_soc;
+	rec->bd_clear_trickle = ce->bd_clear_trickle;
+	rec->first_update = ce->first_update;
+	rec->last_update = ce->last_update;
+	batt_bin_health_fill(&rec->ce_health, &ce->ce_health);
+	batt_bin_health_fill(&rec->chg_health, &snap->chg_health);
+
+	for (i = 0; i < BATT_BIN_TIER_COUNT; i++)
+		batt_bin_tier_fill(&rec->tier_stats[i], &ce->tier_stats[i]);
+	for (i = 0; i < BATT_BIN_CE_STATS_COUNT; i++)
+		batt_bin_tier_fill(&rec->stats[i], stats[i]);
+
+	for (i = 0; i < BATT_BIN_SOC_LEN; i++) {
+		rec->soc_ti[i] = ce->soc_stats.ti[i];
+		rec->soc_cc[i] = ce->soc_stats.cc[i];
+		rec->soc_elap[i] = ce->soc_stats.elap[i];
+	}
+}
+
 static ssize_t batt_show_chg_stats(struct device *dev,
 				   struct device_attribute *attr, char *buf)
 {
 	struct power_supply *psy = container_of(dev, struct power_supply, dev);
 	struct batt_drv *batt_drv =(struct batt_drv *)
 					power_supply_get_drvdata(psy);
-	struct gbms_charging_event *ce_qual = &batt_drv->ce_qual;
+	struct batt_ce_snapshot *qual = &batt_drv->attr_snap.rec[0];
+	const ktime_t start = ktime_get();
 	int len = -ENODATA;
 
-	mutex_lock(&batt_drv->stats_lock);
-	if (ce_qual->last_update - ce_qual->first_update)
-		len = batt_chg_qual_stats_cstr(buf, PAGE_SIZE, ce_qual, false,
-					aacr_filtered_capacity(batt_drv, ce_qual));
-	mutex_unlock(&batt_drv->stats_lock);
+	mutex_lock(&batt_drv->attr_snap_lock);
+	batt_ce_snapshot(batt_drv, false);
+	if (qual->valid)
+		len = batt_chg_qual_stats_cstr(buf, PAGE_SIZE, &qual->ce, false,
+					       qual->capacity);
+	mutex_unlock(&batt_drv->attr_snap_lock);
 
+	batt_attr_lat_update(batt_drv, BATT_ATTR_CHG_STATS, start);
 	return len;
 }
 
 static const DEVICE_ATTR(charge_stats, 0664, batt_show_chg_stats,
 					     batt_ctl_chg_stats);
 
+/* current/active and qual data, header followed by the records */
+static ssize_t batt_chg_snapshot_bin_read(struct batt_drv *batt_drv,
+					  const struct file *filp,
+					  bool details, char *buf,
+					  loff_t pos, size_t size)
+{
+	const struct batt_ce_snapshots *snap = &batt_drv->attr_snap;
+	struct batt_bin_ce_snapshot *bin = &batt_drv->attr_bin[details];
+	ssize_t len;
+	int i;
+
+	mutex_lock(&batt_drv->attr_snap_lock);
+	/*
+	 * Each attribute has its own copy, filled on the first chunk. The
+	 * next chunks carry no header: fail them when another open file
+	 * refilled the copy in between, the reader restarts from 0.
+	 */
+	if (pos != 0 && batt_drv->attr_bin_filp[details] != filp) {
+		mutex_unlock(&batt_drv->attr_snap_lock);
+		return -EAGAIN;
+	}
+
+	if (pos == 0) {
+		batt_drv->attr_bin_filp[details] = filp;
+		batt_ce_snapshot(batt_drv, details);
+
+		for (i = 0; i < snap->count; i++)
+			batt_bin_ce_fill(&bin->rec[i], &snap->rec[i]);
+
+		bin->hdr.version = BATT_ATTR_BIN_VERSION;
+		bin->hdr.seq = snap->seq;
+		bin->hdr.count = snap->count;
+		bin->hdr.rec_size = sizeof(bin->rec[0]);
+	}
+
+	len = memory_read_from_buffer(buf, size, &pos, bin,
+				      sizeof(bin->hdr) +
+				      bin->hdr.count * sizeof(bin->rec[0]));
+	mutex_unlock(&batt_drv->attr_snap_lock);
+
+	return len;
+}
+
+static ssize_t charge_stats_bin_read(struct file *filp, struct kobject *kobj,
+				     struct bin_attribute *bin_attr,
+				     char *buf, loff_t pos, size_t size)
+{
+	struct batt_drv *batt_drv = batt_bin_attr_drvdata(kobj);
+	const ktime_t start = ktime_get();
+	ssize_t len;
+
+	len = batt_chg_snapshot_bin_read(batt_drv, filp, false, buf, pos, size);
+	batt_attr_lat_update(batt_drv, BATT_ATTR_CHG_STATS_BIN, start);
+	return len;
+}
+
+static struct bin_attribute bin_attr_charge_stats_bin = {
+	.attr = {
+		.name = "charge_stats_bin",
+		.mode = 0444,
+	},
+	.read = charge_stats_bin_read,
+	.size = sizeof(struct batt_attr_bin_hdr) +
+		sizeof(struct batt_bin_ce),
+};
+
 /* show current/active and qual data */
 static ssize_t batt_show_chg_details(struct device *dev,
 				     struct device_attribute *attr, char *buf)
@@ -6086,36 +7229,37 @@ static ssize_t batt_show_chg_details(struct device *dev,
 	struct power_supply *psy = container_of(dev, struct power_supply, dev);
 	struct batt_drv *batt_drv =(struct batt_drv *)
 					power_supply_get_drvdata(psy);
-	struct gbms_charging_event *ce_data = &batt_drv->ce_data;
-	const bool qual_valid = (batt_drv->ce_qual.last_update -
-				batt_drv->ce_qual.first_update) != 0;
+	struct batt_ce_snapshot *data = &batt_drv->attr_snap.rec[0];
+	struct batt_ce_snapshot *qual = &batt_drv->attr_snap.rec[1];
+	const ktime_t start = ktime_get();
 	int len = 0;
 
-	mutex_lock(&batt_drv->stats_lock);
+	mutex_lock(&batt_drv->attr_snap_lock);
+	batt_ce_snapshot(batt_drv, true);
 
 	/* this is the current one */
-	len += batt_chg_stats_cstr(&buf[len], PAGE_SIZE - len, ce_data, true,
-				   aacr_filtered_capacity(batt_drv, ce_data));
+	len += batt_chg_stats_cstr(&buf[len], PAGE_SIZE - len, &data->ce, true,
+				   data->capacity);
 
 	/*
 	 * stats are accumulated in ce_data->health_stats, rest_* fields
 	 * are set on stats_close()
 	 */
-	if (batt_drv->chg_health.rest_state != CHG_HEALTH_INACTIVE) {
-		const struct gbms_ce_tier_stats *h = &batt_drv->ce_data.health_stats;
-		const struct gbms_ce_tier_stats *p = &batt_drv->ce_data.health_pause_stats;
+	if (data->chg_health.rest_state != CHG_HEALTH_INACTIVE) {
+		const struct gbms_ce_tier_stats *h = &data->ce.health_stats;
+		const struct gbms_ce_tier_stats *p = &data->ce.health_pause_stats;
 		const long elap_h = h->time_fast + h->time_taper + h->time_other;
 		const long elap_p = p->time_fast + p->time_taper + p->time_other;
 		const ktime_t now = get_boot_sec();
 		int vti;
 
-		vti = batt_chg_health_vti(&batt_drv->chg_health);
+		vti = batt_chg_health_vti(&data->chg_health);
 		len += scnprintf(&buf[len], PAGE_SIZE - len,
 				"\nH: %d %d %ld %ld %lld %lld %d",
-				batt_drv->chg_health.rest_state,
+				data->chg_health.rest_state,
 				vti, elap_h, elap_p, now,
-				batt_drv->chg_health.rest_deadline,
-				batt_drv->chg_health.always_on_soc);
+				data->chg_health.rest_deadline,
+				data->chg_health.always_on_soc);
 
 		/* NOTE: vtier_idx is -1, can also check elap  */
 		if (h->soc_in != -1)
@@ -6129,21 +7273,44 @@ static ssize_t batt_show_chg_details(struct device *dev,
 	len += scnprintf(&buf[len], PAGE_SIZE - len, "\n");
 
 	/* this was the last one (if present) */
-	if (qual_valid) {
-		len += batt_chg_qual_stats_cstr(
-			&buf[len], PAGE_SIZE - len, &batt_drv->ce_qual, true,
-			aacr_filtered_capacity(batt_drv, &batt_drv->ce_qual));
+	if (qual->valid) {
+		len += batt_chg_qual_stats_cstr(&buf[len], PAGE_SIZE - len,
+						&qual->ce, true,
+						qual->capacity);
 		len += scnprintf(&buf[len], PAGE_SIZE - len, "\n");
 	}
 
-	mutex_unlock(&batt_drv->stats_lock);
+	mutex_unlock(&batt_drv->attr_snap_lock);
 
+	batt_attr_lat_update(batt_drv, BATT_ATTR_CHG_DETAILS, start);
 	return len;
 }
 
 static const DEVICE_ATTR(charge_details, 0444, batt_show_chg_details,
 					       NULL);
 
+static ssize_t charge_details_bin_read(struct file *filp, struct kobject *kobj,
+				       struct bin_attribute *bin_attr,
+				       char *buf, loff_t pos, size_t size)
+{
+	struct batt_drv *batt_drv = batt_bin_attr_drvdata(kobj);
+	const ktime_t start = ktime_get();
+	ssize_t len;
+
+	len = batt_chg_snapshot_bin_read(batt_drv, filp, true, buf, pos, size);
+	batt_attr_lat_update(batt_drv, BATT_ATTR_CHG_DETAILS_BIN, start);
+	return len;
+}
+
+static struct bin_attribute bin_attr_charge_details_bin = {
+	.attr = {
+		.name = "charge_details_bin",
+		.mode = 0444,
+	},
+	.read = charge_details_bin_read,
+	.size = sizeof(struct batt_bin_ce_snapshot),
+};
+
 /* tier and soc details */
 static ssize_t batt_show_ttf_details(struct device *dev,
 				     struct device_attribute *attr, char *buf)
@@ -6151,25 +7318,24 @@ static ssize_t batt_show_ttf_details(struct device *dev,
 	struct power_supply *psy = container_of(dev, struct power_supply, dev);
 	struct batt_drv *batt_drv = (struct batt_drv *)
 					power_supply_get_drvdata(psy);
-	struct batt_ttf_stats *ttf_stats;
-	int len;
+	struct batt_ttf_stats *ttf_stats = &batt_drv->attr_ttf;
+	int len, last_soc;
 
 	if (!batt_drv->ssoc_state.buck_enabled)
 		return -ENODATA;
 
-	ttf_stats = kzalloc(sizeof(*ttf_stats), GFP_KERNEL);
-	if (!ttf_stats)
-		return -ENOMEM;
+	mutex_lock(&batt_drv->attr_snap_lock);
 
 	mutex_lock(&batt_drv->stats_lock);
 	/* update a private copy of ttf stats */
 	ttf_stats_update(ttf_stats_dup(ttf_stats, &batt_drv->ttf_stats),
-			 &batt_drv->ce_data, false);
+			 batt_drv->ce_data, false);
+	last_soc = batt_drv->ce_data->last_soc;
 	mutex_unlock(&batt_drv->stats_lock);
 
-	len = ttf_dump_details(buf, PAGE_SIZE, ttf_stats,
-			       batt_drv->ce_data.last_soc);
-	kfree(ttf_stats);
+	len = ttf_dump_details(buf, PAGE_SIZE, ttf_stats, last_soc);
+
+	mutex_unlock(&batt_drv->attr_snap_lock);
 
 	return len;
 }
@@ -6223,7 +7389,7 @@ static ssize_t batt_ctl_ttf_stats(struct device *dev,
 	switch (buf[0]) {
 	case 'u':
 	case 'U': /* force update */
-		ttf_stats_update(&batt_drv->ttf_stats, &batt_drv->ce_data,
+		ttf_stats_update(&batt_drv->ttf_stats, batt_drv->ce_data,
 				 (buf[0] == 'U'));
 		break;
 	default:
@@ -6473,7 +7639,37 @@ static ssize_t charge_deadline_dryrun_store(struct device *dev,
 	return count;
 }
 
-static DEVICE_ATTR_WO(charge_deadline_dryrun);
+/* plan for the dry run deadline if set, the active plan otherwise */
+static ssize_t charge_deadline_dryrun_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct power_supply *psy = container_of(dev, struct power_supply, dev);
+	struct batt_drv *batt_drv =
+		(struct batt_drv *)power_supply_get_drvdata(psy);
+	struct batt_chg_health *rest = &batt_drv->chg_health;
+	struct batt_chg_health_plan plan;
+	const ktime_t now = get_boot_sec();
+	ktime_t ttf = -1;
+	int len;
+
+	mutex_lock(&batt_drv->chg_lock);
+	if (rest->dry_run_deadline > 0) {
+		memset(&plan, 0, sizeof(plan));
+		if (batt_ttf_estimate(&ttf, batt_drv) < 0)
+			ttf = -1;
+		batt_health_plan(batt_drv, &plan, rest->dry_run_deadline, ttf,
+				 now);
+	} else {
+		plan = rest->plan;
+	}
+	mutex_unlock(&batt_drv->chg_lock);
+
+	len = batt_health_plan_cstr(buf, PAGE_SIZE, &plan, now);
+	return len;
+}
+
+static DEVICE_ATTR_RW(charge_deadline_dryrun);
 
 enum batt_ssoc_status {
 	BATT_SSOC_STATUS_UNKNOWN = 0,
@@ -6482,15 +7678,43 @@ enum batt_ssoc_status {
 	BATT_SSOC_STATUS_FULL = 3,
 };
 
-static ssize_t ssoc_details_show(struct device *dev,
-				 struct device_attribute *attr, char *buf)
+/* ssoc_details snapshot */
+struct batt_ssoc_snapshot {
+	int capacity;
+	qnum_t ssoc_gdf;
+	qnum_t ssoc_uic;
+	qnum_t ssoc_rl;
+	struct ssoc_uicurve ssoc_curve[UICURVE_MAX];
+	int ssoc_curve_type;
+	int rl_status;
+	int status;
+};
+
+#define BATT_BIN_UICURVE_MAX	3
+
+/* record of ssoc_details_bin, ssoc values are qnum (s32) */
+struct batt_bin_ssoc {
+	s32 capacity;
+	s32 ssoc_gdf;
+	s32 ssoc_uic;
+	s32 ssoc_rl;
+	s32 curve_real[BATT_BIN_UICURVE_MAX];
+	s32 curve_ui[BATT_BIN_UICURVE_MAX];
+	s32 ssoc_curve_type;
+	s32 rl_status;
+	s32 status;
+} __packed;
+
+struct batt_bin_ssoc_snapshot {
+	struct batt_attr_bin_hdr hdr;
+	struct batt_bin_ssoc rec;
+} __packed;
+
+static void batt_ssoc_snapshot(struct batt_drv *batt_drv,
+			       struct batt_ssoc_snapshot *snap)
 {
-	struct power_supply *psy = container_of(dev, struct power_supply, dev);
-	struct batt_drv *batt_drv = power_supply_get_drvdata(psy);
 	struct batt_ssoc_state *ssoc_state = &batt_drv->ssoc_state;
-	int len = 0;
 	enum batt_ssoc_status status = BATT_SSOC_STATUS_UNKNOWN;
-	char buff[UICURVE_BUF_SZ] = { 0 };
 
 	mutex_lock(&batt_drv->chg_lock);
 
@@ -6503,26 +7727,96 @@ static ssize_t ssoc_details_show(struct device *dev,
 			status = BATT_SSOC_STATUS_CONNECTED;
 	}
 
+	snap->capacity = ssoc_get_capacity(ssoc_state);
+	snap->ssoc_gdf = ssoc_state->ssoc_gdf;
+	snap->ssoc_uic = ssoc_state->ssoc_uic;
+	snap->ssoc_rl = ssoc_state->ssoc_rl;
+	memcpy(snap->ssoc_curve, ssoc_state->ssoc_curve,
+	       sizeof(snap->ssoc_curve));
+	snap->ssoc_curve_type = ssoc_state->ssoc_curve_type;
+	snap->rl_status = ssoc_state->rl_status;
+	snap->status = status;
+
+	mutex_unlock(&batt_drv->chg_lock);
+}
+
+static ssize_t ssoc_details_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct power_supply *psy = container_of(dev, struct power_supply, dev);
+	struct batt_drv *batt_drv = power_supply_get_drvdata(psy);
+	const ktime_t start = ktime_get();
+	struct batt_ssoc_snapshot snap;
+	char buff[UICURVE_BUF_SZ] = { 0 };
+	int len;
+
+	batt_ssoc_snapshot(batt_drv, &snap);
+
 	len = scnprintf(
-		buf, sizeof(ssoc_state->ssoc_state_cstr),
+		buf, sizeof(batt_drv->ssoc_state.ssoc_state_cstr),
 		"soc: l=%d%% gdf=%d.%02d uic=%d.%02d rl=%d.%02d\n"
 		"curve:%s\n"
 		"status: ct=%d rl=%d s=%d\n",
-		ssoc_get_capacity(ssoc_state), qnum_toint(ssoc_state->ssoc_gdf),
-		qnum_fracdgt(ssoc_state->ssoc_gdf),
-		qnum_toint(ssoc_state->ssoc_uic),
-		qnum_fracdgt(ssoc_state->ssoc_uic),
-		qnum_toint(ssoc_state->ssoc_rl),
-		qnum_fracdgt(ssoc_state->ssoc_rl),
-		ssoc_uicurve_cstr(buff, sizeof(buff), ssoc_state->ssoc_curve),
-		ssoc_state->ssoc_curve_type, ssoc_state->rl_status, status);
+		snap.capacity, qnum_toint(snap.ssoc_gdf),
+		qnum_fracdgt(snap.ssoc_gdf),
+		qnum_toint(snap.ssoc_uic),
+		qnum_fracdgt(snap.ssoc_uic),
+		qnum_toint(snap.ssoc_rl),
+		qnum_fracdgt(snap.ssoc_rl),
+		ssoc_uicurve_cstr(buff, sizeof(buff), snap.ssoc_curve),
+		snap.ssoc_curve_type, snap.rl_status, snap.status);
+
+	batt_attr_lat_update(batt_drv, BATT_ATTR_SSOC_DETAILS, start);
+	return len;
+}
 
-	mutex_unlock(&batt_drv->chg_lock);
+static const DEVICE_ATTR_RO(ssoc_details);
 
+static ssize_t ssoc_details_bin_read(struct file *filp, struct kobject *kobj,
+				     struct bin_attribute *bin_attr,
+				     char *buf, loff_t pos, size_t size)
+{
+	struct batt_drv *batt_drv = batt_bin_attr_drvdata(kobj);
+	const ktime_t start = ktime_get();
+	struct batt_bin_ssoc_snapshot bin;
+	struct batt_ssoc_snapshot snap;
+	ssize_t len;
+	int i;
+
+	BUILD_BUG_ON(UICURVE_MAX != BATT_BIN_UICURVE_MAX);
+
+	batt_ssoc_snapshot(batt_drv, &snap);
+
+	bin.hdr.version = BATT_ATTR_BIN_VERSION;
+	bin.hdr.seq = 0;
+	bin.hdr.count = 1;
+	bin.hdr.rec_size = sizeof(bin.rec);
+	bin.rec.capacity = snap.capacity;
+	bin.rec.ssoc_gdf = snap.ssoc_gdf;
+	bin.rec.ssoc_uic = snap.ssoc_uic;
+	bin.rec.ssoc_rl = snap.ssoc_rl;
+	for (i = 0; i < BATT_BIN_UICURVE_MAX; i++) {
+		bin.rec.curve_real[i] = snap.ssoc_curve[i].real;
+		bin.rec.curve_ui[i] = snap.ssoc_curve[i].ui;
+	}
+	bin.rec.ssoc_curve_type = snap.ssoc_curve_type;
+	bin.rec.rl_status = snap.rl_status;
+	bin.rec.status = snap.status;
+
+	len = memory_read_from_buffer(buf, size, &pos, &bin, sizeof(bin));
+
+	batt_attr_lat_update(batt_drv, BATT_ATTR_SSOC_DETAILS_BIN, start);
 	return len;
 }
 
-static const DEVICE_ATTR_RO(ssoc_details);
+static struct bin_attribute bin_attr_ssoc_details_bin = {
+	.attr = {
+		.name = "ssoc_details_bin",
+		.mode = 0444,
+	},
+	.read = ssoc_details_bin_read,
+	.size = sizeof(struct batt_bin_ssoc_snapshot),
+};
 
 static ssize_t show_bd_trickle_enable(struct device *dev,
 				      struct device_attribute *attr,
@@ -6696,7 +7990,7 @@ static ssize_t bd_clear_store(struct device *dev,
 		return ret;
 
 	if (val)
-		bd_trickle_reset(&batt_drv->ssoc_state, &batt_drv->ce_data);
+		bd_trickle_reset(&batt_drv->ssoc_state, batt_drv->ce_data);
 
 	return count;
 }
@@ -6716,7 +8010,7 @@ static ssize_t batt_show_time_to_ac(struct device *dev,
 	int rc;
 
 	rc = ttf_soc_estimate(&estimate, &batt_drv->ttf_stats,
-			      &batt_drv->ce_data, soc_raw,
+			      batt_drv->ce_data, soc_raw,
 			      soc_health - qnum_rconst(SOC_ROUND_BASE));
 	if (rc < 0)
 		estimate = -1;
@@ -6970,6 +8264,7 @@ static ssize_t aacr_state_store(struct device *dev,
 		batt_drv->aacr_state, state, batt_drv->aacr_algo, algo);
 	batt_drv->aacr_state = state;
 	batt_drv->aacr_algo = algo;
+	aacr_cache_invalidate(batt_drv);
 	return count;
 }
 
@@ -7124,19 +8419,38 @@ static ssize_t health_capacity_index_show(struct device *dev,
 
 static const DEVICE_ATTR_RO(health_capacity_index);
 
-static ssize_t health_index_stats_show(struct device *dev,
-				 struct device_attribute *attr, char *buf)
+/* one record per algo with a valid index, record of health_index_stats_bin */
+struct batt_bhi_stats_rec {
+	s32 algo;
+	s32 health_status;
+	s32 health_index;	/* rounded */
+	s32 cap_index;		/* rounded */
+	s32 imp_index;		/* rounded */
+	s32 swell_cumulative;
+	s32 capacity;
+	s32 impedance;
+	s32 battery_age;
+	s32 cycle_count;
+	s32 bpst_status;
+} __packed;
+
+struct batt_bhi_stats_snapshot {
+	struct batt_attr_bin_hdr hdr;
+	struct batt_bhi_stats_rec rec[BHI_ALGO_MAX];
+} __packed;
+
+static void batt_bhi_stats_snapshot(struct batt_drv *batt_drv,
+				    struct batt_bhi_stats_snapshot *snap)
 {
-	struct power_supply *psy = container_of(dev, struct power_supply, dev);
-	struct batt_drv *batt_drv = power_supply_get_drvdata(psy);
 	struct bhi_data *bhi_data = &batt_drv->health_data.bhi_data;
 	struct health_data *health_data = &batt_drv->health_data;
-	int len = 0, i;
+	int count = 0, i;
 
 	mutex_lock(&batt_drv->chg_lock);
 
 	for (i = 0; i < BHI_ALGO_MAX; i++) {
 		int health_index, health_status, cap_index, imp_index, sd_index;
+		struct batt_bhi_stats_rec *rec;
 
 		cap_index = bhi_calc_cap_index(i, batt_drv);
 		imp_index = bhi_calc_imp_index(i, health_data);
@@ -7154,28 +8468,86 @@ static ssize_t health_index_stats_show(struct device *dev,
 			 bhi_data->battery_age,
 			 bhi_data->cycle_count);
 
+		rec = &snap->rec[count++];
+		rec->algo = i;
+		rec->health_status = health_status;
+		rec->health_index = BHI_ROUND_INDEX(health_index);
+		rec->cap_index = BHI_ROUND_INDEX(cap_index);
+		rec->imp_index = BHI_ROUND_INDEX(imp_index);
+		rec->swell_cumulative = bhi_data->swell_cumulative;
+		rec->capacity = bhi_health_get_capacity(i, bhi_data);
+		rec->impedance = bhi_health_get_impedance(i, bhi_data);
+		rec->battery_age = bhi_data->battery_age;
+		rec->cycle_count = bhi_data->cycle_count;
+		rec->bpst_status = batt_bpst_stats_update(batt_drv);
+	}
+
+	mutex_unlock(&batt_drv->chg_lock);
+
+	snap->hdr.version = BATT_ATTR_BIN_VERSION;
+	snap->hdr.seq = 0;
+	snap->hdr.count = count;
+	snap->hdr.rec_size = sizeof(snap->rec[0]);
+}
+
+static ssize_t health_index_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct power_supply *psy = container_of(dev, struct power_supply, dev);
+	struct batt_drv *batt_drv = power_supply_get_drvdata(psy);
+	const ktime_t start = ktime_get();
+	struct batt_bhi_stats_snapshot snap;
+	int len = 0, i;
+
+	batt_bhi_stats_snapshot(batt_drv, &snap);
+
+	for (i = 0; i < snap.hdr.count; i++) {
+		const struct batt_bhi_stats_rec *rec = &snap.rec[i];
 
 		len += scnprintf(&buf[len], PAGE_SIZE - len,
 				 "%d: %d, %d,%d,%d %d,%d,%d %d,%d, %d\n",
-				 i, health_status,
-				 BHI_ROUND_INDEX(health_index),
-				 BHI_ROUND_INDEX(cap_index),
-				 BHI_ROUND_INDEX(imp_index),
-				 bhi_data->swell_cumulative,
-				 bhi_health_get_capacity(i, bhi_data),
-				 bhi_health_get_impedance(i, bhi_data),
-				 bhi_data->battery_age,
-				 bhi_data->cycle_count,
-				 batt_bpst_stats_update(batt_drv));
+				 rec->algo, rec->health_status,
+				 rec->health_index, rec->cap_index,
+				 rec->imp_index, rec->swell_cumulative,
+				 rec->capacity, rec->impedance,
+				 rec->battery_age, rec->cycle_count,
+				 rec->bpst_status);
 	}
 
-	mutex_unlock(&batt_drv->chg_lock);
-
+	batt_attr_lat_update(batt_drv, BATT_ATTR_HEALTH_INDEX_STATS, start);
 	return len;
 }
 
 static const DEVICE_ATTR_RO(health_index_stats);
 
+static ssize_t health_index_stats_bin_read(struct file *filp,
+					   struct kobject *kobj,
+					   struct bin_attribute *bin_attr,
+					   char *buf, loff_t pos, size_t size)
+{
+	struct batt_drv *batt_drv = batt_bin_attr_drvdata(kobj);
+	const ktime_t start = ktime_get();
+	struct batt_bhi_stats_snapshot snap;
+	ssize_t len;
+
+	batt_bhi_stats_snapshot(batt_drv, &snap);
+	len = memory_read_from_buffer(buf, size, &pos, &snap,
+				      sizeof(snap.hdr) +
+				      snap.hdr.count * sizeof(snap.rec[0]));
+
+	batt_attr_lat_update(batt_drv, BATT_ATTR_HEALTH_INDEX_STATS_BIN, start);
+	return len;
+}
+
+static struct bin_attribute bin_attr_health_index_stats_bin = {
+	.attr = {
+		.name = "health_index_stats_bin",
+		.mode = 0444,
+	},
+	.read = health_index_stats_bin_read,
+	.size = sizeof(struct batt_bhi_stats_snapshot),
+};
+
 static ssize_t health_algo_store(struct device *dev,
 				 struct device_attribute *attr,
 				 const char *buf, size_t count)
@@ -7921,6 +9293,71 @@ static ssize_t power_metrics_current_show(struct device *dev,
 
 static const DEVICE_ATTR_RO(power_metrics_current);
 
+static ssize_t energy_rate_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct power_supply *psy = container_of(dev, struct power_supply, dev);
+	struct batt_drv *batt_drv = power_supply_get_drvdata(psy);
+	struct batt_energy *energy = &batt_drv->energy;
+	unsigned int value;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret < 0)
+		return ret;
+	if (value < BATT_ENERGY_RATE_MIN_MS)
+		return -EINVAL;
+
+	mutex_lock(&energy->lock);
+	energy->rate_ms = value;
+	energy->bin.rate_ms = value;
+	mutex_unlock(&energy->lock);
+
+	gbms_mod_delayed_work(&energy->work, msecs_to_jiffies(value));
+	return count;
+}
+
+static ssize_t energy_rate_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct power_supply *psy = container_of(dev, struct power_supply, dev);
+	struct batt_drv *batt_drv = power_supply_get_drvdata(psy);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", batt_drv->energy.rate_ms);
+}
+
+static const DEVICE_ATTR_RW(energy_rate);
+
+static ssize_t energy_bin_read(struct file *filp, struct kobject *kobj,
+			       struct bin_attribute *bin_attr,
+			       char *buf, loff_t pos, size_t size)
+{
+	struct batt_drv *batt_drv = batt_bin_attr_drvdata(kobj);
+	struct batt_energy *energy = &batt_drv->energy;
+	ssize_t len;
+
+	mutex_lock(&energy->lock);
+	energy->bin.hdr.version = BATT_ATTR_BIN_VERSION;
+	energy->bin.hdr.seq = energy->bin.ckpt_count;
+	energy->bin.hdr.count = BATT_ENERGY_CKPT_MAX;
+	energy->bin.hdr.rec_size = sizeof(energy->bin.ckpt[0]);
+	len = memory_read_from_buffer(buf, size, &pos, &energy->bin,
+				      sizeof(energy->bin));
+	mutex_unlock(&energy->lock);
+
+	return len;
+}
+
+static struct bin_attribute bin_attr_energy_bin = {
+	.attr = {
+		.name = "energy_bin",
+		.mode = 0444,
+	},
+	.read = energy_bin_read,
+	.size = sizeof(struct batt_energy_bin),
+};
+
 static ssize_t dev_sn_store(struct device *dev,
 			    struct device_attribute *attr,
 			    const char *buf, size_t count)
@@ -8004,6 +9441,18 @@ static int batt_init_fs(struct batt_drv *batt_drv)
 	if (ret)
 		dev_err(&batt_drv->psy->dev, "Failed to create ssoc_details\n");
 
+	ret = device_create_bin_file(&batt_drv->psy->dev, &bin_attr_charge_stats_bin);
+	if (ret)
+		dev_err(&batt_drv->psy->dev, "Failed to create charge_stats_bin\n");
+
+	ret = device_create_bin_file(&batt_drv->psy->dev, &bin_attr_charge_details_bin);
+	if (ret)
+		dev_err(&batt_drv->psy->dev, "Failed to create charge_details_bin\n");
+
+	ret = device_create_bin_file(&batt_drv->psy->dev, &bin_attr_ssoc_details_bin);
+	if (ret)
+		dev_err(&batt_drv->psy->dev, "Failed to create ssoc_details_bin\n");
+
 	/* adaptive charging */
 	ret = device_create_file(&batt_drv->psy->dev, &dev_attr_charge_deadline);
 	if (ret)
@@ -8133,6 +9582,9 @@ static int batt_init_fs(struct batt_drv *batt_drv)
 	ret = device_create_file(&batt_drv->psy->dev, &dev_attr_health_index_stats);
 	if (ret)
 		dev_err(&batt_drv->psy->dev, "Failed to create health index stats\n");
+	ret = device_create_bin_file(&batt_drv->psy->dev, &bin_attr_health_index_stats_bin);
+	if (ret)
+		dev_err(&batt_drv->psy->dev, "Failed to create health index stats bin\n");
 	ret = device_create_file(&batt_drv->psy->dev, &dev_attr_health_impedance_index);
 	if (ret)
 		dev_err(&batt_drv->psy->dev, "Failed to create health perf index\n");
@@ -8186,6 +9638,12 @@ static int batt_init_fs(struct batt_drv *batt_drv)
 	ret = device_create_file(&batt_drv->psy->dev, &dev_attr_power_metrics_current);
 	if (ret)
 		dev_err(&batt_drv->psy->dev, "Failed to create power_metrics_current\n");
+	ret = device_create_file(&batt_drv->psy->dev, &dev_attr_energy_rate);
+	if (ret)
+		dev_err(&batt_drv->psy->dev, "Failed to create energy_rate\n");
+	ret = device_create_bin_file(&batt_drv->psy->dev, &bin_attr_energy_bin);
+	if (ret)
+		dev_err(&batt_drv->psy->dev, "Failed to create energy_bin\n");
 	ret = device_create_file(&batt_drv->psy->dev, &dev_attr_dev_sn);
 	if (ret)
 		dev_err(&batt_drv->psy->dev, "Failed to create dev sn\n");
@@ -8199,6 +9657,55 @@ static int batt_init_fs(struct batt_drv *batt_drv)
 
 }
 
+static ssize_t debug_get_attr_latency(struct file *filp, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct batt_drv *batt_drv = (struct batt_drv *)filp->private_data;
+	struct batt_attr_lat lat[BATT_ATTR_LAT_COUNT];
+	char *tmp;
+	int idx, len = 0;
+
+	tmp = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	spin_lock(&batt_drv->attr_lat_lock);
+	memcpy(lat, batt_drv->attr_lat, sizeof(lat));
+	spin_unlock(&batt_drv->attr_lat_lock);
+
+	for (idx = 0; idx < BATT_ATTR_LAT_COUNT; idx++) {
+		const u64 avg = lat[idx].count ?
+				div_u64(lat[idx].total_us, lat[idx].count) : 0;
+
+		len += scnprintf(&tmp[len], PAGE_SIZE - len,
+				 "%-24s cnt=%u avg=%lluus max=%uus\n",
+				 batt_attr_lat_names[idx], lat[idx].count,
+				 avg, lat[idx].max_us);
+	}
+
+	len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+	kfree(tmp);
+
+	return len;
+}
+
+/* any write resets the counters */
+static ssize_t debug_set_attr_latency(struct file *filp,
+				      const char __user *user_buf,
+				      size_t count, loff_t *ppos)
+{
+	struct batt_drv *batt_drv = (struct batt_drv *)filp->private_data;
+
+	spin_lock(&batt_drv->attr_lat_lock);
+	memset(batt_drv->attr_lat, 0, sizeof(batt_drv->attr_lat));
+	spin_unlock(&batt_drv->attr_lat_lock);
+
+	return count;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_attr_latency_fops, debug_get_attr_latency,
+			debug_set_attr_latency);
+
 static int batt_init_debugfs(struct batt_drv *batt_drv)
 {
 	struct dentry *de = NULL;
@@ -8233,6 +9740,8 @@ static int batt_init_debugfs(struct batt_drv *batt_drv)
 	/* aacr test */
 	debugfs_create_u32("fake_aacr_cc", 0600, de,
 			    &batt_drv->fake_aacr_cc);
+	debugfs_create_file("aacr_table", 0400, de, batt_drv,
+			    &debug_aacr_table_fops);
 
 	/* health charging (adaptive charging) */
 	debugfs_create_file("chg_health_thr_soc", 0600, de, batt_drv,
@@ -8253,6 +9762,9 @@ static int batt_init_debugfs(struct batt_drv *batt_drv)
 
 	/* power metrics */
 	debugfs_create_file("power_metrics", 0400, de, batt_drv, &debug_power_metrics_fops);
+	debugfs_create_u32("energy_ckpt_s", 0600, de, &batt_drv->energy.ckpt_s);
+	debugfs_create_u32("energy_dropped", 0400, de, &batt_drv->energy.dropped);
+	debugfs_create_file("attr_latency", 0600, de, batt_drv, &debug_attr_latency_fops);
 
 	/* bhi fullcapnom count */
 	debugfs_create_u32("bhi_w_ci", 0644, de, &batt_drv->health_data.bhi_w_ci);
@@ -8332,6 +9844,8 @@ static int batt_bpst_init_debugfs(struct batt_drv *batt_drv)
 
 	debugfs_create_file("bpst_sbd_status", 0600, de, batt_drv,
 			    &debug_bpst_sbd_status_fops);
+	debugfs_create_file("bpst_det", 0400, de, batt_drv,
+			    &debug_bpst_det_fops);
 	debugfs_create_u32("bpst_count_threshold", 0600, de,
 			    &batt_drv->bpst_state.bpst_count_threshold);
 	debugfs_create_u32("bpst_chg_rate", 0600, de,
@@ -8750,7 +10264,7 @@ static void batt_init_temp_filter(struct batt_drv *batt_drv)
 static void google_battery_temp_filter_work(struct work_struct *work)
 {
 	struct batt_drv *batt_drv = container_of(work, struct batt_drv, temp_filter.work.work);
-	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data.adapter_details;
+	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data->adapter_details;
 	struct batt_temp_filter *temp_filter = &batt_drv->temp_filter;
 	int interval = temp_filter->default_interval;
 	union power_supply_propval val;
@@ -8875,7 +10389,7 @@ static int point_full_ui_soc_cb(struct gvotable_election *el,
 static void google_battery_work(struct work_struct *work)
 {
 	struct batt_drv *batt_drv =
-	    container_of(work, struct batt_drv, batt_work.work);
+	    container_of(work, struct batt_drv, batt_work.dwork.work);
 	struct power_supply *fg_psy = batt_drv->fg_psy;
 	struct batt_ssoc_state *ssoc_state = &batt_drv->ssoc_state;
 	int update_interval = batt_drv->batt_update_interval;
@@ -8887,7 +10401,7 @@ static void google_battery_work(struct work_struct *work)
 
 	pm_runtime_get_sync(batt_drv->device);
 	if (!batt_drv->resume_complete) {
-		schedule_delayed_work(&batt_drv->batt_work, msecs_to_jiffies(100));
+		gbms_queue_delayed_work(&batt_drv->batt_work, msecs_to_jiffies(100));
 		pm_runtime_put_sync(batt_drv->device);
 		return;
 	}
@@ -8982,7 +10496,7 @@ static void google_battery_work(struct work_struct *work)
 		full = (ssoc == SSOC_FULL);
 		if (full && !batt_drv->batt_full) {
 			batt_log_csi_ttf_info(batt_drv);
-			batt_chg_stats_pub(batt_drv, "100%", false, true);
+			batt_chg_stats_pub(batt_drv, "100%", false, true, false);
 		}
 		batt_drv->batt_full = full;
 
@@ -9121,8 +10635,8 @@ reschedule:
 
 	if (update_interval) {
 		pr_debug("rerun battery work in %d ms\n", update_interval);
-		schedule_delayed_work(&batt_drv->batt_work,
-				      msecs_to_jiffies(update_interval));
+		gbms_queue_delayed_work(&batt_drv->batt_work,
+					msecs_to_jiffies(update_interval));
 	}
 
 
@@ -9132,7 +10646,7 @@ reschedule:
 static void power_metrics_data_work(struct work_struct *work)
 {
 	struct batt_drv *batt_drv = container_of(work, struct batt_drv,
-						 power_metrics.work.work);
+						 power_metrics.work.dwork.work);
 	const unsigned int idx = batt_drv->power_metrics.idx;
 	unsigned long cc, vbat;
 	unsigned int next_work = batt_drv->power_metrics.polling_rate * 1000;
@@ -9170,7 +10684,130 @@ static void power_metrics_data_work(struct work_struct *work)
 	batt_drv->power_metrics.data[batt_drv->power_metrics.idx].time = now;
 
 error:
-	schedule_delayed_work(&batt_drv->power_metrics.work, msecs_to_jiffies(next_work));
+	gbms_queue_delayed_work(&batt_drv->power_metrics.work, msecs_to_jiffies(next_work));
+}
+
+static enum batt_energy_src batt_energy_src(const struct batt_drv *batt_drv)
+{
+	const union gbms_ce_adapter_details *ad = &batt_drv->ce_data->adapter_details;
+
+	if (chg_state_is_disconnected(&batt_drv->chg_state))
+		return BATT_ENERGY_SRC_NONE;
+	if (batt_drv->chg_state.f.flags & GBMS_CS_FLAG_DIRECT_CHG)
+		return BATT_ENERGY_SRC_DC;
+
+	switch (ad->ad_type) {
+	case CHG_EV_ADAPTER_TYPE_WLC:
+	case CHG_EV_ADAPTER_TYPE_WLC_EPP:
+	case CHG_EV_ADAPTER_TYPE_WLC_SPP:
+	case CHG_EV_ADAPTER_TYPE_WPC_EPP:
+	case CHG_EV_ADAPTER_TYPE_WPC_GPP:
+	case CHG_EV_ADAPTER_TYPE_WPC_10W:
+	case CHG_EV_ADAPTER_TYPE_WPC_BPP:
+	case CHG_EV_ADAPTER_TYPE_WPC_L7:
+		return BATT_ENERGY_SRC_WLC;
+	case CHG_EV_ADAPTER_TYPE_EXT:
+	case CHG_EV_ADAPTER_TYPE_EXT1:
+	case CHG_EV_ADAPTER_TYPE_EXT2:
+	case CHG_EV_ADAPTER_TYPE_EXT_UNKNOWN:
+		return BATT_ENERGY_SRC_EXT;
+	default:
+		break;
+	}
+
+	return BATT_ENERGY_SRC_WIRED;
+}
+
+/* call holding energy->lock, trapezoidal integration of the energy */
+static void batt_energy_integrate(struct batt_energy *energy,
+				  enum batt_energy_src src, int cc, int vbat,
+				  u64 now_ms)
+{
+	struct batt_energy_totals *tot = &energy->bin.now;
+	const int delta_uah = cc - energy->prev_cc;
+	const u64 vavg = ((u64)vbat + energy->prev_vbat) / 2;
+	u64 nrg_pwh;
+
+	if (abs(delta_uah) > BATT_ENERGY_MAX_DELTA_UAH) {
+		energy->dropped++;
+		return;
+	}
+
+	nrg_pwh = (u64)abs(delta_uah) * vavg;
+	if (delta_uah > 0) {
+		tot->chg_in_uah += delta_uah;
+		tot->nrg_in_pwh += nrg_pwh;
+		tot->src_nrg_in_pwh[src] += nrg_pwh;
+	} else {
+		tot->chg_out_uah += -delta_uah;
+		tot->nrg_out_pwh += nrg_pwh;
+		tot->src_nrg_out_pwh[src] += nrg_pwh;
+	}
+
+	tot->time_ms = now_ms;
+}
+
+/* call holding energy->lock */
+static void batt_energy_checkpoint(struct batt_energy *energy, u64 now_ms)
+{
+	struct batt_energy_bin *bin = &energy->bin;
+
+	if (energy->ckpt_last_ms &&
+	    now_ms - energy->ckpt_last_ms < (u64)energy->ckpt_s * MSEC_PER_SEC)
+		return;
+
+	bin->ckpt[bin->ckpt_next] = bin->now;
+	bin->ckpt_next = (bin->ckpt_next + 1) % BATT_ENERGY_CKPT_MAX;
+	bin->ckpt_count++;
+	bin->ckpt_s = energy->ckpt_s;
+	energy->ckpt_last_ms = now_ms;
+}
+
+static void batt_energy_work(struct work_struct *work)
+{
+	struct batt_drv *batt_drv = container_of(work, struct batt_drv,
+						 energy.work.dwork.work);
+	struct batt_energy *energy = &batt_drv->energy;
+	const u64 now_ms = ktime_to_ms(ktime_get_boottime());
+	unsigned int next_work = energy->rate_ms;
+	enum batt_energy_src src;
+	int cc, vbat;
+
+	if (!batt_drv->fg_psy)
+		goto error;
+
+	pm_runtime_get_sync(batt_drv->device);
+	if (!batt_drv->resume_complete) {
+		next_work = 100;
+		pm_runtime_put_sync(batt_drv->device);
+		goto error;
+	}
+	pm_runtime_put_sync(batt_drv->device);
+
+	cc = GPSY_GET_PROP(batt_drv->fg_psy, POWER_SUPPLY_PROP_CHARGE_COUNTER);
+	vbat = GPSY_GET_PROP(batt_drv->fg_psy, POWER_SUPPLY_PROP_VOLTAGE_NOW);
+	if (cc < 0 || vbat < 0) {
+		if (cc == -EAGAIN || vbat == -EAGAIN)
+			next_work = 100;
+		goto error;
+	}
+
+	src = batt_energy_src(batt_drv);
+
+	mutex_lock(&energy->lock);
+	if (energy->prev_valid)
+		batt_energy_integrate(energy, src, cc, vbat, now_ms);
+	else
+		energy->bin.now.time_ms = now_ms;
+	energy->prev_cc = cc;
+	energy->prev_vbat = vbat;
+	energy->prev_valid = true;
+
+	batt_energy_checkpoint(energy, now_ms);
+	mutex_unlock(&energy->lock);
+
+error:
+	gbms_queue_delayed_work(&energy->work, msecs_to_jiffies(next_work));
 }
 
 /* ------------------------------------------------------------------------- */
@@ -9426,7 +11063,7 @@ static int gbatt_get_property(struct power_supply *psy,
 
 	switch (psp) {
 	case GBMS_PROP_ADAPTER_DETAILS:
-		val->intval = batt_drv->ce_data.adapter_details.v;
+		val->intval = batt_drv->ce_data->adapter_details.v;
 		break;
 
 	case GBMS_PROP_DEAD_BATTERY:
@@ -9616,7 +11253,7 @@ static int gbatt_set_property(struct power_supply *psy,
 	switch (psp) {
 	case GBMS_PROP_ADAPTER_DETAILS:
 		mutex_lock(&batt_drv->stats_lock);
-		batt_drv->ce_data.adapter_details.v = val->intval;
+		batt_drv->ce_data->adapter_details.v = val->intval;
 		mutex_unlock(&batt_drv->stats_lock);
 	break;
 
@@ -9909,7 +11546,6 @@ static void google_battery_init_work(struct work_struct *work)
 
 	mutex_init(&batt_drv->chg_lock);
 	mutex_init(&batt_drv->batt_lock);
-	mutex_init(&batt_drv->stats_lock);
 	mutex_init(&batt_drv->cc_data.lock);
 	mutex_init(&batt_drv->bpst_state.lock);
 
@@ -9997,6 +11633,7 @@ static void google_battery_init_work(struct work_struct *work)
 
 	/* cycle count is cached: read here bc SSOC, chg_profile might use it */
 	batt_update_cycle_count(batt_drv);
+	aacr_cache_update_full_cap_nom(batt_drv);
 
 	ret = ssoc_init(batt_drv);
 	if (ret < 0 && batt_drv->batt_present)
@@ -10019,8 +11656,6 @@ static void google_battery_init_work(struct work_struct *work)
 	if (batt_drv->temp_filter.enable)
 		batt_init_temp_filter(batt_drv);
 
-	cev_stats_init(&batt_drv->ce_data, &batt_drv->chg_profile);
-	cev_stats_init(&batt_drv->ce_qual, &batt_drv->chg_profile);
 	batt_init_csi_stat(batt_drv);
 
 	batt_drv->fg_nb.notifier_call = psy_changed;
@@ -10198,15 +11833,17 @@ static void google_battery_init_work(struct work_struct *work)
 	}
 
 	/* power metrics */
-	schedule_delayed_work(&batt_drv->power_metrics.work,
-			      msecs_to_jiffies(batt_drv->power_metrics.polling_rate * 1000));
+	gbms_queue_delayed_work(&batt_drv->power_metrics.work,
+				msecs_to_jiffies(batt_drv->power_metrics.polling_rate * 1000));
+	gbms_queue_delayed_work(&batt_drv->energy.work,
+				msecs_to_jiffies(batt_drv->energy.rate_ms));
 
 	pr_info("google_battery init_work done\n");
 
 	batt_drv->init_complete = true;
 	batt_drv->resume_complete = true;
 
-	schedule_delayed_work(&batt_drv->batt_work, 0);
+	gbms_queue_delayed_work(&batt_drv->batt_work, 0);
 
 	return;
 
@@ -10291,8 +11928,13 @@ static int google_battery_probe(struct platform_device *pdev)
 	}
 
 	INIT_DELAYED_WORK(&batt_drv->init_work, google_battery_init_work);
-	INIT_DELAYED_WORK(&batt_drv->batt_work, google_battery_work);
-	INIT_DELAYED_WORK(&batt_drv->power_metrics.work, power_metrics_data_work);
+	gbms_init_delayed_work(&batt_drv->batt_work, google_battery_work,
+			       GBMS_WQ_CONTROL);
+	gbms_init_delayed_work(&batt_drv->power_metrics.work,
+			       power_metrics_data_work, GBMS_WQ_STATS);
+	gbms_init_delayed_work(&batt_drv->energy.work, batt_energy_work,
+			       GBMS_WQ_STATS);
+	mutex_init(&batt_drv->energy.lock);
 	INIT_DELAYED_WORK(&batt_drv->temp_filter.work, google_battery_temp_filter_work);
 	platform_set_drvdata(pdev, batt_drv);
 
@@ -10398,6 +12040,19 @@ static int google_battery_probe(struct platform_device *pdev)
 	batt_drv->aacr_cycle_grace = AACR_START_CYCLE_DEFAULT;
 	batt_drv->aacr_cycle_max = AACR_MAX_CYCLE_DEFAULT;
 	batt_drv->aacr_state = BATT_AACR_DISABLED;
+	/* aacr_state_store() drops the cache */
+	spin_lock_init(&batt_drv->aacr_cache.lock);
+
+	/* charge stats, the sysfs nodes can be read before init_work */
+	mutex_init(&batt_drv->stats_lock);
+	mutex_init(&batt_drv->attr_snap_lock);
+	spin_lock_init(&batt_drv->attr_lat_lock);
+	cev_stats_init(&batt_drv->ce_event[0], &batt_drv->chg_profile);
+	batt_drv->ce_data = &batt_drv->ce_event[0];
+	batt_drv->ce_pub = &batt_drv->ce_event[1];
+	batt_drv->ce_spare = &batt_drv->ce_event[2];
+	batt_drv->ce_spare_ready = true;
+	RCU_INIT_POINTER(batt_drv->ce_qual, NULL);
 
 	/* create the sysfs node */
 	batt_init_fs(batt_drv);
@@ -10413,6 +12068,10 @@ static int google_battery_probe(struct platform_device *pdev)
 	/* power metrics */
 	batt_drv->power_metrics.polling_rate = 30;
 	batt_drv->power_metrics.interval = 120;
+	batt_drv->energy.rate_ms = BATT_ENERGY_RATE_DEFAULT_MS;
+	batt_drv->energy.ckpt_s = BATT_ENERGY_CKPT_DEFAULT_S;
+	batt_drv->energy.bin.rate_ms = BATT_ENERGY_RATE_DEFAULT_MS;
+	batt_drv->energy.bin.ckpt_s = BATT_ENERGY_CKPT_DEFAULT_S;
 
 	/* Date of manufacturing of the battery */
 	ret = batt_get_manufacture_date(&batt_drv->health_data.bhi_data);
@@ -10469,6 +12128,9 @@ static int google_battery_remove(struct platform_device *pdev)
 	batt_drv->charging_policy_votable = NULL;
 	batt_drv->point_full_ui_soc_votable = NULL;
 
+	/* batt_chg_stats_spare_release() */
+	rcu_barrier();
+
 	return 0;
 }
 
@@ -10495,7 +12157,7 @@ static int gbatt_pm_resume(struct device *dev)
 	batt_drv->temp_filter.resume_delay = true;
 	pm_runtime_put_sync(batt_drv->device);
 
-	mod_delayed_work(system_wq, &batt_drv->batt_work, 0);
+	gbms_mod_delayed_work(&batt_drv->batt_work, 0);
 
 	return 0;
 }
@@ -23,12 +23,15 @@
 #define gbms_err(p, fmt, ...)	\
 	pr_err("%s: " fmt, gbms_owner(p), ##__VA_ARGS__)
 
+#include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/printk.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/of.h>
+#include <linux/ktime.h>
 #include <linux/regmap.h>
+#include <linux/seq_file.h>
 
 #include "google_psy.h"
 #include "google_bms.h"
@@ -700,18 +703,34 @@ int gbms_get_property(struct power_supply *psy, enum gbms_property psp,
 }
 EXPORT_SYMBOL_GPL(gbms_get_property);
 
+/*
+ * Format the message at most once: when both logbuffer and printk are enabled
+ * the message is formatted on the stack and the same text is handed to both,
+ * nothing is formatted when both are disabled. logbuffer truncates entries to
+ * LOG_BUFFER_ENTRY_SIZE so the printk copy is truncated to the same size.
+ */
 void gbms_logbuffer_prlog(struct logbuffer *log, int level, int debug_no_logbuffer,
 			  int debug_printk_prlog, const char *f, ...)
 {
+	const bool to_logbuffer = log && !debug_no_logbuffer;
+	const bool to_printk = level <= debug_printk_prlog;
+	char buff[LOG_BUFFER_ENTRY_SIZE];
 	va_list args;
 
+	if (!to_logbuffer && !to_printk)
+		return;
+
 	va_start(args, f);
 
-	if (!debug_no_logbuffer)
+	if (!to_printk) {
 		logbuffer_vlog(log, f, args);
-
-	if (level <= debug_printk_prlog)
+	} else if (!to_logbuffer) {
 		vprintk(f, args);
+	} else {
+		vscnprintf(buff, sizeof(buff), f, args);
+		logbuffer_log(log, "%s", buff);
+		pr_info("%s", buff);
+	}
 
 	va_end(args);
 }
@@ -916,3 +935,195 @@ void gbms_log_cstr_handler(struct logbuffer *log, char *buf, int len)
 }
 EXPORT_SYMBOL_GPL(gbms_log_cstr_handler);
 
+/* ------------------------------------------------------------------------ */
+
+/* log2 buckets in ms: [0] < 1ms, [1] < 2ms, ... last is everything else */
+#define GBMS_WQ_HIST_BUCKETS	12
+
+struct gbms_wq_stats {
+	spinlock_t lock;
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+	u32 hist[GBMS_WQ_HIST_BUCKETS];
+};
+
+static const char *gbms_wq_names[GBMS_WQ_COUNT] = {
+	[GBMS_WQ_SAFETY] = "gbms_safety_wq",
+	[GBMS_WQ_CONTROL] = "gbms_control_wq",
+	[GBMS_WQ_STATS] = "gbms_stats_wq",
+};
+
+static struct workqueue_struct *gbms_wq[GBMS_WQ_COUNT];
+static struct gbms_wq_stats gbms_wq_stats[GBMS_WQ_COUNT];
+static struct dentry *gbms_wq_de;
+
+/* fall back to the system queues when the module init failed */
+static struct workqueue_struct *gbms_wq_get(enum gbms_wq_class wq_class)
+{
+	if (gbms_wq[wq_class])
+		return gbms_wq[wq_class];
+
+	return wq_class == GBMS_WQ_STATS ? system_unbound_wq :
+					   system_highpri_wq;
+}
+
+static void gbms_wq_account(enum gbms_wq_class wq_class, ktime_t due)
+{
+	struct gbms_wq_stats *stats = &gbms_wq_stats[wq_class];
+	const s64 lat_us = max_t(s64, ktime_us_delta(ktime_get(), due), 0);
+	const u32 lat_ms = min_t(s64, lat_us / USEC_PER_MSEC, U32_MAX);
+	int bucket = lat_ms ? fls(lat_ms) : 0;
+	unsigned long flags;
+
+	if (bucket >= GBMS_WQ_HIST_BUCKETS)
+		bucket = GBMS_WQ_HIST_BUCKETS - 1;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->count++;
+	stats->total_us += lat_us;
+	if (lat_us > stats->max_us)
+		stats->max_us = min_t(s64, lat_us, U32_MAX);
+	stats->hist[bucket]++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+static void gbms_work_fn(struct work_struct *work)
+{
+	struct gbms_delayed_work *gw =
+		container_of(work, struct gbms_delayed_work, dwork.work);
+
+	gbms_wq_account(gw->wq_class, READ_ONCE(gw->due));
+	gw->func(work);
+}
+
+void gbms_init_delayed_work(struct gbms_delayed_work *gw, work_func_t func,
+			    enum gbms_wq_class wq_class)
+{
+	INIT_DELAYED_WORK(&gw->dwork, gbms_work_fn);
+	gw->func = func;
+	gw->wq_class = wq_class;
+	gw->due = 0;
+}
+EXPORT_SYMBOL_GPL(gbms_init_delayed_work);
+
+/*
+ * same as queue_delayed_work(): doesn't change the delay of a pending work.
+ * ->due is set before queuing since the work can run before this returns,
+ * it is not touched when the work is already pending.
+ */
+bool gbms_queue_delayed_work(struct gbms_delayed_work *gw, unsigned long delay)
+{
+	if (delayed_work_pending(&gw->dwork))
+		return false;
+
+	WRITE_ONCE(gw->due, ktime_add_ms(ktime_get(), jiffies_to_msecs(delay)));
+
+	return queue_delayed_work(gbms_wq_get(gw->wq_class), &gw->dwork, delay);
+}
+EXPORT_SYMBOL_GPL(gbms_queue_delayed_work);
+
+/* same as mod_delayed_work() */
+bool gbms_mod_delayed_work(struct gbms_delayed_work *gw, unsigned long delay)
+{
+	WRITE_ONCE(gw->due, ktime_add_ms(ktime_get(), jiffies_to_msecs(delay)));
+
+	return mod_delayed_work(gbms_wq_get(gw->wq_class), &gw->dwork, delay);
+}
+EXPORT_SYMBOL_GPL(gbms_mod_delayed_work);
+
+static int gbms_wq_latency_show(struct seq_file *m, void *data)
+{
+	int i, j;
+
+	for (i = 0; i < GBMS_WQ_COUNT; i++) {
+		struct gbms_wq_stats *stats = &gbms_wq_stats[i];
+		struct gbms_wq_stats snap;
+		unsigned long flags;
+
+		spin_lock_irqsave(&stats->lock, flags);
+		snap = *stats;
+		spin_unlock_irqrestore(&stats->lock, flags);
+
+		seq_printf(m, "%s: cnt=%u max_us=%u avg_us=%llu hist_ms=",
+			   gbms_wq_names[i], snap.count, snap.max_us,
+			   snap.count ? div_u64(snap.total_us, snap.count) : 0);
+		for (j = 0; j < GBMS_WQ_HIST_BUCKETS; j++)
+			seq_printf(m, "%s%u", j ? " " : "", snap.hist[j]);
+		seq_puts(m, "\n");
+	}
+
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(gbms_wq_latency);
+
+/* any write resets the statistics */
+static ssize_t gbms_wq_reset_write(struct file *filp, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	int i;
+
+	for (i = 0; i < GBMS_WQ_COUNT; i++) {
+		struct gbms_wq_stats *stats = &gbms_wq_stats[i];
+		unsigned long flags;
+
+		spin_lock_irqsave(&stats->lock, flags);
+		stats->count = 0;
+		stats->max_us = 0;
+		stats->total_us = 0;
+		memset(stats->hist, 0, sizeof(stats->hist));
+		spin_unlock_irqrestore(&stats->lock, flags);
+	}
+
+	return count;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(gbms_wq_reset_fops, NULL, gbms_wq_reset_write);
+
+/* called from the module init */
+int gbms_wq_init(void)
+{
+	int i;
+
+	for (i = 0; i < GBMS_WQ_COUNT; i++)
+		spin_lock_init(&gbms_wq_stats[i].lock);
+
+	/* safety responses are serialized, never wait behind other BMS work */
+	gbms_wq[GBMS_WQ_SAFETY] =
+		alloc_ordered_workqueue(gbms_wq_names[GBMS_WQ_SAFETY],
+					WQ_HIGHPRI | WQ_MEM_RECLAIM);
+	gbms_wq[GBMS_WQ_CONTROL] =
+		alloc_workqueue(gbms_wq_names[GBMS_WQ_CONTROL],
+				WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	gbms_wq[GBMS_WQ_STATS] =
+		alloc_workqueue(gbms_wq_names[GBMS_WQ_STATS], WQ_UNBOUND, 0);
+
+	for (i = 0; i < GBMS_WQ_COUNT; i++)
+		if (!gbms_wq[i])
+			pr_err("%s: cannot allocate, using system queue\n",
+			       gbms_wq_names[i]);
+
+	gbms_wq_de = debugfs_create_dir("gbms_wq", NULL);
+	if (!IS_ERR_OR_NULL(gbms_wq_de)) {
+		debugfs_create_file("latency", 0444, gbms_wq_de, NULL,
+				    &gbms_wq_latency_fops);
+		debugfs_create_file("reset", 0200, gbms_wq_de, NULL,
+				    &gbms_wq_reset_fops);
+	}
+
+	return 0;
+}
+
+void gbms_wq_exit(void)
+{
+	int i;
+
+	debugfs_remove_recursive(gbms_wq_de);
+
+	for (i = 0; i < GBMS_WQ_COUNT; i++) {
+		if (gbms_wq[i])
+			destroy_workqueue(gbms_wq[i]);
+		gbms_wq[i] = NULL;
+	}
+}
@@ -20,6 +20,7 @@
 #include <linux/minmax.h>
 #include <linux/types.h>
 #include <linux/usb/pd.h>
+#include <linux/workqueue.h>
 #include <misc/logbuffer.h>
 #include "gbms_power_supply.h"
 #include "qmath.h"
@@ -208,11 +209,14 @@ struct gbms_ce_tier_stats {
 
 /* time to full */
 
-/* collected in charging event */
+/*
+ * collected in charging event, compact: ~700 bytes instead of ~1600.
+ * NOTE: cc is in mAh (same as gbms_ce_stats) and elap in seconds.
+ */
 struct ttf_soc_stats {
-	int ti[GBMS_SOC_STATS_LEN];		/* charge tier at each soc */
-	int cc[GBMS_SOC_STATS_LEN];		/* coulomb count at each soc */
-	ktime_t elap[GBMS_SOC_STATS_LEN];	/* time spent at soc */
+	u8 ti[GBMS_SOC_STATS_LEN];		/* charge tier at each soc */
+	u16 cc[GBMS_SOC_STATS_LEN];		/* coulomb count at each soc */
+	u32 elap[GBMS_SOC_STATS_LEN];		/* time spent at soc */
 };
 
 /* reference data for soc estimation  */
@@ -326,6 +330,32 @@ enum gbms_stats_tier_idx_t {
 	GBMS_STATS_TEMP_FILTER = 124,
 };
 
+/* adaptive charging plan: segment i runs from seg[i].start to seg[i+1].start */
+#define CHG_HEALTH_PLAN_SEG_MAX	5
+
+struct batt_chg_health_seg {
+	ktime_t start;
+	enum chg_health_state state;
+	int cc_max;
+	int fv_uv;
+};
+
+struct batt_chg_health_plan {
+	bool valid;
+	ktime_t planned_at;
+	ktime_t deadline;	/* rest_deadline used for the plan */
+	ktime_t ttf;		/* estimate at planned_at */
+	ktime_t charging_s;	/* time not in PAUSE since planned_at */
+	ktime_t last_tick;
+	int ssoc;		/* ssoc of the last ttf check */
+	int rest_rate;		/* rates used for the segments */
+	int rest_rate_before_trigger;
+	int nb_seg;
+	struct batt_chg_health_seg seg[CHG_HEALTH_PLAN_SEG_MAX];
+	u32 replan_count;
+	u32 check_count;
+};
+
 /* health state */
 struct batt_chg_health {
 	int rest_soc;		/* entry criteria */
@@ -341,6 +371,8 @@ struct batt_chg_health {
 	int rest_cc_max;
 	int rest_fv_uv;
 	ktime_t active_time;
+
+	struct batt_chg_health_plan plan;
 };
 
 #define CHG_HEALTH_REST_IS_ACTIVE(rest) \
@@ -570,6 +602,32 @@ int gbms_tier_stats_cstr(char *buff, int size,
 
 void gbms_log_cstr_handler(struct logbuffer *log, char *buf, int len);
 
+/*
+ * BMS workqueues: control loops run on dedicated queues instead of system_wq
+ * and each class keeps a histogram of the latency between the time a work
+ * is due and the time it starts running.
+ */
+enum gbms_wq_class {
+	GBMS_WQ_SAFETY = 0,	/* ordered, high priority: overheat, defender */
+	GBMS_WQ_CONTROL,	/* high priority: charging control loops */
+	GBMS_WQ_STATS,		/* unbound: statistics and history */
+	GBMS_WQ_COUNT,
+};
+
+struct gbms_delayed_work {
+	struct delayed_work dwork;
+	work_func_t func;		/* called with &dwork.work */
+	enum gbms_wq_class wq_class;
+	ktime_t due;
+};
+
+int gbms_wq_init(void);
+void gbms_wq_exit(void);
+void gbms_init_delayed_work(struct gbms_delayed_work *gw, work_func_t func,
+			    enum gbms_wq_class wq_class);
+bool gbms_queue_delayed_work(struct gbms_delayed_work *gw, unsigned long delay);
+bool gbms_mod_delayed_work(struct gbms_delayed_work *gw, unsigned long delay);
+
 
 
 
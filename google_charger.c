@@ -119,6 +119,7 @@
  * DT by mapping the levels with google,thermal-stats-lvl-map.
  */
 #define STATS_THERMAL_LEVELS_MAX (10)
+#define CHG_THERM_MDIS_LEVEL_MAX (255)
 
 struct chg_drv;
 
@@ -148,9 +149,13 @@ struct chg_thermal_device {
 	struct thermal_cooling_device *tcd;
 	int *thermal_mitigation;
 	int *thermal_budgets;
+	int *thermal_limits;	/* level -> vote, -1 for no vote */
 	int thermal_levels;
 	int current_level;
 	int therm_fan_alarm_level;
+	/* last THERMAL_DAEMON_VOTER vote, limit_el is NULL when not cast */
+	struct gvotable_election *limit_el;
+	int limit_vote;
 };
 
 struct chg_termination {
@@ -217,6 +222,50 @@ struct bd_data {
 	ktime_t bd_resume_stats_last_update;
 };
 
+/*
+ * Charge session profiler: a ring with the transitions of the states that
+ * limit charging. The states are sampled in chg_work, bd_work and on the
+ * charging policy votes, an event carries the time the change was seen.
+ * The residency of the thermal tiers, TEMP-DEFEND and dock defend is in
+ * thermal_stats and charge_stats. Exported as struct chg_prof_data in
+ * charge_transitions.
+ */
+enum chg_prof_src {
+	CHG_PROF_SRC_ONLINE = 0,	/* power source connected */
+	CHG_PROF_SRC_THERMAL,		/* thermal stats tier */
+	CHG_PROF_SRC_BD,		/* TEMP-DEFEND triggered */
+	CHG_PROF_SRC_DD,		/* dock_defend_state + 1 */
+	CHG_PROF_SRC_POLICY,		/* charging_policy */
+
+	CHG_PROF_SRC_COUNT,
+};
+
+#define CHG_PROF_VERSION	2
+#define CHG_PROF_STATES_MAX	16
+#define CHG_PROF_EVENTS_MAX	64
+
+struct chg_prof_event {
+	u32 time_ms;		/* from the start of the session */
+	u8 src;
+	u8 state;
+	u16 pad;
+} __packed;
+
+struct chg_prof_data {
+	u32 version;
+	u32 session_ms;
+	u32 events_count;	/* total, the ring has the last _EVENTS_MAX */
+	struct chg_prof_event events[CHG_PROF_EVENTS_MAX]; /* oldest first */
+} __packed;
+
+struct chg_profiler {
+	spinlock_t lock;
+	ktime_t start;
+	u8 state[CHG_PROF_SRC_COUNT];
+	struct chg_prof_event events[CHG_PROF_EVENTS_MAX];
+	u32 events_count;
+};
+
 struct chg_drv {
 	struct device *device;
 
@@ -234,7 +283,7 @@ struct chg_drv {
 
 	struct notifier_block psy_nb;
 	struct delayed_work init_work;
-	struct delayed_work chg_work;
+	struct gbms_delayed_work chg_work;
 	struct work_struct chg_psy_work;
 	struct wakeup_source *chg_ws;
 	struct alarm chg_wakeup_alarm;
@@ -266,6 +315,7 @@ struct chg_drv {
 	struct gvotable_election *fan_level_votable;
 	struct gvotable_election *dead_battery_votable;
 	struct gvotable_election *tx_icl_votable;
+	int tx_icl_therm;	/* THERMAL_DAEMON_VOTER enabled, -1 unknown */
 	struct gvotable_election *chg_mdis;
 
 	bool init_done;
@@ -282,7 +332,7 @@ struct chg_drv {
 	int egain_retries;
 
 	/* retail & battery defender */
-	struct delayed_work bd_work;
+	struct gbms_delayed_work bd_work;
 
 	struct mutex bd_lock;
 	struct bd_data bd_state;
@@ -334,6 +384,10 @@ struct chg_drv {
 	ktime_t thermal_stats_last_update;
 	int *thermal_stats_mdis_levels;
 	int thermal_levels_count;
+	struct chg_profiler prof;
+	u8 *thermal_stats_tiers;	/* mdis level -> stats tier */
+	int thermal_stats_tiers_max;
+	int thermal_stats_tier;		/* last vote on thermal_level_votable */
 
 	/* charging policy */
 	struct gvotable_election *charging_policy_votable;
@@ -342,7 +396,7 @@ struct chg_drv {
 
 static void reschedule_chg_work(struct chg_drv *chg_drv)
 {
-	mod_delayed_work(system_wq, &chg_drv->chg_work, 0);
+	gbms_mod_delayed_work(&chg_drv->chg_work, 0);
 	pr_debug("%s: rescheduling\n", __func__);
 }
 
@@ -469,6 +523,85 @@ static void thermal_stats_init(struct chg_drv *chg_drv)
 	mutex_unlock(&chg_drv->stats_lock);
 }
 
+static u8 chg_prof_state(int value)
+{
+	return clamp(value, 0, CHG_PROF_STATES_MAX - 1);
+}
+
+/* new session, keep the current state */
+static void chg_prof_reset(struct chg_profiler *prof)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&prof->lock, flags);
+	prof->start = ktime_get_boottime();
+	prof->events_count = 0;
+	spin_unlock_irqrestore(&prof->lock, flags);
+}
+
+/* online < 0 keeps the current online state */
+static void chg_prof_update(struct chg_drv *chg_drv, int online)
+{
+	struct chg_profiler *prof = &chg_drv->prof;
+	u8 state[CHG_PROF_SRC_COUNT];
+	unsigned long flags;
+	ktime_t now;
+	int i;
+
+	state[CHG_PROF_SRC_THERMAL] = chg_prof_state(chg_drv->thermal_stats_tier);
+	state[CHG_PROF_SRC_POLICY] = chg_prof_state(chg_drv->charging_policy);
+
+	mutex_lock(&chg_drv->bd_lock);
+	state[CHG_PROF_SRC_BD] = chg_drv->bd_state.triggered != 0;
+	state[CHG_PROF_SRC_DD] = chg_prof_state(chg_drv->bd_state.dd_state + 1);
+	mutex_unlock(&chg_drv->bd_lock);
+
+	spin_lock_irqsave(&prof->lock, flags);
+	state[CHG_PROF_SRC_ONLINE] = online < 0 ?
+				     prof->state[CHG_PROF_SRC_ONLINE] : !!online;
+	if (memcmp(state, prof->state, sizeof(state)) == 0)
+		goto unlock_done;
+
+	now = ktime_get_boottime();
+	for (i = 0; i < CHG_PROF_SRC_COUNT; i++) {
+		struct chg_prof_event *ev;
+
+		if (state[i] == prof->state[i])
+			continue;
+
+		ev = &prof->events[prof->events_count % CHG_PROF_EVENTS_MAX];
+		ev->time_ms = ktime_ms_delta(now, prof->start);
+		ev->src = i;
+		ev->state = state[i];
+		prof->events_count += 1;
+
+		prof->state[i] = state[i];
+	}
+
+unlock_done:
+	spin_unlock_irqrestore(&prof->lock, flags);
+}
+
+static void chg_prof_snapshot(struct chg_profiler *prof,
+			      struct chg_prof_data *data)
+{
+	unsigned long flags;
+	u32 i, first, count;
+	ktime_t now;
+
+	spin_lock_irqsave(&prof->lock, flags);
+	now = ktime_get_boottime();
+	data->version = CHG_PROF_VERSION;
+	data->session_ms = ktime_ms_delta(now, prof->start);
+	data->events_count = prof->events_count;
+
+	count = min_t(u32, prof->events_count, CHG_PROF_EVENTS_MAX);
+	first = prof->events_count - count;
+	for (i = 0; i < count; i++)
+		data->events[i] = prof->events[(first + i) % CHG_PROF_EVENTS_MAX];
+	spin_unlock_irqrestore(&prof->lock, flags);
+}
+
 static void chg_stats_update(struct chg_drv *chg_drv, struct gbms_ce_tier_stats *tier,
 			     ktime_t *last_update)
 {
@@ -1159,13 +1292,21 @@ static void chg_work_adapter_details(union gbms_ce_adapter_details *ad,
 		(void)info_usb_state(ad, chg_drv->usb_psy, chg_drv->tcpm_psy);
 }
 
+/* use the packed state when the wireless charger provides one */
 static bool chg_work_check_wlc_state(struct power_supply *wlc_psy)
 {
+	union gbms_charger_state wlc_state;
 	int wlc_online, wlc_present;
+	int ret;
 
 	if (!wlc_psy)
 		return false;
 
+	wlc_state.v = GPSY_GET_INT64_PROP(wlc_psy, GBMS_PROP_CHARGE_CHARGER_STATE,
+					  &ret);
+	if (ret == 0)
+		return wlc_state.f.chg_status != POWER_SUPPLY_STATUS_DISCHARGING;
+
 	wlc_online = GPSY_GET_PROP(wlc_psy, POWER_SUPPLY_PROP_ONLINE);
 	wlc_present = GPSY_GET_PROP(wlc_psy, POWER_SUPPLY_PROP_PRESENT);
 
@@ -1536,6 +1677,33 @@ static int bd_fan_calculate_level(struct bd_data *bd_state)
 	return bd_fan_level;
 }
 
+/* cast only on changes, the election has a single voter */
+static void thermal_stats_vote_tier(struct chg_drv *chg_drv, int tier)
+{
+	int ret;
+
+	if (chg_drv->thermal_stats_tier == tier)
+		return;
+
+	ret = gvotable_cast_int_vote(chg_drv->thermal_level_votable,
+				     "THERMAL_UPDATE", tier, tier != 0);
+	if (ret == 0)
+		chg_drv->thermal_stats_tier = tier;
+}
+
+/* Translate the thermal tier to a stats tier */
+static int thermal_stats_mdis_tier(const struct chg_drv *chg_drv, int thermal_level)
+{
+	/* Traditinal thermal setting */
+	if (!chg_drv->thermal_levels_count)
+		return thermal_level;
+
+	if (thermal_level > chg_drv->thermal_stats_tiers_max)
+		return chg_drv->thermal_levels_count;
+
+	return chg_drv->thermal_stats_tiers[thermal_level];
+}
+
 static void thermal_stats_update(struct chg_drv *chg_drv) {
 	int i;
 	int thermal_level = -1;
@@ -1553,7 +1721,7 @@ static void thermal_stats_update(struct chg_drv *chg_drv) {
 
 	/* The value from the votable may be uninitialized (negative). */
 	if (thermal_level <= 0) {
-		gvotable_cast_int_vote(chg_drv->thermal_level_votable, "THERMAL_UPDATE", 0, false);
+		thermal_stats_vote_tier(chg_drv, 0);
 		/* Do not log any stats in level 0, so store updated time. */
 		mutex_lock(&chg_drv->stats_lock);
 		chg_drv->thermal_stats_last_update = get_boot_sec();
@@ -1561,23 +1729,14 @@ static void thermal_stats_update(struct chg_drv *chg_drv) {
 		return;
 	}
 
-	if (chg_drv->thermal_levels_count) {
-		/* Translate the thermal tier to a stats tier */
-		for (i = 0; i < chg_drv->thermal_levels_count; i++)
-			if (thermal_level <= chg_drv->thermal_stats_mdis_levels[i])
-				break;
-	} else {
-		/* Traditinal thermal setting */
-		i = thermal_level;
-	}
+	i = thermal_stats_mdis_tier(chg_drv, thermal_level);
 
 	/* Note; we do not report level 0 (eg. mdis_level == 0) */
 	if (i >= STATS_THERMAL_LEVELS_MAX)
 		return;
 
 	/* better to use i - 1 ? */
-	gvotable_cast_int_vote(chg_drv->thermal_level_votable,
-			       "THERMAL_UPDATE", i, true);
+	thermal_stats_vote_tier(chg_drv, i);
 
 	chg_stats_update(chg_drv,
 			 &chg_drv->thermal_stats[i],
@@ -1816,7 +1975,7 @@ static int chg_work_read_soc(struct power_supply *bat_psy, int *soc)
 static void bd_work(struct work_struct *work)
 {
 	struct chg_drv *chg_drv =
-		container_of(work, struct chg_drv, bd_work.work);
+		container_of(work, struct chg_drv, bd_work.dwork.work);
 	struct bd_data *bd_state = &chg_drv->bd_state;
 	const ktime_t now = get_boot_sec();
 	const long long delta_time = now - bd_state->disconnect_time;
@@ -1890,13 +2049,14 @@ bd_rerun:
 		bd_batt_set_overheat(chg_drv, false);
 		chg_update_charging_state(chg_drv, false, false);
 	} else {
-		schedule_delayed_work(&chg_drv->bd_work,
-				      msecs_to_jiffies(interval_ms));
+		gbms_queue_delayed_work(&chg_drv->bd_work,
+					msecs_to_jiffies(interval_ms));
 	}
 
 bd_done:
 	mutex_unlock(&chg_drv->bd_lock);
 
+	chg_prof_update(chg_drv, -1);
 	__pm_relax(chg_drv->bd_ws);
 }
 
@@ -1908,7 +2068,7 @@ static void chg_stop_bd_work(struct chg_drv *chg_drv)
 		chg_drv->bd_state.disconnect_time = 0;
 
 		/* might have never been scheduled */
-		cancel_delayed_work(&chg_drv->bd_work);
+		cancel_delayed_work(&chg_drv->bd_work.dwork);
 	}
 	mutex_unlock(&chg_drv->bd_lock);
 }
@@ -1936,7 +2096,7 @@ static int chg_start_bd_work(struct chg_drv *chg_drv)
 	}
 
 	/* bd_work will keep track of time */
-	mod_delayed_work(system_wq, &chg_drv->bd_work, 0);
+	gbms_mod_delayed_work(&chg_drv->bd_work, 0);
 	mutex_unlock(&chg_drv->bd_lock);
 
 	return 0;
@@ -2325,7 +2485,7 @@ static void chg_update_csi(struct chg_drv *chg_drv)
 static void chg_work(struct work_struct *work)
 {
 	struct chg_drv *chg_drv =
-		container_of(work, struct chg_drv, chg_work.work);
+		container_of(work, struct chg_drv, chg_work.dwork.work);
 	struct power_supply *bat_psy = chg_drv->bat_psy;
 	struct power_supply *wlc_psy = chg_drv->wlc_psy;
 	struct power_supply *ext_psy = chg_drv->ext_psy;
@@ -2410,6 +2570,8 @@ static void chg_work(struct work_struct *work)
 		const int upperbd = chg_drv->charge_stop_level;
 		const int lowerbd = chg_drv->charge_start_level;
 
+		chg_prof_update(chg_drv, false);
+
 		/*
 		 * Update DD stats last time if DD is active.
 		 * NOTE: *** Ensure this is done before disconnect indication to google_battery
@@ -2457,8 +2619,8 @@ static void chg_work(struct work_struct *work)
 
 			rc = chg_reset_state(chg_drv);
 			if (rc == -EAGAIN)
-				schedule_delayed_work(&chg_drv->chg_work,
-						      msecs_to_jiffies(100));
+				gbms_queue_delayed_work(&chg_drv->chg_work,
+							msecs_to_jiffies(100));
 			else
 				chg_drv->stop_charging = 1;
 		}
@@ -2474,6 +2636,7 @@ static void chg_work(struct work_struct *work)
 	} else {
 		/* Run thermal stats when connected to power (preset || online) */
 		thermal_stats_update(chg_drv);
+		chg_prof_update(chg_drv, true);
 
 		if (chg_drv->stop_charging != 0 && present) {
 			const bool restore_fcc =
@@ -2600,13 +2763,13 @@ update_charger:
 		unsigned long jif = msecs_to_jiffies(CHG_WORK_BD_TRIGGERED_MS);
 
 		pr_debug("MSC_BD reschedule in %d ms\n", CHG_WORK_BD_TRIGGERED_MS);
-		schedule_delayed_work(&chg_drv->chg_work, jif);
+		gbms_queue_delayed_work(&chg_drv->chg_work, jif);
 	}
 
 	goto exit_chg_work;
 
 rerun_error:
-	success = schedule_delayed_work(&chg_drv->chg_work,
+	success = gbms_queue_delayed_work(&chg_drv->chg_work,
 				msecs_to_jiffies(CHG_WORK_ERROR_RETRY_MS));
 
 	/*
@@ -2649,6 +2812,7 @@ exit_chg_work:
 	}
 
 	chg_update_csi(chg_drv);
+	chg_prof_update(chg_drv, -1);
 
 exit_skip:
 	pr_debug("chg_work done\n");
@@ -3878,6 +4042,57 @@ static ssize_t charge_stats_store(struct device *dev,
 
 static DEVICE_ATTR_RW(charge_stats);
 
+static ssize_t charge_transitions_read(struct file *filp, struct kobject *kobj,
+				     struct bin_attribute *bin_attr,
+				     char *buf, loff_t pos, size_t size)
+{
+	struct chg_drv *chg_drv =
+		dev_get_drvdata(container_of(kobj, struct device, kobj));
+	struct chg_prof_data *data;
+
+	if (pos >= sizeof(*data))
+		return 0;
+
+	data = kzalloc(sizeof(*data), GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	chg_prof_snapshot(&chg_drv->prof, data);
+
+	size = min_t(size_t, size, sizeof(*data) - pos);
+	memcpy(buf, (char *)data + pos, size);
+	kfree(data);
+
+	return size;
+}
+
+/* write 0 to start a new session */
+static ssize_t charge_transitions_write(struct file *filp, struct kobject *kobj,
+				      struct bin_attribute *bin_attr,
+				      char *buf, loff_t pos, size_t size)
+{
+	struct chg_drv *chg_drv =
+		dev_get_drvdata(container_of(kobj, struct device, kobj));
+
+	if (size < 1)
+		return -ENODATA;
+
+	if (buf[0] == 0 || buf[0] == '0')
+		chg_prof_reset(&chg_drv->prof);
+
+	return size;
+}
+
+static struct bin_attribute bin_attr_charge_transitions = {
+	.attr = {
+		.name = "charge_transitions",
+		.mode = 0644,
+	},
+	.read = charge_transitions_read,
+	.write = charge_transitions_write,
+	.size = sizeof(struct chg_prof_data),
+};
+
 static int chg_init_fs(struct chg_drv *chg_drv)
 {
 	int ret;
@@ -4011,6 +4226,12 @@ static int chg_init_fs(struct chg_drv *chg_drv)
 		return ret;
 	}
 
+	ret = device_create_bin_file(chg_drv->device, &bin_attr_charge_transitions);
+	if (ret != 0) {
+		pr_err("Failed to create charge_transitions, ret=%d\n", ret);
+		return ret;
+	}
+
 	/* dock_defend */
 	if (chg_drv->ext_psy_name) {
 		ret = device_create_file(chg_drv->device, &dev_attr_dd_state);
@@ -4338,6 +4559,7 @@ static int charging_policy_cb(struct gvotable_election *el,
 		return 0;
 
 	chg_update_charging_policy(chg_drv, charging_policy);
+	chg_prof_update(chg_drv, -1);
 
 	if (chg_drv->bat_psy)
 		power_supply_changed(chg_drv->bat_psy);
@@ -4579,6 +4801,74 @@ static int fan_vote_level(struct chg_drv *chg_drv, const char *reason, int hint)
 	return ret;
 }
 
+/* level -> vote, -1 on level 0 (no vote) and 0 on the last level */
+static int chg_tdev_limit(const struct chg_thermal_device *tdev)
+{
+	if (!tdev->thermal_limits)
+		return -1;
+
+	return tdev->thermal_limits[tdev->current_level];
+}
+
+/*
+ * Cast the THERMAL_DAEMON_VOTER vote for a cooling device only when it changes.
+ * Cooling devices might share the same election (see DC_FCC fallback), a vote
+ * invalidates the cached vote of the others.
+ */
+static int chg_tdev_vote(struct chg_drv *chg_drv,
+			 struct chg_thermal_device *tdev,
+			 struct gvotable_election *el, int vote)
+{
+	int i, ret;
+
+	if (tdev->limit_el == el && tdev->limit_vote == vote)
+		return 0;
+
+	ret = gvotable_cast_int_vote(el, THERMAL_DAEMON_VOTER, vote, vote != -1);
+	if (ret < 0) {
+		tdev->limit_el = NULL;
+		return ret;
+	}
+
+	for (i = 0; i < CHG_TERMAL_DEVICES_COUNT; i++)
+		if (chg_drv->thermal_devices[i].limit_el == el)
+			chg_drv->thermal_devices[i].limit_el = NULL;
+
+	tdev->limit_el = el;
+	tdev->limit_vote = vote;
+	return 0;
+}
+
+/* TX_ICL is 0 when the DC_ICL level disables wireless charging */
+static int chg_therm_vote_tx_icl(struct chg_drv *chg_drv, bool enabled)
+{
+	int ret;
+
+	if (!chg_drv->tx_icl_votable || chg_drv->tx_icl_therm == enabled)
+		return 0;
+
+	ret = gvotable_cast_int_vote(chg_drv->tx_icl_votable,
+				     THERMAL_DAEMON_VOTER, 0, enabled);
+	chg_drv->tx_icl_therm = ret < 0 ? -1 : enabled;
+	return ret;
+}
+
+/* called on init and on callbacks for elections created after us */
+static void chg_therm_find_votables(struct chg_drv *chg_drv)
+{
+	if (!chg_drv->dc_icl_votable)
+		chg_drv->dc_icl_votable =
+			gvotable_election_get_handle("DC_ICL");
+	if (!chg_drv->tx_icl_votable)
+		chg_drv->tx_icl_votable =
+			gvotable_election_get_handle("TX_ICL");
+	if (!chg_drv->dc_fcc_votable)
+		chg_drv->dc_fcc_votable =
+			gvotable_election_get_handle("DC_FCC");
+	if (!chg_drv->chg_mdis)
+		chg_drv->chg_mdis = gvotable_election_get_handle(VOTABLE_MDIS);
+}
+
 static int chg_get_max_charge_cntl_limit(struct thermal_cooling_device *tcd,
 					 unsigned long *lvl)
 {
@@ -4646,16 +4936,11 @@ static int chg_therm_update_fcc(struct chg_drv *chg_drv)
 
 	/* restore the thermal vote FCC level (if enabled) */
 	override_fcc = chg_therm_override_fcc(chg_drv);
-	if (!override_fcc && tdev->current_level > 0) {
-		if (tdev->current_level < tdev->thermal_levels)
-			fcc = tdev->thermal_mitigation[tdev->current_level];
-		else
-			fcc = 0;
-	}
+	if (!override_fcc)
+		fcc = chg_tdev_limit(tdev);
 
 	/* !override_fcc will restore the fcc thermal limit when set */
-	ret = gvotable_cast_int_vote(chg_drv->msc_fcc_votable,
-				     THERMAL_DAEMON_VOTER, fcc, fcc != -1);
+	ret = chg_tdev_vote(chg_drv, tdev, chg_drv->msc_fcc_votable, fcc);
 	if (ret < 0)
 		pr_err("%s: MSC_THERM_FCC vote fcc=%d failed ret=%d\n",
 		       __func__, fcc, ret);
@@ -4805,19 +5090,11 @@ static int chg_set_dc_in_charge_cntl_limit(struct thermal_cooling_device *tcd,
 	if (lvl < 0 || tdev->thermal_levels <= 0 || lvl > tdev->thermal_levels)
 		return -EINVAL;
 
-	if (!chg_drv->dc_icl_votable)
-		chg_drv->dc_icl_votable =
-			gvotable_election_get_handle("DC_ICL");
-	if (!chg_drv->tx_icl_votable)
-		chg_drv->tx_icl_votable =
-			gvotable_election_get_handle("TX_ICL");
+	chg_therm_find_votables(chg_drv);
 
 	/* dc_icl == -1 on level 0 */
 	tdev->current_level = lvl;
-	if (tdev->current_level == tdev->thermal_levels)
-		dc_icl = 0;
-	else if (tdev->current_level != 0)
-		dc_icl = tdev->thermal_mitigation[tdev->current_level];
+	dc_icl = chg_tdev_limit(tdev);
 
 	/* b/119501863 set the wireless charger offline if in FIXED mode */
 	if (dc_icl == 0) {
@@ -4825,9 +5102,7 @@ static int chg_set_dc_in_charge_cntl_limit(struct thermal_cooling_device *tcd,
 		if (wlc_state < 0)
 			pr_err("MSC_THERM_DC cannot offline ret=%d\n", wlc_state);
 
-		if (chg_drv->tx_icl_votable)
-			gvotable_cast_int_vote(chg_drv->tx_icl_votable,
-					       THERMAL_DAEMON_VOTER, 0, true);
+		chg_therm_vote_tx_icl(chg_drv, true);
 
 		pr_info("MSC_THERM_DC lvl=%ld, dc disable wlc_state=%d\n",
 			lvl, wlc_state);
@@ -4835,9 +5110,7 @@ static int chg_set_dc_in_charge_cntl_limit(struct thermal_cooling_device *tcd,
 
 	/* set the IF-PMIC before re-enable wlc */
 	if (chg_drv->dc_icl_votable) {
-		ret = gvotable_cast_int_vote(chg_drv->dc_icl_votable,
-					     THERMAL_DAEMON_VOTER,
-					     dc_icl, dc_icl >= 0);
+		ret = chg_tdev_vote(chg_drv, tdev, chg_drv->dc_icl_votable, dc_icl);
 		if (ret < 0 || changed)
 			pr_info("MSC_THERM_DC lvl=%ld dc_icl=%d (%d)\n",
 				lvl, dc_icl, ret);
@@ -4848,9 +5121,7 @@ static int chg_set_dc_in_charge_cntl_limit(struct thermal_cooling_device *tcd,
 		wlc_state = chg_therm_set_wlc_online(chg_drv);
 		if (wlc_state < 0)
 			pr_err("MSC_THERM_DC cannot online ret=%d\n", wlc_state);
-		if (chg_drv->tx_icl_votable)
-			gvotable_cast_int_vote(chg_drv->tx_icl_votable,
-					       THERMAL_DAEMON_VOTER, 0, false);
+		chg_therm_vote_tx_icl(chg_drv, false);
 	}
 
 	/* online/offline or vote might change the selection */
@@ -4891,32 +5162,24 @@ static int chg_set_wlc_fcc_charge_cntl_limit(struct thermal_cooling_device *tcd,
 	if (lvl < 0 || tdev->thermal_levels <= 0 || lvl > tdev->thermal_levels)
 		return -EINVAL;
 
-	if (!chg_drv->dc_fcc_votable) {
-		chg_drv->dc_fcc_votable =
-			gvotable_election_get_handle("DC_FCC");
+	chg_therm_find_votables(chg_drv);
 
-		/* HACK: fallback to FCC */
-		if (!chg_drv->dc_fcc_votable) {
-			chg_drv->dc_fcc_votable = chg_drv->msc_fcc_votable;
-			pr_warn("%s: DC_FCC uses msc_fcc votable\n", __func__);
-		}
+	/* HACK: fallback to FCC */
+	if (!chg_drv->dc_fcc_votable) {
+		chg_drv->dc_fcc_votable = chg_drv->msc_fcc_votable;
+		pr_warn("%s: DC_FCC uses msc_fcc votable\n", __func__);
 	}
 
 	/* dc_fcc == -1 on level 0 */
 	tdev->current_level = lvl;
-	if (tdev->current_level == tdev->thermal_levels)
-		dc_fcc = 0;
-	else if (tdev->current_level != 0)
-		dc_fcc = tdev->thermal_mitigation[tdev->current_level];
+	dc_fcc = chg_tdev_limit(tdev);
 
 	/*
 	 * Vote before setting the source offline to re-run the selection logic
 	 * before taking the WLC to FIXED_ONLINE.
 	 */
 	if (chg_drv->dc_fcc_votable) {
-		ret = gvotable_cast_int_vote(chg_drv->dc_fcc_votable,
-					     THERMAL_DAEMON_VOTER,
-					     dc_fcc, dc_fcc >= 0);
+		ret = chg_tdev_vote(chg_drv, tdev, chg_drv->dc_fcc_votable, dc_fcc);
 		if (ret < 0 || changed)
 			pr_info("MSC_THERM_DC_FCC lvl=%ld dc_fcc=%d (%d)\n",
 				lvl, dc_fcc, ret);
@@ -5059,7 +5322,7 @@ DEBUG_ATTRIBUTE_WO(dc_tm);
 #endif // CONFIG_DEBUG_FS
 
 static int chg_init_mdis_stats_map(struct chg_drv *chg_drv, const char *name) {
-	int rc, byte_len;
+	int rc, byte_len, count, i, level, max_level = 0;
 
 	if (!of_find_property(chg_drv->device->of_node, name, &byte_len)) {
 		dev_err(chg_drv->device, "No thermal stats map for %s\n", name);
@@ -5072,12 +5335,12 @@ static int chg_init_mdis_stats_map(struct chg_drv *chg_drv, const char *name) {
 	if (!chg_drv->thermal_stats_mdis_levels)
 		return -ENOMEM;
 
-	chg_drv->thermal_levels_count = byte_len / sizeof(u32);
+	count = byte_len / sizeof(u32);
 
 	rc = of_property_read_u32_array(chg_drv->device->of_node,
 					name,
 					chg_drv->thermal_stats_mdis_levels,
-					chg_drv->thermal_levels_count);
+					count);
 	if (rc < 0) {
 		dev_err(chg_drv->device,
 			"Couldn't read limits for %s rc = %d\n", name, rc);
@@ -5086,6 +5349,60 @@ static int chg_init_mdis_stats_map(struct chg_drv *chg_drv, const char *name) {
 		return -ENODATA;
 	}
 
+	/* thermal_stats_update() run on every chg_work: map mdis levels once */
+	for (i = 0; i < count; i++)
+		max_level = max(max_level, chg_drv->thermal_stats_mdis_levels[i]);
+	if (max_level > CHG_THERM_MDIS_LEVEL_MAX) {
+		dev_err(chg_drv->device, "%s level %d too large\n", name,
+			max_level);
+		devm_kfree(chg_drv->device, chg_drv->thermal_stats_mdis_levels);
+		chg_drv->thermal_stats_mdis_levels = NULL;
+		return -EINVAL;
+	}
+
+	chg_drv->thermal_stats_tiers = devm_kzalloc(chg_drv->device,
+						    max_level + 1,
+						    GFP_KERNEL);
+	if (!chg_drv->thermal_stats_tiers) {
+		devm_kfree(chg_drv->device, chg_drv->thermal_stats_mdis_levels);
+		chg_drv->thermal_stats_mdis_levels = NULL;
+		return -ENOMEM;
+	}
+
+	/* first stats tier with thermal_level <= mdis_level */
+	for (level = 0; level <= max_level; level++) {
+		for (i = 0; i < count; i++)
+			if (level <= chg_drv->thermal_stats_mdis_levels[i])
+				break;
+		chg_drv->thermal_stats_tiers[level] = i;
+	}
+
+	chg_drv->thermal_stats_tiers_max = max_level;
+	chg_drv->thermal_levels_count = count;
+	return 0;
+}
+
+/* compile the level -> vote table used in the cooling device callbacks */
+static int chg_tdev_limits_init(struct chg_thermal_device *tdev,
+				struct chg_drv *chg_drv)
+{
+	int i;
+
+	tdev->thermal_limits = devm_kcalloc(chg_drv->device,
+					    tdev->thermal_levels + 1,
+					    sizeof(*tdev->thermal_limits),
+					    GFP_KERNEL);
+	if (!tdev->thermal_limits) {
+		devm_kfree(chg_drv->device, tdev->thermal_mitigation);
+		tdev->thermal_mitigation = NULL;
+		return -ENOMEM;
+	}
+
+	tdev->thermal_limits[0] = -1;
+	for (i = 1; i < tdev->thermal_levels; i++)
+		tdev->thermal_limits[i] = tdev->thermal_mitigation[i];
+	tdev->thermal_limits[tdev->thermal_levels] = 0;
+
 	return 0;
 }
 
@@ -5126,7 +5443,7 @@ static int chg_tdev_init(struct chg_thermal_device *tdev, const char *name,
 
 	tdev->chg_drv = chg_drv;
 
-	return 0;
+	return chg_tdev_limits_init(tdev, chg_drv);
 }
 
 static int chg_tdev_budgets_init(struct chg_thermal_device *tdev, const char *name,
@@ -5322,6 +5639,8 @@ static int chg_thermal_device_init(struct chg_drv *chg_drv)
 					"google,therm-wlc-overrides-fcc");
 
 	chg_init_mdis_stats_map(chg_drv, "google,thermal-stats-lvl-map");
+	chg_drv->tx_icl_therm = -1;
+	chg_therm_find_votables(chg_drv);
 
 	pr_info("wlc-overrides-fcc=%d thermal-mitigation=%d "
 		"wlc-thermal-mitigation=%d wlc-fcc-thermal-mitigation=%d\n",
@@ -5503,7 +5822,7 @@ static void google_charger_init_work(struct work_struct *work)
 		!!chg_drv->usb_psy, !!chg_drv->ext_psy, !!chg_drv->tcpm_psy);
 
 	/* catch state changes that happened before registering the notifier */
-	schedule_delayed_work(&chg_drv->chg_work,
+	gbms_queue_delayed_work(&chg_drv->chg_work,
 		msecs_to_jiffies(CHG_DELAY_INIT_DETECT_MS));
 	return;
 
@@ -5659,11 +5978,11 @@ static int google_charger_probe(struct platform_device *pdev)
 		pr_err("Failed to register wakeup source\n");
 		return -ENODEV;
 	}
-	INIT_DELAYED_WORK(&chg_drv->bd_work, bd_work);
+	gbms_init_delayed_work(&chg_drv->bd_work, bd_work, GBMS_WQ_SAFETY);
 	bd_init(&chg_drv->bd_state, chg_drv->device);
 
 	INIT_DELAYED_WORK(&chg_drv->init_work, google_charger_init_work);
-	INIT_DELAYED_WORK(&chg_drv->chg_work, chg_work);
+	gbms_init_delayed_work(&chg_drv->chg_work, chg_work, GBMS_WQ_CONTROL);
 	INIT_WORK(&chg_drv->chg_psy_work, chg_psy_work);
 	platform_set_drvdata(pdev, chg_drv);
 
@@ -5677,6 +5996,10 @@ static int google_charger_probe(struct platform_device *pdev)
 		return -ENODEV;
 	}
 
+	/* charging_policy_cb() and charge_transitions use the profiler */
+	spin_lock_init(&chg_drv->prof.lock);
+	chg_prof_reset(&chg_drv->prof);
+
 	/* create the votables before talking to google_battery */
 	ret = chg_create_votables(chg_drv);
 	if (ret < 0)
@@ -73,6 +73,28 @@
 #define GCPM_TAPER_STEP_CURRENT		0
 /* enough time for the charger to settle to a new limit */
 #define GCPM_TAPER_STEP_INTERVAL_S	120
+/* predictive taper: interval and step adapt to the battery response */
+#define GCPM_TAPER_PRED_MIN_INTERVAL_MS	15000
+#define GCPM_TAPER_PRED_STEP_MULT_MAX	4
+#define GCPM_TAPER_PRED_TOLERANCE_UA	100000
+#define GCPM_TAPER_HIST_MAX		32
+
+/* handoff from DC to the main charger, closed on IBAT over the min */
+#define GCPM_HANDOFF_TIMEOUT_MS		30000
+#define GCPM_HANDOFF_IBAT_MIN_UA	100000
+#define GCPM_HANDOFF_POLL_MS		100
+
+struct gcpm_taper_sample {
+	long long ts;		/* boot seconds */
+	int taper_step;
+	int vbatt;		/* uV, before the step */
+	int ibatt;		/* uA from the battery, before the step */
+	int fv_uv;
+	int cc_from;
+	int cc_max;
+	int interval_ms;	/* until the next step */
+	bool settled;		/* followed the previous step */
+};
 
 /* TODO: move to configuration */
 #define DC_TA_VMAX_MV		9800000
@@ -172,6 +194,26 @@ struct gcpm_drv  {
 	int chg_psy_active;
 	int chg_psy_count;
 
+	/* last packed state read from each charger, under chg_psy_lock */
+	union gbms_charger_state chg_state[GCPM_MAX_CHARGERS];
+	ktime_t chg_state_ts[GCPM_MAX_CHARGERS];
+
+	/* IBAT for taper and handoff, the DC chargers report IIN */
+	struct power_supply *batt_psy;
+	/* uncached IBAT for the handoff, optional */
+	const char *fg_psy_name;
+	struct power_supply *fg_psy;
+
+	/* DC->main handoff, gap is DC offline to the battery charging */
+	struct delayed_work handoff_work;
+	ktime_t handoff_start;		/* 0 when not in handoff */
+	bool handoff_ibat_low;		/* IBAT dropped since handoff_start */
+	u32 handoff_count;
+	u32 handoff_timeout;
+	u32 handoff_gap_last_ms;
+	u32 handoff_gap_max_ms;
+	u64 handoff_gap_total_ms;
+
 	/* wakelock */
 	struct wakeup_source *gcpm_ws;
 
@@ -231,6 +273,16 @@ struct gcpm_drv  {
 	u32 taper_step_cc_step;		/* countdown steps before dc_done */
 	int taper_step;			/* actual countdown */
 
+	/* predictive taper, see gcpm_taper_predict() */
+	bool taper_predictive;
+	int taper_cc;			/* last cc_max, 0 at start */
+	int taper_cc_step;		/* current step size */
+	int taper_interval_ms;		/* current interval */
+	struct gcpm_taper_sample taper_hist[GCPM_TAPER_HIST_MAX];
+	int taper_hist_next;
+	int taper_hist_count;
+	bool taper_hist_valid;		/* last sample is from this taper */
+
 	/* policy: soc% based limits for DC charging */
 	u32 dc_limit_soc_high;		/* DC will not start over high */
 	/* policy: power demand limit for DC charging */
@@ -392,18 +444,152 @@ static int gcpm_chg_ping(struct gcpm_drv *gcpm, int index, bool online)
 	return 0;
 }
 
-/* use the charger one when avalaible or fallback to the generated one */
-static uint64_t gcpm_get_charger_state(const struct gcpm_drv *gcpm,
+/*
+ * Battery current (IBAT), positive when charging. The DC chargers report
+ * the input current in CURRENT_NOW.
+ */
+static int gcpm_get_ibatt(struct gcpm_drv *gcpm, int *ibatt)
+{
+	union power_supply_propval val;
+	int ret;
+
+	if (!gcpm->batt_psy)
+		gcpm->batt_psy = power_supply_get_by_name("battery");
+	if (!gcpm->batt_psy)
+		return -EINVAL;
+
+	ret = power_supply_get_property(gcpm->batt_psy,
+					POWER_SUPPLY_PROP_CURRENT_NOW, &val);
+	if (ret == 0)
+		*ibatt = val.intval;
+
+	return ret;
+}
+
+/*
+ * Fresh IBAT from the gauge for the handoff, positive when charging: the
+ * battery psy returns the value cached by the gauge. Use the battery psy
+ * when google,fg-power-supply is not defined.
+ */
+static int gcpm_get_ibatt_uncached(struct gcpm_drv *gcpm, int *ibatt)
+{
+	int ret, fg_ibatt;
+
+	if (!gcpm->fg_psy_name)
+		return gcpm_get_ibatt(gcpm, ibatt);
+
+	if (!gcpm->fg_psy)
+		gcpm->fg_psy = power_supply_get_by_name(gcpm->fg_psy_name);
+	if (!gcpm->fg_psy)
+		return -EINVAL;
+
+	/* the gauge reports a negative current when charging */
+	fg_ibatt = GPSY_GET_INT_PROP_UNCACHED(gcpm->fg_psy,
+					      POWER_SUPPLY_PROP_CURRENT_NOW,
+					      &ret);
+	if (ret == 0)
+		*ibatt = -fg_ibatt;
+
+	return ret;
+}
+
+/* call holding chg_psy_lock */
+static void gcpm_handoff_start(struct gcpm_drv *gcpm)
+{
+	if (gcpm->handoff_start)
+		return;
+
+	gcpm->handoff_start = ktime_get();
+	gcpm->handoff_ibat_low = false;
+	mod_delayed_work(system_wq, &gcpm->handoff_work,
+			 msecs_to_jiffies(GCPM_HANDOFF_POLL_MS));
+}
+
+/*
+ * Close the DC->main handoff gap when the battery charges again: IBAT
+ * must drop under the min after DC stops and then go over it with the
+ * main charger. The CHARGING status of the main charger is set before
+ * current flows and IBAT might still be the DC current when DC stops.
+ * Returns true while the handoff is open, call holding chg_psy_lock.
+ */
+static bool gcpm_handoff_check(struct gcpm_drv *gcpm)
+{
+	int ret, ibatt;
+	s64 gap_ms;
+
+	if (!gcpm->handoff_start)
+		return false;
+
+	gap_ms = ktime_ms_delta(ktime_get(), gcpm->handoff_start);
+	if (gap_ms > GCPM_HANDOFF_TIMEOUT_MS) {
+		gcpm->handoff_timeout += 1;
+		gcpm->handoff_start = 0;
+		return false;
+	}
+
+	ret = gcpm_get_ibatt_uncached(gcpm, &ibatt);
+	if (ret < 0)
+		return true;
+
+	if (ibatt < GCPM_HANDOFF_IBAT_MIN_UA) {
+		gcpm->handoff_ibat_low = true;
+		return true;
+	}
+
+	if (!gcpm->handoff_ibat_low)
+		return true;
+
+	gcpm->handoff_start = 0;
+	gcpm->handoff_count += 1;
+	gcpm->handoff_gap_last_ms = gap_ms;
+	gcpm->handoff_gap_total_ms += gap_ms;
+	if (gap_ms > gcpm->handoff_gap_max_ms)
+		gcpm->handoff_gap_max_ms = gap_ms;
+
+	logbuffer_log(gcpm->log, "handoff gap=%lldms ibatt=%d", gap_ms, ibatt);
+	return false;
+}
+
+/* poll IBAT until the handoff closes or times out */
+static void gcpm_handoff_work(struct work_struct *work)
+{
+	struct gcpm_drv *gcpm = container_of(work, struct gcpm_drv,
+					     handoff_work.work);
+
+	mutex_lock(&gcpm->chg_psy_lock);
+	if (gcpm_handoff_check(gcpm))
+		mod_delayed_work(system_wq, &gcpm->handoff_work,
+				 msecs_to_jiffies(GCPM_HANDOFF_POLL_MS));
+	mutex_unlock(&gcpm->chg_psy_lock);
+}
+
+#define GCPM_CHG_STATE_MAX_AGE_MS	10000
+
+/*
+ * Use the charger one when avalaible or fallback to the generated one.
+ * The state is cached per charger: a charger that cannot be read (i.e.
+ * resuming) reports its last state for GCPM_CHG_STATE_MAX_AGE_MS.
+ * Call holding chg_psy_lock.
+ */
+static uint64_t gcpm_get_charger_state(struct gcpm_drv *gcpm, int index,
 				       struct power_supply *chg_psy)
 {
 	union gbms_charger_state chg_state;
+	const ktime_t now = ktime_get();
 	int rc;
 
 	rc = gbms_read_charger_state(&chg_state, chg_psy);
-	if (rc < 0)
-		return 0;
+	if (rc == 0) {
+		gcpm->chg_state[index] = chg_state;
+		gcpm->chg_state_ts[index] = now;
+		return chg_state.v;
+	}
+
+	if (gcpm->chg_state_ts[index] &&
+	    ktime_ms_delta(now, gcpm->chg_state_ts[index]) < GCPM_CHG_STATE_MAX_AGE_MS)
+		return gcpm->chg_state[index].v;
 
-	return chg_state.v;
+	return 0;
 }
 
 /*
@@ -431,6 +617,8 @@ static int gcpm_chg_offline(struct gcpm_drv *gcpm, int index)
 		ret = GPSY_SET_PROP(chg_psy, POWER_SUPPLY_PROP_ONLINE, 0);
 	if (ret == 0 && gcpm->chg_psy_active == index)
 		gcpm->chg_psy_active = -1;
+	if (ret == 0)
+		gcpm->chg_state_ts[index] = 0;
 
 	pr_info("%s: %s active=%d->%d offline_ok=%d\n", __func__,
 		 pps_name(chg_psy), active_index, gcpm->chg_psy_active, ret == 0);
@@ -1228,6 +1416,12 @@ static bool gcpm_taper_ctl(struct gcpm_drv *gcpm, int count)
 		changed = true;
 	}
 
+	/* predictive taper restarts from the current limit */
+	if (changed) {
+		gcpm->taper_cc = 0;
+		gcpm->taper_hist_valid = false;
+	}
+
 	return changed;
 }
 
@@ -1311,6 +1505,150 @@ static bool gcpm_taper_step(const struct gcpm_drv *gcpm,
 	return false;
 }
 
+static struct gcpm_taper_sample *gcpm_taper_last(struct gcpm_drv *gcpm)
+{
+	int index;
+
+	if (!gcpm->taper_hist_valid || gcpm->taper_hist_count == 0)
+		return NULL;
+
+	index = gcpm->taper_hist_next - 1;
+	if (index < 0)
+		index = GCPM_TAPER_HIST_MAX - 1;
+
+	return &gcpm->taper_hist[index];
+}
+
+static void gcpm_taper_record(struct gcpm_drv *gcpm,
+			      const struct gcpm_taper_sample *sample)
+{
+	gcpm->taper_hist[gcpm->taper_hist_next] = *sample;
+	gcpm->taper_hist_next = (gcpm->taper_hist_next + 1) % GCPM_TAPER_HIST_MAX;
+	if (gcpm->taper_hist_count < GCPM_TAPER_HIST_MAX)
+		gcpm->taper_hist_count += 1;
+	gcpm->taper_hist_valid = true;
+}
+
+/*
+ * Predictive version of gcpm_taper_step(): same gating (voltage, current)
+ * and same limits (fv_uv - taper_step_fv_margin, cc_max >= dc_iin / 2) but
+ * the step size and the interval to the next step follow the response of
+ * the battery to the previous step, measured on the battery current (IBAT)
+ * since the DC charger reports the input current. The grace steps are kept:
+ * no step until the countdown reaches taper_step_count. When the current
+ * followed the last step the next step is larger (up to
+ * GCPM_TAPER_PRED_STEP_MULT_MAX times taper_step_cc_step) and comes sooner
+ * (down to a quarter of taper_step_interval). A slow response backs off to
+ * the fixed schedule.
+ * DC is done when the current settles at the floor or on countdown.
+ * NOTE: this writes directly to the charging current.
+ */
+static bool gcpm_taper_predict(struct gcpm_drv *gcpm, int dc_iin,
+			       int taper_step, int *interval_ms)
+{
+	const int delta = gcpm->taper_step_count - taper_step;
+	const int max_ms = gcpm->taper_step_interval * 1000;
+	const int min_ms = min(max_ms, max(max_ms / 4,
+					   GCPM_TAPER_PRED_MIN_INTERVAL_MS));
+	const int step_max = gcpm->taper_step_cc_step *
+			     GCPM_TAPER_PRED_STEP_MULT_MAX;
+	const int cc_floor = dc_iin / 2;
+	struct gcpm_taper_sample sample = { 0 };
+	struct gcpm_taper_sample *last;
+	struct power_supply *dc_psy;
+	int ret, cc_step, iin;
+
+	*interval_ms = max_ms;
+	if (taper_step <= 0)
+		return true;
+
+	dc_psy = gcpm_chg_get_active_cp(gcpm);
+	if (!dc_psy)
+		return true;
+
+	/* same gating as gcpm_taper_step() (on the DC charger) */
+	sample.vbatt = GPSY_GET_PROP(dc_psy, POWER_SUPPLY_PROP_VOLTAGE_NOW);
+	ret = GPSY_GET_INT_PROP(dc_psy, POWER_SUPPLY_PROP_CURRENT_NOW, &iin);
+	if (ret == 0)
+		ret = gcpm_get_ibatt(gcpm, &sample.ibatt);
+	if (sample.vbatt < 0 || ret < 0) {
+		pr_err("%s: cannot read vbatt=%d (%d), use fixed step\n",
+		       __func__, sample.vbatt, ret);
+		gcpm->taper_hist_valid = false;
+		return gcpm_taper_step(gcpm, dc_iin, taper_step);
+	}
+
+	if (gcpm->taper_step_voltage && sample.vbatt < gcpm->taper_step_voltage)
+		return false;
+	if (gcpm->taper_step_current && iin > gcpm->taper_step_current)
+		return false;
+
+	/* delta < 0 during the grace period, do not step */
+	if (delta < 0) {
+		pr_debug("CHG_CHK: grace taper_step=%d fv_uv=%d, dc_iin=%d\n",
+			 taper_step, gcpm->fv_uv, dc_iin);
+		return false;
+	}
+
+	if (gcpm->taper_cc <= 0 || gcpm->taper_cc > dc_iin) {
+		gcpm->taper_cc = dc_iin;
+		gcpm->taper_cc_step = gcpm->taper_step_cc_step;
+		gcpm->taper_interval_ms = max_ms;
+	}
+
+	cc_step = gcpm->taper_cc_step;
+	*interval_ms = gcpm->taper_interval_ms;
+
+	last = gcpm_taper_last(gcpm);
+	if (last) {
+		const int cmd = last->cc_from - last->cc_max;
+		const int got = last->ibatt - sample.ibatt;
+
+		/* at the limit or 3/4 of the commanded drop */
+		sample.settled = sample.ibatt <= last->cc_max +
+				 GCPM_TAPER_PRED_TOLERANCE_UA ||
+				 (cmd > 0 && got * 4 >= cmd * 3);
+		if (sample.settled) {
+			*interval_ms = max(min_ms, last->interval_ms / 2);
+			cc_step = min(step_max, cc_step * 2);
+		} else {
+			*interval_ms = min(max_ms, last->interval_ms * 2);
+			cc_step = max((int)gcpm->taper_step_cc_step, cc_step / 2);
+		}
+	}
+
+	/* the cell follows the floor: handoff to the main charger now */
+	if (gcpm->taper_cc <= cc_floor && sample.settled)
+		return true;
+
+	sample.ts = get_boot_sec();
+	sample.taper_step = taper_step;
+	sample.fv_uv = gcpm->fv_uv - gcpm->taper_step_fv_margin;
+	sample.cc_from = gcpm->taper_cc;
+	sample.cc_max = max(cc_floor, gcpm->taper_cc - cc_step);
+	sample.interval_ms = *interval_ms;
+
+	ret = gcpm_chg_preset(dc_psy, sample.fv_uv, sample.cc_max);
+	if (ret < 0) {
+		pr_err("CHG_CHK: taper_step=%d failed, revert (%d)\n",
+		       taper_step, ret);
+		return true;
+	}
+
+	gcpm_taper_record(gcpm, &sample);
+	gcpm->taper_cc = sample.cc_max;
+	gcpm->taper_cc_step = cc_step;
+	gcpm->taper_interval_ms = *interval_ms;
+
+	logbuffer_log(gcpm->log, "taper_step=%d vbatt=%d ibatt=%d settled=%d fv_uv=%d, dc_iin=%d->%d next=%d",
+		      taper_step, sample.vbatt, sample.ibatt, sample.settled,
+		      sample.fv_uv, sample.cc_from, sample.cc_max,
+		      *interval_ms);
+
+	/* not done */
+	return false;
+}
+
 /* needs mutex_lock(&gcpm->chg_psy_lock); */
 static int gcpm_chg_select_logic(struct gcpm_drv *gcpm)
 {
@@ -1336,15 +1674,23 @@ static int gcpm_chg_select_logic(struct gcpm_drv *gcpm)
 	/*
 	 * taper control reduces cc_max every gcpm->taper_step_interval seconds
 	 * by a fixed amount for gcpm->taper_step_count seconds. fv_uv might
-	 * also be lowered by a fixed amount.
+	 * also be lowered by a fixed amount. The predictive taper adapts the
+	 * step and the interval to the battery response.
 	 */
 	if (dc_ena && gcpm->taper_step > 0) {
-		const int interval = msecs_to_jiffies(gcpm->taper_step_interval * 1000);
+		int interval_ms = gcpm->taper_step_interval * 1000;
 		int dc_iin = gcpm->cc_max;
 
-		dc_done = gcpm_taper_step(gcpm, dc_iin, gcpm->taper_step - 1);
+		if (gcpm->taper_predictive && gcpm->taper_step_cc_step)
+			dc_done = gcpm_taper_predict(gcpm, dc_iin,
+						     gcpm->taper_step - 1,
+						     &interval_ms);
+		else
+			dc_done = gcpm_taper_step(gcpm, dc_iin,
+						  gcpm->taper_step - 1);
 		if (!dc_done) {
-			mod_delayed_work(system_wq, &gcpm->select_work, interval);
+			mod_delayed_work(system_wq, &gcpm->select_work,
+					 msecs_to_jiffies(interval_ms));
 			gcpm->taper_step -= 1;
 		}
 
@@ -1522,6 +1868,9 @@ static int gcpm_pps_wlc_dc_restart_default(struct gcpm_drv *gcpm)
 		return -EAGAIN;
 	}
 
+	if (gcpm_is_dc(gcpm, active_index))
+		gcpm_handoff_start(gcpm);
+
 	/*
 	 * Calling pps_offline is not really needed becasuse the adapter will
 	 * revert to fixed once ping stops (pps state is re-initialized on
@@ -2136,7 +2485,8 @@ static int gcpm_psy_get_property(struct power_supply *psy,
 	switch (psp) {
 	/* handle locally for now */
 	case GBMS_PROP_CHARGE_CHARGER_STATE:
-		chg_state.v = gcpm_get_charger_state(gcpm, chg_psy);
+		chg_state.v = gcpm_get_charger_state(gcpm, gcpm->chg_psy_active,
+						     chg_psy);
 		gbms_propval_int64val(pval) = chg_state.v;
 		break;
 
@@ -3643,6 +3993,85 @@ static int gcpm_debug_taper_ctl_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(gcpm_debug_taper_ctl_fops, gcpm_debug_taper_ctl_get,
 			gcpm_debug_taper_ctl_set, "%llu\n");
 
+static ssize_t gcpm_debug_taper_hist_read(struct file *filp,
+					  char __user *user_buf,
+					  size_t count, loff_t *ppos)
+{
+	struct gcpm_drv *gcpm = filp->private_data;
+	int i, index, len = 0;
+	char *tmp;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	mutex_lock(&gcpm->chg_psy_lock);
+	index = gcpm->taper_hist_next - gcpm->taper_hist_count;
+	if (index < 0)
+		index += GCPM_TAPER_HIST_MAX;
+
+	for (i = 0; i < gcpm->taper_hist_count; i++) {
+		const struct gcpm_taper_sample *sample = &gcpm->taper_hist[index];
+
+		len += scnprintf(&tmp[len], PAGE_SIZE - len,
+				 "%lld %d %d %d %d %d->%d %d %d\n",
+				 sample->ts, sample->taper_step,
+				 sample->vbatt, sample->ibatt, sample->fv_uv,
+				 sample->cc_from, sample->cc_max,
+				 sample->interval_ms, sample->settled);
+		index = (index + 1) % GCPM_TAPER_HIST_MAX;
+	}
+	mutex_unlock(&gcpm->chg_psy_lock);
+
+	len = simple_read_from_buffer(user_buf, count, ppos, tmp, len);
+	kfree(tmp);
+	return len;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(gcpm_debug_taper_hist_fops, gcpm_debug_taper_hist_read, NULL);
+
+static ssize_t gcpm_debug_handoff_stats_read(struct file *filp,
+					     char __user *user_buf,
+					     size_t count, loff_t *ppos)
+{
+	struct gcpm_drv *gcpm = filp->private_data;
+	char buff[128];
+	int len;
+
+	mutex_lock(&gcpm->chg_psy_lock);
+	len = scnprintf(buff, sizeof(buff),
+			"count=%u timeout=%u last_ms=%u max_ms=%u avg_ms=%llu\n",
+			gcpm->handoff_count, gcpm->handoff_timeout,
+			gcpm->handoff_gap_last_ms, gcpm->handoff_gap_max_ms,
+			gcpm->handoff_count ?
+			div_u64(gcpm->handoff_gap_total_ms, gcpm->handoff_count) : 0);
+	mutex_unlock(&gcpm->chg_psy_lock);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buff, len);
+}
+
+/* write anything to reset the stats */
+static ssize_t gcpm_debug_handoff_stats_write(struct file *filp,
+					      const char __user *user_buf,
+					      size_t count, loff_t *ppos)
+{
+	struct gcpm_drv *gcpm = filp->private_data;
+
+	mutex_lock(&gcpm->chg_psy_lock);
+	gcpm->handoff_count = 0;
+	gcpm->handoff_timeout = 0;
+	gcpm->handoff_gap_last_ms = 0;
+	gcpm->handoff_gap_max_ms = 0;
+	gcpm->handoff_gap_total_ms = 0;
+	mutex_unlock(&gcpm->chg_psy_lock);
+
+	return count;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(gcpm_debug_handoff_stats_fops,
+			gcpm_debug_handoff_stats_read,
+			gcpm_debug_handoff_stats_write);
+
 static int gcpm_debug_taper_step_fv_margin_get(void *data, u64 *val)
 {
 	struct gcpm_drv *gcpm = data;
@@ -3844,6 +4273,9 @@ static struct dentry *gcpm_init_fs(struct gcpm_drv *gcpm)
 	debugfs_create_file("taper_step_voltage", 0644, de, gcpm, &gcpm_debug_taper_step_voltage_fops);
 	debugfs_create_file("taper_step_current", 0644, de, gcpm, &gcpm_debug_taper_step_current_fops);
 	debugfs_create_file("taper_step_interval", 0644, de, gcpm, &gcpm_debug_taper_step_interval_fops);
+	debugfs_create_bool("taper_predictive", 0644, de, &gcpm->taper_predictive);
+	debugfs_create_file("taper_hist", 0444, de, gcpm, &gcpm_debug_taper_hist_fops);
+	debugfs_create_file("handoff_stats", 0644, de, gcpm, &gcpm_debug_handoff_stats_fops);
 
 	return de;
 }
@@ -4018,6 +4450,7 @@ static int google_cpm_probe(struct platform_device *pdev)
 	INIT_DELAYED_WORK(&gcpm->pps_work, gcpm_pps_wlc_dc_work);
 	INIT_DELAYED_WORK(&gcpm->select_work, gcpm_chg_select_work);
 	INIT_DELAYED_WORK(&gcpm->init_work, gcpm_init_work);
+	INIT_DELAYED_WORK(&gcpm->handoff_work, gcpm_handoff_work);
 	mutex_init(&gcpm->chg_psy_lock);
 
 	gcpm->gcpm_ws = wakeup_source_register(NULL, "google-cpm");
@@ -4058,6 +4491,16 @@ static int google_cpm_probe(struct platform_device *pdev)
 			return -ENOMEM;
 	}
 
+	ret = of_property_read_string(pdev->dev.of_node,
+				      "google,fg-power-supply",
+				      &tmp_name);
+	if (ret == 0) {
+		gcpm->fg_psy_name = devm_kstrdup(&pdev->dev, tmp_name,
+						 GFP_KERNEL);
+		if (!gcpm->fg_psy_name)
+			return -ENOMEM;
+	}
+
 	/* GCPM might need a gpio to enable/disable DC/PPS */
 	gcpm->dcen_gpio = of_get_named_gpio(pdev->dev.of_node, "google,dc-en", 0);
 	if (gcpm->dcen_gpio >= 0) {
@@ -4150,6 +4593,8 @@ static int google_cpm_probe(struct platform_device *pdev)
 				   &gcpm->taper_step_voltage);
 	if (ret < 0)
 		gcpm->taper_step_voltage = GCPM_TAPER_STEP_VOLTAGE;
+	gcpm->taper_predictive = of_property_read_bool(pdev->dev.of_node,
+						"google,taper_step-predictive");
 	ret = of_property_read_u32(pdev->dev.of_node, "google,taper_step-current",
 				   &gcpm->taper_step_current);
 	if (ret < 0)
@@ -4286,6 +4731,7 @@ static int google_cpm_remove(struct platform_device *pdev)
 	if (!gcpm)
 		return 0;
 
+	cancel_delayed_work_sync(&gcpm->handoff_work);
 	gvotable_destroy_election(gcpm->dc_fcc_votable);
 
 	for (i = 0; i < gcpm->chg_psy_count; i++) {
@@ -4303,6 +4749,10 @@ static int google_cpm_remove(struct platform_device *pdev)
 
 	if (gcpm->wlc_dc_psy)
 		power_supply_put(gcpm->wlc_dc_psy);
+	if (gcpm->batt_psy)
+		power_supply_put(gcpm->batt_psy);
+	if (gcpm->fg_psy)
+		power_supply_put(gcpm->fg_psy);
 	if (gcpm->log)
 		logbuffer_unregister(gcpm->log);
 
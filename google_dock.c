@@ -47,6 +47,31 @@
 #define EXT_DETECT_DELAY_MS		(1000)
 #define EXT_DETECT_RETRIES		(3)
 
+/* coalesced events, handled in notifier_work */
+#define DOCK_EVENT_DC			BIT(0)
+
+enum dock_state {
+	DOCK_STATE_UNKNOWN = 0,
+	DOCK_STATE_DETACHED,
+	DOCK_STATE_ATTACHED,		/* DC_IN present, ICL ramp pending */
+	DOCK_STATE_ONLINE,		/* ICL ramp done */
+	DOCK_STATE_COUNT,
+};
+
+static const char *dock_state_names[DOCK_STATE_COUNT] = {
+	[DOCK_STATE_UNKNOWN] = "unknown",
+	[DOCK_STATE_DETACHED] = "detached",
+	[DOCK_STATE_ATTACHED] = "attached",
+	[DOCK_STATE_ONLINE] = "online",
+};
+
+/* latency from the first (coalesced) event to the transition */
+struct dock_state_stats {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+};
+
 struct dock_drv {
 	struct device *device;
 	struct power_supply *psy;
@@ -62,8 +87,22 @@ struct dock_drv {
 	struct gvotable_election *dc_icl_votable;
 	struct gvotable_election *chg_mode_votable;
 
+	/* events are posted from the notifier (atomic), protected by event_lock */
+	spinlock_t event_lock;
+	unsigned long events;
+	ktime_t event_ts;
+	u32 events_posted;
+
+	/* state machine, protected by dock_lock */
+	enum dock_state state;
+	int dc_in;
+	int pogo_vout;
+	ktime_t ramp_ts;
+	u32 events_handled;
+	u32 events_suppressed;
+	struct dock_state_stats stats[DOCK_STATE_COUNT];
+
 	bool init_complete;
-	bool check_dc;
 	bool icl_ramp;
 	u32 icl_ramp_ua;
 	u32 icl_ramp_delay_ms;
@@ -89,18 +128,29 @@ static bool google_dock_find_mode_votable(struct dock_drv *dock)
 	return true;
 }
 
+/* call holding dock->dock_lock, no-op when the vote doesn't change */
 static int google_dock_set_pogo_vout(struct dock_drv *dock,
 				     int enabled)
 {
+	int ret;
+
+	enabled = enabled != 0;
+	if (dock->pogo_vout == enabled)
+		return 0;
+
 	if (!google_dock_find_mode_votable(dock))
 		return -EINVAL;
 
 	dev_dbg(dock->device, "pogo_vout_enabled=%d\n", enabled);
 
-	return gvotable_cast_long_vote(dock->chg_mode_votable,
-				       DOCK_VOUT_VOTER,
-				       GBMS_POGO_VOUT,
-				       enabled != 0);
+	ret = gvotable_cast_long_vote(dock->chg_mode_votable,
+				      DOCK_VOUT_VOTER,
+				      GBMS_POGO_VOUT,
+				      enabled);
+	if (ret == 0)
+		dock->pogo_vout = enabled;
+
+	return ret;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -126,7 +176,9 @@ static int debug_pogo_vout_write(void *data, u64 val)
 	if (val < 0 || val > 1)
 		return -EINVAL;
 
+	mutex_lock(&dock->dock_lock);
 	ret = google_dock_set_pogo_vout(dock, val);
+	mutex_unlock(&dock->dock_lock);
 	if (ret)
 		dev_err(dock->device, "Failed to set pogo vout: %d\n", ret);
 
@@ -136,6 +188,43 @@ static int debug_pogo_vout_write(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(debug_pogo_vout_fops, NULL,
 			debug_pogo_vout_write, "%llu\n");
 
+static ssize_t debug_dock_state_read(struct file *filp, char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct dock_drv *dock = (struct dock_drv *)filp->private_data;
+	char *tmp;
+	int i, len;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	mutex_lock(&dock->dock_lock);
+	len = scnprintf(tmp, PAGE_SIZE,
+			"state=%s dc_in=%d online=%d pogo_vout=%d\n"
+			"events posted=%u handled=%u suppressed=%u\n",
+			dock_state_names[dock->state], dock->dc_in,
+			dock->online, dock->pogo_vout, dock->events_posted,
+			dock->events_handled, dock->events_suppressed);
+
+	for (i = DOCK_STATE_DETACHED; i < DOCK_STATE_COUNT; i++) {
+		const struct dock_state_stats *st = &dock->stats[i];
+
+		len += scnprintf(&tmp[len], PAGE_SIZE - len,
+				 "%s: cnt=%u max_us=%u avg_us=%llu\n",
+				 dock_state_names[i], st->count, st->max_us,
+				 st->count ? div_u64(st->total_us, st->count) : 0);
+	}
+	mutex_unlock(&dock->dock_lock);
+
+	len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+	kfree(tmp);
+
+	return len;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_dock_state_fops, debug_dock_state_read, NULL);
+
 static int dock_init_fs(struct dock_drv *dock)
 {
 	int ret;
@@ -159,6 +248,9 @@ static int dock_init_debugfs(struct dock_drv *dock)
 	/* pogo_vout */
 	debugfs_create_file("pogo_vout", 0600, de, dock,
 			    &debug_pogo_vout_fops);
+	/* state machine and transition latencies */
+	debugfs_create_file("state", 0400, de, dock,
+			    &debug_dock_state_fops);
 
 	return 0;
 }
@@ -225,6 +317,24 @@ static void google_dock_vote_defaults(struct dock_drv *dock)
 	gvotable_cast_int_vote(dock->dc_icl_votable, DOCK_AICL_VOTER, 0, false);
 }
 
+/* call holding dock->dock_lock */
+static void google_dock_set_state(struct dock_drv *dock, enum dock_state state,
+				  ktime_t event_ts)
+{
+	struct dock_state_stats *st = &dock->stats[state];
+	const u32 lat_us = ktime_us_delta(ktime_get(), event_ts);
+
+	dev_info(dock->device, "state %s->%s lat=%uus\n",
+		 dock_state_names[dock->state], dock_state_names[state], lat_us);
+
+	st->count++;
+	st->total_us += lat_us;
+	if (lat_us > st->max_us)
+		st->max_us = lat_us;
+
+	dock->state = state;
+}
+
 static enum alarmtimer_restart google_dock_icl_ramp_alarm_cb(struct alarm
 							     *alarm,
 							     ktime_t now)
@@ -232,6 +342,8 @@ static enum alarmtimer_restart google_dock_icl_ramp_alarm_cb(struct alarm
 	struct dock_drv *dock = container_of(alarm, struct dock_drv,
 					     icl_ramp_alarm);
 
+	dock->ramp_ts = ktime_get();
+
 	/* Alarm is in atomic context, schedule work to complete the task */
 	schedule_delayed_work(&dock->icl_ramp_work, msecs_to_jiffies(100));
 
@@ -244,6 +356,15 @@ static void google_dock_icl_ramp_work(struct work_struct *work)
 					     icl_ramp_work.work);
 	int online, voltage;
 
+	mutex_lock(&dock->dock_lock);
+
+	/* detached while the ramp was in flight */
+	if (dock->state != DOCK_STATE_ATTACHED) {
+		dev_dbg(dock->device, "ICL ramp work, state=%s\n",
+			dock_state_names[dock->state]);
+		goto exit_done;
+	}
+
 	online = GPSY_GET_PROP(dock->dc_psy, POWER_SUPPLY_PROP_ONLINE);
 	voltage = GPSY_GET_PROP(dock->dc_psy, POWER_SUPPLY_PROP_VOLTAGE_NOW);
 	if (voltage > DOCK_13_5W_VOUT_UV)
@@ -262,6 +383,12 @@ static void google_dock_icl_ramp_work(struct work_struct *work)
 	dev_info(dock->device, "%s: online: %d->%d\n",
 		 __func__, dock->online, online);
 	dock->online = online;
+
+	if (dock->icl_ramp)
+		google_dock_set_state(dock, DOCK_STATE_ONLINE, dock->ramp_ts);
+
+exit_done:
+	mutex_unlock(&dock->dock_lock);
 }
 
 static void google_dock_icl_ramp_reset(struct dock_drv *dock)
@@ -282,17 +409,32 @@ static void google_dock_icl_ramp_start(struct dock_drv *dock)
 			     ms_to_ktime(dock->icl_ramp_delay_ms));
 }
 
-static void google_dock_notifier_check_dc(struct dock_drv *dock)
+/*
+ * call holding dock->dock_lock. Votes and ICL ramp are reset only on actual
+ * attach/detach transitions: a burst of notifications from the dc supply
+ * while the dock stays attached doesn't restart the ramp.
+ */
+static void google_dock_notifier_check_dc(struct dock_drv *dock,
+					  ktime_t event_ts)
 {
+	bool attached;
 	int dc_in;
 
-	dock->check_dc = false;
-
 	dc_in = dock_has_dc_in(dock);
 	if (dc_in < 0)
 		return;
 
+	attached = dock->state == DOCK_STATE_ATTACHED ||
+		   dock->state == DOCK_STATE_ONLINE;
+	if (dock->state != DOCK_STATE_UNKNOWN && attached == !!dc_in) {
+		dev_dbg(dock->device, "dc status is %d, state=%s\n", dc_in,
+			dock_state_names[dock->state]);
+		dock->events_suppressed++;
+		return;
+	}
+
 	dev_info(dock->device, "dc status is %d\n", dc_in);
+	dock->dc_in = dc_in;
 
 	if (dc_in) {
 		google_dock_set_icl(dock);
@@ -301,6 +443,7 @@ static void google_dock_notifier_check_dc(struct dock_drv *dock)
 		dock->voltage_max = -1;		/* Dock detection started, but not done */
 		schedule_delayed_work(&dock->detect_work,
 				msecs_to_jiffies(EXT_DETECT_DELAY_MS));
+		google_dock_set_state(dock, DOCK_STATE_ATTACHED, event_ts);
 	} else {
 		google_dock_vote_defaults(dock);
 		google_dock_icl_ramp_reset(dock);
@@ -309,6 +452,7 @@ static void google_dock_notifier_check_dc(struct dock_drv *dock)
 		dev_info(dock->device, "%s: online: %d->0\n",
 			 __func__, dock->online);
 		dock->online = 0;
+		google_dock_set_state(dock, DOCK_STATE_DETACHED, event_ts);
 	}
 
 	power_supply_changed(dock->psy);
@@ -318,11 +462,41 @@ static void google_dock_notifier_work(struct work_struct *work)
 {
 	struct dock_drv *dock = container_of(work, struct dock_drv,
 					     notifier_work.work);
+	unsigned long events, flags;
+	ktime_t event_ts;
+
+	spin_lock_irqsave(&dock->event_lock, flags);
+	events = dock->events;
+	event_ts = dock->event_ts;
+	dock->events = 0;
+	spin_unlock_irqrestore(&dock->event_lock, flags);
 
-	dev_info(dock->device, "notifier_work\n");
+	if (!events)
+		return;
+
+	dev_dbg(dock->device, "notifier_work events=%lx\n", events);
 
-	if (dock->check_dc)
-		google_dock_notifier_check_dc(dock);
+	mutex_lock(&dock->dock_lock);
+	dock->events_handled++;
+	if (events & DOCK_EVENT_DC)
+		google_dock_notifier_check_dc(dock, event_ts);
+	mutex_unlock(&dock->dock_lock);
+}
+
+/* events posted before notifier_work runs are handled together */
+static void google_dock_post_event(struct dock_drv *dock, unsigned long event)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dock->event_lock, flags);
+	if (!dock->events)
+		dock->event_ts = ktime_get();
+	dock->events |= event;
+	dock->events_posted++;
+	spin_unlock_irqrestore(&dock->event_lock, flags);
+
+	schedule_delayed_work(&dock->notifier_work,
+			      msecs_to_jiffies(DOCK_NOTIFIER_DELAY_MS));
 }
 
 static int google_dock_notifier_cb(struct notifier_block *nb,
@@ -335,13 +509,7 @@ static int google_dock_notifier_cb(struct notifier_block *nb,
 		goto out;
 
 	if (dock->dc_psy_name && !strcmp(psy->desc->name, dock->dc_psy_name))
-		dock->check_dc = true;
-
-	if (!dock->check_dc)
-		goto out;
-
-	schedule_delayed_work(&dock->notifier_work,
-			      msecs_to_jiffies(DOCK_NOTIFIER_DELAY_MS));
+		google_dock_post_event(dock, DOCK_EVENT_DC);
 
 out:
 	return NOTIFY_OK;
@@ -390,7 +558,11 @@ static int dock_get_property(struct power_supply *psy,
 
 	switch (psp) {
 	case POWER_SUPPLY_PROP_PRESENT:
-		val->intval = dock_has_dc_in(dock);
+		/* cached in notifier_work, read until the first event */
+		if (dock->state != DOCK_STATE_UNKNOWN)
+			val->intval = dock->dc_in;
+		else
+			val->intval = dock_has_dc_in(dock);
 		if (val->intval < 0)
 			val->intval = 0;
 		break;
@@ -603,6 +775,7 @@ static int google_dock_probe(struct platform_device *pdev)
 
 	google_dock_parse_dt(dock->device, dock);
 	mutex_init(&dock->dock_lock);
+	spin_lock_init(&dock->event_lock);
 	INIT_DELAYED_WORK(&dock->init_work, google_dock_init_work);
 	INIT_DELAYED_WORK(&dock->icl_ramp_work, google_dock_icl_ramp_work);
 	INIT_DELAYED_WORK(&dock->detect_work, google_dock_detect_work);
@@ -611,6 +784,8 @@ static int google_dock_probe(struct platform_device *pdev)
 
 	dock->icl_ramp_delay_ms = DOCK_ICL_RAMP_DELAY_DEFAULT_MS;
 	dock->online = 0;
+	dock->state = DOCK_STATE_UNKNOWN;
+	dock->pogo_vout = -1;
 
 	dock->voltage_max = 0;
 	dock->detect_retries = EXT_DETECT_RETRIES;
@@ -467,6 +467,8 @@ static int gdbatt_get_property(struct power_supply *psy,
 {
 	struct dual_fg_drv *dual_fg_drv = (struct dual_fg_drv *)
 					power_supply_get_drvdata(psy);
+	/* GBMS_PROP_UNCACHED is forwarded to the gauges */
+	const int prop = psp & ~GBMS_PROP_UNCACHED;
 	int err = 0;
 	union power_supply_propval fg_1;
 	union power_supply_propval fg_2;
@@ -497,7 +499,7 @@ static int gdbatt_get_property(struct power_supply *psy,
 			return err;
 		}
 
-	switch (psp) {
+	switch (prop) {
 	case POWER_SUPPLY_PROP_CHARGE_COUNTER:
 	case POWER_SUPPLY_PROP_CHARGE_FULL:
 	case POWER_SUPPLY_PROP_CHARGE_FULL_DESIGN:
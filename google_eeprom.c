@@ -256,9 +256,12 @@ static int gbee_storage_write(gbms_tag_t tag, const void *buff, size_t size,
 	struct nvmem_device *nvmem = ptr;
 	size_t offset = 0, len = 0;
 	int ret, write_size = 0;
+	u8 *prev;
 
 	if (!gbee_storage_is_writable(tag))
 		return -ENOENT;
+	if (size == 0)
+		return -EINVAL;
 
 	ret = GBEE_STORAGE_INFO(tag, &offset, &len, ptr);
 	if (ret < 0)
@@ -266,14 +269,32 @@ static int gbee_storage_write(gbms_tag_t tag, const void *buff, size_t size,
 	if (size > len)
 		return -ENOMEM;
 
+	/* skip the bytes that don't change: writes are slow and add wear */
+	prev = kmalloc(size, GFP_KERNEL);
+	if (prev) {
+		ret = nvmem_device_read(nvmem, offset, size, prev);
+		if (ret != 0 && ret != size) {
+			kfree(prev);
+			prev = NULL;
+		}
+	}
+
+	ret = 0;
 	for (write_size = 0; write_size < size; write_size++) {
+		if (prev && prev[write_size] == ((char *)buff)[write_size])
+			continue;
+
 		ret = nvmem_device_write(nvmem, write_size + offset, 1,
 					 &((char *)buff)[write_size]);
 		if (ret < 0)
-			return ret;
+			break;
 		msleep(BATT_WAIT_INTERNAL_WRITE_MS);
 	}
 
+	kfree(prev);
+	if (ret < 0)
+		return ret;
+
 	ret = size;
 
 	return ret;
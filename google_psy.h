@@ -75,4 +75,41 @@ static inline int gpsy_get_prop(struct power_supply *psy,
 #define GPSY_GET_INT_PROP(psy, psp, err) \
 		gpsy_get_prop(psy, (enum power_supply_property)(psp), #psp, err)
 
+/* fresh value from providers with a property cache */
+static inline int gpsy_get_prop_uncached(struct power_supply *psy,
+					 enum power_supply_property psp,
+					 const char *prop_name,
+					 int *err)
+{
+	const enum power_supply_property psp_uc =
+		(enum power_supply_property)(psp | GBMS_PROP_UNCACHED);
+	union power_supply_propval val;
+	int ret;
+
+	if (!psy) {
+		if (err)
+			*err = -EINVAL;
+		return -EINVAL;
+	}
+
+	/* no cache, no support for the flag */
+	ret = power_supply_get_property(psy, psp_uc, &val);
+	if (ret == -EINVAL)
+		return gpsy_get_prop(psy, psp, prop_name, err);
+
+	if (err)
+		*err = ret;
+	if (ret < 0) {
+		pr_err("failed to get %s from '%s', ret=%d\n",
+		       prop_name, psy->desc->name, ret);
+		return ret;
+	}
+
+	return val.intval;
+}
+
+#define GPSY_GET_INT_PROP_UNCACHED(psy, psp, err) \
+		gpsy_get_prop_uncached(psy, (enum power_supply_property)(psp), \
+				       #psp, err)
+
 #endif	/* __GOOGLE_PSY_H_ */
@@ -116,10 +116,10 @@ int ttf_ref_cc(const struct batt_ttf_stats *stats, int soc)
 
 	delta_cc = (sstat->cc[soc + 1] - sstat->cc[soc]);
 
-	pr_debug("%s %d: delta_cc=%d elap=%ld\n", __func__, soc,
+	pr_debug("%s %d: delta_cc=%d elap=%u\n", __func__, soc,
 		delta_cc, sstat->elap[soc]);
 
-	return (delta_cc * 3600) / sstat->elap[soc];
+	return (delta_cc * 3600) / (int)sstat->elap[soc];
 }
 
 /* assumes that health is active for any soc greater than CHG_HEALTH_REST_SOC */
@@ -385,7 +385,7 @@ int ttf_soc_estimate(ktime_t *res, const struct batt_ttf_stats *stats,
 
 		if (i >= ssoc_in && i < ce_data->last_soc) {
 			/* use real data if within charging event */
-			elap = ce_data->soc_stats.elap[i] * 100;
+			elap = (ktime_t)ce_data->soc_stats.elap[i] * 100;
 		} else {
 			/* future (and soc before ssoc_in) */
 			ratio = ttf_elap(&elap, stats, ce_data, i);
@@ -441,7 +441,7 @@ int ttf_soc_cstr(char *buff, int size, const struct ttf_soc_stats *soc_stats,
 			len += scnprintf(&buff[len], size - len, ":");
 		}
 
-		len += scnprintf(&buff[len], size - len, " %4ld",
+		len += scnprintf(&buff[len], size - len, " %4u",
 				soc_stats->elap[i]);
 		if (i != end && (i + 1) % split == 0)
 			len += scnprintf(&buff[len], size - len, "\n");
@@ -504,7 +504,7 @@ static ktime_t ttf_soc_qual_elap(const struct batt_ttf_stats *stats,
 		return 0;
 	}
 
-	elap_new = (src->elap[i] * 100) / ratio;
+	elap_new = ((ktime_t)src->elap[i] * 100) / ratio;
 	elap_cur = dst->elap[i];
 	if (!elap_cur)
 		elap_cur = stats->soc_ref.elap[i];
@@ -522,7 +522,7 @@ static ktime_t ttf_soc_qual_elap(const struct batt_ttf_stats *stats,
 	else if (elap < min_elap)
 		elap = min_elap;
 
-	pr_debug("%d: dst->elap=%ld, ref_elap=%ld, elap=%ld, src_elap=%ld ratio=%d, min=%d max=%d\n",
+	pr_debug("%d: dst->elap=%u, ref_elap=%u, elap=%lld, src_elap=%u ratio=%d, min=%d max=%d\n",
 		i, dst->elap[i], stats->soc_ref.elap[i], elap, src->elap[i],
 		ratio, min_elap, max_elap);
 
@@ -793,7 +793,7 @@ static int ttf_soc_cstr_elap(char *buff, int size,
 
 	len += scnprintf(&buff[len], size - len, "T%d:", start);
 	for (i = start; i < end; i++)
-		len += scnprintf(&buff[len], size - len, " %4ld",
+		len += scnprintf(&buff[len], size - len, " %4u",
 				 soc_stats->elap[i]);
 
 	return len;
@@ -28,6 +28,9 @@ static int max77759_chgr_reg_write(struct i2c_client *client, u8 reg, u8 value)
 	if (!data || !data->regmap)
 		return -ENODEV;
 
+	if (reg == MAX77759_CHG_CNFG_00)
+		return max77759_chg_cnfg_00_update(data, 0xff, value);
+
 	return regmap_write(data->regmap, reg, value);
 }
 
@@ -62,6 +65,9 @@ static int max77759_chgr_reg_update(struct i2c_client *client,
 	if (!data || !data->regmap)
 		return -ENODEV;
 
+	if (reg == MAX77759_CHG_CNFG_00)
+		return max77759_chg_cnfg_00_update(data, mask, value);
+
 	return regmap_write_bits(data->regmap, reg, mask, value);
 }
 
@@ -77,9 +83,8 @@ static int max77759_chgr_mode_write(struct i2c_client *client,
 	if (!data || !data->regmap)
 		return -ENODEV;
 
-	return regmap_write_bits(data->regmap, MAX77759_CHG_CNFG_00,
-				 MAX77759_CHG_CNFG_00_MODE_MASK,
-				 mode);
+	return max77759_chg_cnfg_00_update(data, MAX77759_CHG_CNFG_00_MODE_MASK,
+					   mode);
 }
 
 
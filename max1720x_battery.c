@@ -100,6 +100,13 @@ struct gbatt_capacity_estimation {
 	int start_vfsoc;
 };
 
+/* RC zone from the soc/temp thresholds, UNKNOWN forces a LearnCfg check */
+enum max1720x_rc_zone {
+	MAX1720X_RC_ZONE_UNKNOWN = 0,
+	MAX1720X_RC_ZONE_RC1,
+	MAX1720X_RC_ZONE_RC2,
+};
+
 struct max1720x_rc_switch {
 	struct delayed_work switch_work;
 	bool available;
@@ -109,6 +116,64 @@ struct max1720x_rc_switch {
 	u16 rc1_tempco;
 	u16 rc2_tempco;
 	u16 rc2_learncfg;
+	enum max1720x_rc_zone zone;	/* zone of the last LearnCfg check */
+};
+
+/* gauge maintenance: what model_work and rc_work did and will do next */
+enum max1720x_maint_event {
+	MAX1720X_MAINT_IDLE = 0,
+	MAX1720X_MAINT_MODEL_LOAD,	/* model load requested */
+	MAX1720X_MAINT_MODEL_RETRY,	/* model load failed, will retry */
+	MAX1720X_MAINT_STATE_SAVE,	/* learned state changed and saved */
+	MAX1720X_MAINT_STATE_SAME,	/* no learned delta, save skipped */
+	MAX1720X_MAINT_RC_POLL,		/* rc zone unchanged */
+	MAX1720X_MAINT_RC_CHECK,	/* rc zone crossed, LearnCfg checked */
+	MAX1720X_MAINT_RC_SWITCH,	/* RC1 <-> RC2 switch */
+	MAX1720X_MAINT_RC_RETRY,	/* rc check failed, quick retry */
+
+	MAX1720X_MAINT_COUNT,
+};
+
+struct max1720x_maint {
+	u32 count[MAX1720X_MAINT_COUNT];
+	enum max1720x_maint_event model_next;
+	enum max1720x_maint_event rc_next;
+	unsigned long rc_next_jiffies;
+};
+
+/*
+ * Results of max1720x_get_property() for the properties that are polled the
+ * most. Each entry is valid for ttl_ms (0 means until invalidated) and is
+ * dropped by the fuel gauge interrupt, model loads, fixups and on resume.
+ */
+enum max1720x_prop_cache_idx {
+	MAX1720X_PCACHE_CAPACITY = 0,
+	MAX1720X_PCACHE_CURRENT_NOW,
+	MAX1720X_PCACHE_CURRENT_AVG,
+	MAX1720X_PCACHE_VOLTAGE_NOW,
+	MAX1720X_PCACHE_VOLTAGE_AVG,
+	MAX1720X_PCACHE_TEMP,
+	MAX1720X_PCACHE_TTE,
+	MAX1720X_PCACHE_TTF,
+	MAX1720X_PCACHE_CHARGE_FULL,
+	MAX1720X_PCACHE_CHARGE_FULL_DESIGN,
+
+	MAX1720X_PCACHE_COUNT,
+};
+
+struct max1720x_prop_cache_entry {
+	bool valid;
+	int val;
+	unsigned long expires;
+	u32 hits;
+	u32 misses;
+};
+
+struct max1720x_prop_cache {
+	spinlock_t lock;
+	bool bypass;
+	u32 invalidated;
+	struct max1720x_prop_cache_entry entry[MAX1720X_PCACHE_COUNT];
 };
 
 #define DEFAULT_BATTERY_ID		0
@@ -207,6 +272,8 @@ struct max1720x_chip {
 
 	u16 RSense;
 	u16 RConfig;
+	/* conversions specialized for RSense and cap_lsb */
+	struct max17x0x_conv conv;
 
 	int batt_id;
 	int batt_id_defer_cnt;
@@ -263,6 +330,8 @@ struct max1720x_chip {
 	int bhi_acim;
 
 	struct max1720x_rc_switch rc_switch;
+	struct max1720x_maint maint;
+	struct max1720x_prop_cache prop_cache;
 
 	/* battery current criteria for report status charge */
 	u32 status_charge_threshold_ma;
@@ -275,7 +344,7 @@ struct max1720x_chip {
 
 
 static irqreturn_t max1720x_fg_irq_thread_fn(int irq, void *obj);
-static int max1720x_set_next_update(struct max1720x_chip *chip);
+static int max1720x_set_next_update(struct max1720x_chip *chip, int reg_cycle);
 static int max1720x_monitor_log_data(struct max1720x_chip *chip, bool force_log);
 
 static bool max17x0x_reglog_init(struct max1720x_chip *chip)
@@ -299,10 +368,10 @@ static bool max17x0x_reglog_init(struct max1720x_chip *chip)
 static const struct max17x0x_reg * max17x0x_find_by_index(struct max17x0x_regtags *tags,
 							  int index)
 {
-	if (index < 0 || !tags || index >= tags->max)
+	if (index < 0 || !tags || !tags->map || index >= MAX17X0X_TAG_COUNT)
 		return NULL;
 
-	return &tags->map[index];
+	return tags->tag[index];
 }
 
 static const struct max17x0x_reg * max17x0x_find_by_tag(struct max17x0x_regmap *map,
@@ -311,21 +380,24 @@ static const struct max17x0x_reg * max17x0x_find_by_tag(struct max17x0x_regmap *
 	return max17x0x_find_by_index(&map->regtags, tag);
 }
 
+/* tags are resolved in max17x0x_regtags_init(), this is an array lookup */
 static inline int max17x0x_reg_read(struct max17x0x_regmap *map,
 				    enum max17x0x_reg_tags tag,
 				    u16 *val)
 {
-	const struct max17x0x_reg *reg;
 	unsigned int tmp;
-	int rtn;
+	int reg, rtn;
 
-	reg = max17x0x_find_by_tag(map, tag);
-	if (!reg)
+	if (!map->regtags.map || tag >= MAX17X0X_TAG_COUNT)
+		return -EINVAL;
+
+	reg = map->regtags.reg16[tag];
+	if (reg < 0)
 		return -EINVAL;
 
-	rtn = regmap_read(map->regmap, reg->reg, &tmp);
+	rtn = regmap_read(map->regmap, reg, &tmp);
 	if (rtn)
-		pr_err("Failed to read %x\n", reg->reg);
+		pr_err("Failed to read %x\n", reg);
 	else
 		*val = tmp;
 
@@ -334,6 +406,101 @@ static inline int max17x0x_reg_read(struct max17x0x_regmap *map,
 
 /* ------------------------------------------------------------------------- */
 
+#define MAX1720X_PCACHE_MODEL_MS	60000
+
+static const struct {
+	enum power_supply_property psp;
+	unsigned int ttl_ms;
+	const char *name;
+} max1720x_prop_cache_desc[MAX1720X_PCACHE_COUNT] = {
+	[MAX1720X_PCACHE_CAPACITY] =
+		{ POWER_SUPPLY_PROP_CAPACITY, 5000, "capacity" },
+	[MAX1720X_PCACHE_CURRENT_NOW] =
+		{ POWER_SUPPLY_PROP_CURRENT_NOW, 1000, "current_now" },
+	[MAX1720X_PCACHE_CURRENT_AVG] =
+		{ POWER_SUPPLY_PROP_CURRENT_AVG, 1000, "current_avg" },
+	[MAX1720X_PCACHE_VOLTAGE_NOW] =
+		{ POWER_SUPPLY_PROP_VOLTAGE_NOW, 1000, "voltage_now" },
+	[MAX1720X_PCACHE_VOLTAGE_AVG] =
+		{ POWER_SUPPLY_PROP_VOLTAGE_AVG, 1000, "voltage_avg" },
+	[MAX1720X_PCACHE_TEMP] =
+		{ POWER_SUPPLY_PROP_TEMP, 1000, "temp" },
+	[MAX1720X_PCACHE_TTE] =
+		{ POWER_SUPPLY_PROP_TIME_TO_EMPTY_AVG, 5000, "time_to_empty_avg" },
+	[MAX1720X_PCACHE_TTF] =
+		{ POWER_SUPPLY_PROP_TIME_TO_FULL_AVG, 5000, "time_to_full_avg" },
+	[MAX1720X_PCACHE_CHARGE_FULL] =
+		{ POWER_SUPPLY_PROP_CHARGE_FULL, MAX1720X_PCACHE_MODEL_MS,
+		  "charge_full" },
+	[MAX1720X_PCACHE_CHARGE_FULL_DESIGN] =
+		{ POWER_SUPPLY_PROP_CHARGE_FULL_DESIGN, 0, "charge_full_design" },
+};
+
+static int max1720x_prop_cache_idx(enum power_supply_property psp)
+{
+	int i;
+
+	for (i = 0; i < MAX1720X_PCACHE_COUNT; i++)
+		if (max1720x_prop_cache_desc[i].psp == psp)
+			return i;
+
+	return -EINVAL;
+}
+
+static void max1720x_prop_cache_invalidate(struct max1720x_chip *chip)
+{
+	struct max1720x_prop_cache *cache = &chip->prop_cache;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	for (i = 0; i < MAX1720X_PCACHE_COUNT; i++)
+		cache->entry[i].valid = false;
+	cache->invalidated += 1;
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/* return true and set *val when the cached value is still fresh */
+static bool max1720x_prop_cache_get(struct max1720x_chip *chip, int idx,
+				    int *val)
+{
+	struct max1720x_prop_cache *cache = &chip->prop_cache;
+	struct max1720x_prop_cache_entry *entry = &cache->entry[idx];
+	unsigned long flags;
+	bool hit;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	hit = !cache->bypass && entry->valid &&
+	      (!max1720x_prop_cache_desc[idx].ttl_ms ||
+	       time_before(jiffies, entry->expires));
+	if (hit) {
+		*val = entry->val;
+		entry->hits += 1;
+	} else {
+		entry->misses += 1;
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return hit;
+}
+
+static void max1720x_prop_cache_put(struct max1720x_chip *chip, int idx,
+				    int val)
+{
+	struct max1720x_prop_cache *cache = &chip->prop_cache;
+	struct max1720x_prop_cache_entry *entry = &cache->entry[idx];
+	const unsigned int ttl_ms = max1720x_prop_cache_desc[idx].ttl_ms;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	entry->val = val;
+	entry->expires = jiffies + msecs_to_jiffies(ttl_ms);
+	entry->valid = true;
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/* ------------------------------------------------------------------------- */
+
 /*
  * offset of the register in this atom.
  * NOTE: this is the byte offset regardless of the size of the register
@@ -582,18 +749,140 @@ static inline int reg_to_vrecovery(u16 val)
 
 /* b/177099997 TaskPeriod ----------------------------------------------- */
 
+/*
+ * ->conv is specialized in max1720x_conv_update() when RSense is read and
+ * when a model is loaded: use the generic conversion when it is out of date.
+ * Readers are lockless, rsense and cap_lsb are the keys and are written after
+ * the multipliers: a reader that matches the keys sees the matching values.
+ */
+static inline const struct max17x0x_conv *
+max1720x_conv_get(const struct max1720x_chip *chip, int lsb)
+{
+	const struct max17x0x_conv *conv = &chip->conv;
+
+	if (unlikely(READ_ONCE(conv->rsense) != chip->RSense ||
+		     READ_ONCE(conv->cap_lsb) != lsb))
+		return NULL;
+
+	smp_rmb(); /* pairs with smp_wmb() in max1720x_conv_update() */
+	return conv;
+}
+
+/* call after updating chip->RSense or the model */
+static void max1720x_conv_update(struct max1720x_chip *chip)
+{
+	struct max17x0x_conv *conv = &chip->conv;
+	struct max17x0x_conv tmp;
+
+	max17x0x_conv_init(&tmp, chip->RSense,
+			   max_m5_cap_lsb(chip->model_data));
+
+	conv->micro_amp = tmp.micro_amp;
+	conv->micro_amp_h = tmp.micro_amp_h;
+	conv->res_micro_ohms = tmp.res_micro_ohms;
+	conv->time_hr = tmp.time_hr;
+
+	smp_wmb(); /* multipliers before the keys */
+	WRITE_ONCE(conv->rsense, tmp.rsense);
+	WRITE_ONCE(conv->cap_lsb, tmp.cap_lsb);
+}
+
+static inline int max1720x_micro_amp(const struct max1720x_chip *chip, u16 val)
+{
+	const struct max17x0x_conv *conv = max1720x_conv_get(chip, chip->conv.cap_lsb);
+
+	if (!conv)
+		return reg_to_micro_amp(val, chip->RSense);
+
+	return max17x0x_conv(conv, MAX17X0X_CONV_MICRO_AMP, val);
+}
+
+static inline int max1720x_resistance_micro_ohms(const struct max1720x_chip *chip,
+						 u16 val)
+{
+	const struct max17x0x_conv *conv = max1720x_conv_get(chip, chip->conv.cap_lsb);
+
+	if (!conv)
+		return reg_to_resistance_micro_ohms(val, chip->RSense);
+
+	return max17x0x_conv(conv, MAX17X0X_CONV_RES_MICRO_OHMS, val);
+}
+
 static inline int reg_to_capacity_uah(u16 val, struct max1720x_chip *chip)
 {
 	const int lsb = max_m5_cap_lsb(chip->model_data);
+	const struct max17x0x_conv *conv = max1720x_conv_get(chip, lsb);
 
-	return reg_to_micro_amp_h(val, chip->RSense, lsb);
+	if (!conv)
+		return reg_to_micro_amp_h(val, chip->RSense, lsb);
+
+	return max17x0x_conv(conv, MAX17X0X_CONV_CAPACITY_UAH, val);
 }
 
 static inline int reg_to_time_hr(u16 val, struct max1720x_chip *chip)
 {
 	const int lsb = max_m5_cap_lsb(chip->model_data);
+	const struct max17x0x_conv *conv = max1720x_conv_get(chip, lsb);
+
+	if (!conv)
+		return (val * 32 * lsb) / 10;
 
-	return (val * 32 * lsb) / 10;
+	return max17x0x_conv(conv, MAX17X0X_CONV_TIME_HR, val);
+}
+
+/* typed accessors for the tagged registers, decode units inline */
+static inline int max17x0x_read_micro_amp(struct max1720x_chip *chip,
+					  enum max17x0x_reg_tags tag, int *ua)
+{
+	u16 data;
+	int ret;
+
+	ret = max17x0x_reg_read(&chip->regmap, tag, &data);
+	if (ret == 0)
+		*ua = max1720x_micro_amp(chip, data);
+
+	return ret;
+}
+
+static inline int max17x0x_read_micro_volt(struct max1720x_chip *chip,
+					   enum max17x0x_reg_tags tag, int *uv)
+{
+	u16 data;
+	int ret;
+
+	ret = max17x0x_reg_read(&chip->regmap, tag, &data);
+	if (ret == 0)
+		*uv = reg_to_micro_volt(data);
+
+	return ret;
+}
+
+static inline int max17x0x_read_deci_deg_cel(struct max1720x_chip *chip,
+					     enum max17x0x_reg_tags tag,
+					     int *temp)
+{
+	u16 data;
+	int ret;
+
+	ret = max17x0x_reg_read(&chip->regmap, tag, &data);
+	if (ret == 0)
+		*temp = reg_to_deci_deg_cel(data);
+
+	return ret;
+}
+
+static inline int max17x0x_read_capacity_uah(struct max1720x_chip *chip,
+					     enum max17x0x_reg_tags tag,
+					     int *uah)
+{
+	u16 data;
+	int ret;
+
+	ret = max17x0x_reg_read(&chip->regmap, tag, &data);
+	if (ret == 0)
+		*uah = reg_to_capacity_uah(data, chip);
+
+	return ret;
 }
 
 #if 0
@@ -1017,7 +1306,7 @@ static int max17x0x_read_resistance_avg(struct max1720x_chip *chip)
 	if (ret < 0)
 		return ret;
 
-	return reg_to_resistance_micro_ohms(ravg, chip->RSense);
+	return max1720x_resistance_micro_ohms(chip, ravg);
 }
 
 static int max17x0x_read_resistance_raw(struct max1720x_chip *chip)
@@ -1040,7 +1329,7 @@ static int max17x0x_read_resistance(struct max1720x_chip *chip)
 	if (rslow < 0)
 		return rslow;
 
-	return reg_to_resistance_micro_ohms(rslow, chip->RSense);
+	return max1720x_resistance_micro_ohms(chip, rslow);
 }
 
 
@@ -1113,6 +1402,7 @@ static ssize_t rc_switch_enable_store(struct device *dev, struct device_attribut
 			 chip->rc_switch.rc2_learncfg, ret);
 	}
 
+	chip->rc_switch.zone = MAX1720X_RC_ZONE_UNKNOWN;
 	mod_delayed_work(system_wq, &chip->rc_switch.switch_work, 0);
 
 	return count;
@@ -1160,8 +1450,6 @@ EXPORT_SYMBOL_GPL(max1720x_get_capacity);
 int max1720x_get_voltage_now(struct i2c_client *client, int *volt)
 {
 	struct max1720x_chip *chip;
-	u16 temp;
-	int ret;
 
 	if (!client || !volt)
 		return -EINVAL;
@@ -1170,11 +1458,7 @@ int max1720x_get_voltage_now(struct i2c_client *client, int *volt)
 	if (!chip)
 		return -ENODEV;
 
-	ret = max17x0x_reg_read(&chip->regmap, MAX17X0X_TAG_vcel, &temp);
-	if (ret == 0)
-		*volt = reg_to_micro_volt(temp);
-
-	return ret;
+	return max17x0x_read_micro_volt(chip, MAX17X0X_TAG_vcel, volt);
 }
 EXPORT_SYMBOL_GPL(max1720x_get_voltage_now);
 
@@ -1245,15 +1529,15 @@ static int max1720x_get_battery_status(struct max1720x_chip *chip)
 	int current_now, current_avg, ichgterm, vfsoc, soc, fullsocthr;
 	int status = POWER_SUPPLY_STATUS_UNKNOWN, err;
 
-	err = max17x0x_reg_read(&chip->regmap, MAX17X0X_TAG_curr, &data);
+	err = max17x0x_read_micro_amp(chip, MAX17X0X_TAG_curr, &current_now);
 	if (err)
 		return -EIO;
-	current_now = -reg_to_micro_amp(data, chip->RSense);
+	current_now = -current_now;
 
-	err = max17x0x_reg_read(&chip->regmap, MAX17X0X_TAG_avgc, &data);
+	err = max17x0x_read_micro_amp(chip, MAX17X0X_TAG_avgc, &current_avg);
 	if (err)
 		return -EIO;
-	current_avg = -reg_to_micro_amp(data, chip->RSense);
+	current_avg = -current_avg;
 
 	if (chip->status_charge_threshold_ma) {
 		ichgterm = chip->status_charge_threshold_ma * 1000;
@@ -1261,7 +1545,7 @@ static int max1720x_get_battery_status(struct max1720x_chip *chip)
 		err = REGMAP_READ(&chip->regmap, MAX1720X_ICHGTERM, &data);
 		if (err)
 			return -EIO;
-		ichgterm = reg_to_micro_amp(data, chip->RSense);
+		ichgterm = max1720x_micro_amp(chip, data);
 	}
 
 	err = REGMAP_READ(&chip->regmap, MAX1720X_FULLSOCTHR, &data);
@@ -1651,7 +1935,7 @@ static int max1720x_update_cycle_count(struct max1720x_chip *chip)
 	chip->cycle_count = cycle_count + chip->cycle_count_offset;
 
 	if (chip->model_ok && reg_cycle >= chip->model_next_update) {
-		err = max1720x_set_next_update(chip);
+		err = max1720x_set_next_update(chip, reg_cycle);
 		if (err < 0)
 			dev_err(chip->dev, "%s cannot set next update (%d)\n",
 				 __func__, err);
@@ -1708,6 +1992,14 @@ static void max1720x_handle_update_empty_voltage(struct max1720x_chip *chip,
 	}
 }
 
+/* temperature dependent settings, on every TEMP read (cached or not) */
+static void max1720x_handle_update_temp(struct max1720x_chip *chip, int temp)
+{
+	max1720x_handle_update_nconvgcfg(chip, temp);
+	max1720x_handle_update_filtercfg(chip, temp);
+	max1720x_handle_update_empty_voltage(chip, temp);
+}
+
 /* Capacity Estimation functions*/
 static int batt_ce_regmap_read(struct max17x0x_regmap *map,
 			       const struct max17x0x_reg *bcea,
@@ -1854,7 +2146,6 @@ static void batt_ce_capacityfiltered_work(struct work_struct *work)
 	struct max1720x_chip *chip = container_of(work, struct max1720x_chip,
 					    cap_estimate.settle_timer.work);
 	struct gbatt_capacity_estimation *cap_esti = &chip->cap_estimate;
-	const int lsb = max_m5_cap_lsb(chip->model_data);
 	int settle_cc = 0, settle_vfsoc = 0;
 	int delta_cc = 0, delta_vfsoc = 0;
 	int cc_sum = 0, vfsoc_sum = 0;
@@ -1874,7 +2165,7 @@ static void batt_ce_capacityfiltered_work(struct work_struct *work)
 	if (rc < 0)
 		goto ioerr;
 
-	settle_cc = reg_to_micro_amp_h(chip->current_capacity, chip->RSense, lsb);
+	settle_cc = reg_to_capacity_uah(chip->current_capacity, chip);
 
 	data = max1720x_get_battery_vfsoc(chip);
 	if (data < 0)
@@ -1951,7 +2242,6 @@ static int batt_ce_init(struct gbatt_capacity_estimation *cap_esti,
 			struct max1720x_chip *chip)
 {
 	int rc, vfsoc;
-	const int lsb = max_m5_cap_lsb(chip->model_data);
 
 	rc = max1720x_update_battery_qh_based_capacity(chip);
 	if (rc < 0)
@@ -1962,8 +2252,8 @@ static int batt_ce_init(struct gbatt_capacity_estimation *cap_esti,
 		return -EIO;
 
 	cap_esti->start_vfsoc = vfsoc;
-	cap_esti->start_cc = reg_to_micro_amp_h(chip->current_capacity,
-						chip->RSense, lsb) / 1000;
+	cap_esti->start_cc = reg_to_capacity_uah(chip->current_capacity,
+						 chip) / 1000;
 	/* Capacity Estimation starts only when the state is NONE */
 	cap_esti->estimate_state = ESTIMATE_NONE;
 	return 0;
@@ -2095,7 +2385,7 @@ static int max1720x_health_get_ai(struct max1720x_chip *chip)
 		return -EINVAL;
 
 	/* not zero, not negative */
-	chip->bhi_acim = reg_to_resistance_micro_ohms(act_impedance, chip->RSense);;
+	chip->bhi_acim = max1720x_resistance_micro_ohms(chip, act_impedance);
 
 	/* TODO: corrrect impedance with timerh */
 
@@ -2195,10 +2485,13 @@ static int max1720x_get_property(struct power_supply *psy,
 	struct max1720x_chip *chip = (struct max1720x_chip *)
 					power_supply_get_drvdata(psy);
 	struct max17x0x_regmap *map = &chip->regmap;
-	int rc, err = 0;
+	const bool uncached = psp & GBMS_PROP_UNCACHED;
+	int rc, err = 0, cache_idx;
 	u16 data = 0;
 	int idata;
 
+	psp = (enum power_supply_property)(psp & ~GBMS_PROP_UNCACHED);
+
 	__pm_stay_awake(chip->get_prop_ws);
 	mutex_lock(&chip->model_lock);
 
@@ -2211,6 +2504,15 @@ static int max1720x_get_property(struct power_supply *psy,
 	}
 	pm_runtime_put_sync(chip->dev);
 
+	/* a fresh read refreshes the cache */
+	cache_idx = max1720x_prop_cache_idx(psp);
+	if (cache_idx >= 0 && !uncached &&
+	    max1720x_prop_cache_get(chip, cache_idx, &val->intval)) {
+		if (psp == POWER_SUPPLY_PROP_TEMP)
+			max1720x_handle_update_temp(chip, val->intval);
+		goto exit_done;
+	}
+
 	switch (psp) {
 	case POWER_SUPPLY_PROP_STATUS:
 		err = max1720x_get_battery_status(chip);
@@ -2278,15 +2580,17 @@ static int max1720x_get_property(struct power_supply *psy,
 		break;
 	/* current is positive value when flowing to device */
 	case POWER_SUPPLY_PROP_CURRENT_AVG:
-		err = max17x0x_reg_read(map, MAX17X0X_TAG_avgc, &data);
+		err = max17x0x_read_micro_amp(chip, MAX17X0X_TAG_avgc,
+					      &val->intval);
 		if (err == 0)
-			val->intval = -reg_to_micro_amp(data, chip->RSense);
+			val->intval = -val->intval;
 		break;
 	/* current is positive value when flowing to device */
 	case POWER_SUPPLY_PROP_CURRENT_NOW:
-		err = max17x0x_reg_read(map, MAX17X0X_TAG_curr, &data);
+		err = max17x0x_read_micro_amp(chip, MAX17X0X_TAG_curr,
+					      &val->intval);
 		if (err == 0)
-			val->intval = -reg_to_micro_amp(data, chip->RSense);
+			val->intval = -val->intval;
 		break;
 	case POWER_SUPPLY_PROP_CYCLE_COUNT:
 		err = max1720x_get_cycle_count(chip);
@@ -2327,14 +2631,12 @@ static int max1720x_get_property(struct power_supply *psy,
 		}
 		break;
 	case POWER_SUPPLY_PROP_TEMP:
-		err = max17x0x_reg_read(map, MAX17X0X_TAG_temp, &data);
+		err = max17x0x_read_deci_deg_cel(chip, MAX17X0X_TAG_temp,
+						 &val->intval);
 		if (err < 0)
 			break;
 
-		val->intval = reg_to_deci_deg_cel(data);
-		max1720x_handle_update_nconvgcfg(chip, val->intval);
-		max1720x_handle_update_filtercfg(chip, val->intval);
-		max1720x_handle_update_empty_voltage(chip, val->intval);
+		max1720x_handle_update_temp(chip, val->intval);
 		break;
 	case POWER_SUPPLY_PROP_TIME_TO_EMPTY_AVG:
 		err = REGMAP_READ(map, MAX1720X_TTE, &data);
@@ -2367,9 +2669,8 @@ static int max1720x_get_property(struct power_supply *psy,
 			val->intval = (data & 0xFF) * 20000;
 		break;
 	case POWER_SUPPLY_PROP_VOLTAGE_NOW:
-		err = max17x0x_reg_read(map, MAX17X0X_TAG_vcel, &data);
-		if (err == 0)
-			val->intval = reg_to_micro_volt(data);
+		err = max17x0x_read_micro_volt(chip, MAX17X0X_TAG_vcel,
+					       &val->intval);
 		break;
 	case POWER_SUPPLY_PROP_VOLTAGE_OCV:
 		rc = max17x0x_reg_read(map, MAX17X0X_TAG_vfocv, &data);
@@ -2419,7 +2720,10 @@ static int max1720x_get_property(struct power_supply *psy,
 
 	if (err < 0)
 		pr_debug("error %d reading prop %d\n", err, psp);
+	else if (cache_idx >= 0)
+		max1720x_prop_cache_put(chip, cache_idx, val->intval);
 
+exit_done:
 	mutex_unlock(&chip->model_lock);
 	__pm_relax(chip->get_prop_ws);
 
@@ -2468,8 +2772,9 @@ static void max1720x_fixup_capacity(struct max1720x_chip *chip, int plugged)
 		return;
 
 	/* capacity outliers: fix rcomp0, tempco */
-	ret = max1720x_fixup_comp(ddata, &chip->regmap, plugged);
+	ret = max1720x_fixup_comp(ddata, &chip->regmap);
 	if (ret > 0) {
+		max1720x_prop_cache_invalidate(chip);
 		chip->comp_update_count += 1;
 
 		data16 = chip->comp_update_count;
@@ -2489,6 +2794,7 @@ static void max1720x_fixup_capacity(struct max1720x_chip *chip, int plugged)
 	cap_lsb = max_m5_cap_lsb(chip->model_data);
 	ret = max1720x_fixup_dxacc(ddata, &chip->regmap, cycle_count, plugged, cap_lsb);
 	if (ret > 0) {
+		max1720x_prop_cache_invalidate(chip);
 		chip->dxacc_update_count += 1;
 
 		data16 = chip->dxacc_update_count;
@@ -2887,6 +3193,9 @@ static irqreturn_t max1720x_fg_irq_thread_fn(int irq, void *obj)
 	/* only used to report health */
 	chip->health_status |= fg_status;
 
+	/* capacity, voltage or temperature crossed a threshold */
+	max1720x_prop_cache_invalidate(chip);
+
 	/*
 	 * write 0 to clear will loose interrupts when we don't write 1 to the
 	 * bits that are not set. Just inverting fg_status cause an interrupt
@@ -2979,8 +3288,14 @@ static irqreturn_t max1720x_fg_irq_thread_fn(int irq, void *obj)
 	if (fg_status & MAX1720X_STATUS_DSOCI) {
 		const bool plugged = chip->cap_estimate.cable_in;
 
+		/* rules are rebuilt and fixed in model_work under model_lock */
+		mutex_lock(&chip->model_lock);
 		if (max1720x_check_drift_on_soc(&chip->drift_data))
 			max1720x_fixup_capacity(chip, plugged);
+		else if (!(fg_status & MAX1720X_STATUS_POR))
+			max1720x_fixup_outliers(&chip->drift_data,
+						&chip->regmap, false);
+		mutex_unlock(&chip->model_lock);
 
 		if (storm) {
 			pr_debug("Force power_supply_change in storm\n");
@@ -3804,6 +4119,72 @@ static ssize_t max1720x_set_custom_model(struct file *filp,
 BATTERY_DEBUG_ATTRIBUTE(debug_m5_custom_model_fops, max1720x_show_custom_model,
 			max1720x_set_custom_model);
 
+/* binary struct max_m5_state_bin with the current state from the gauge */
+static ssize_t max1720x_show_model_state_bin(struct file *filp,
+					     char __user *buf,
+					     size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	struct max_m5_state_bin bin;
+	ssize_t len;
+
+	if (!chip->model_data)
+		return -EINVAL;
+
+	mutex_lock(&chip->model_lock);
+	len = max_m5_model_read_state(chip->model_data);
+	if (len == 0)
+		len = max_m5_model_state_bin(&bin, sizeof(bin), chip->model_data);
+	mutex_unlock(&chip->model_lock);
+
+	if (len > 0)
+		len = simple_read_from_buffer(buf, count, ppos, &bin, len);
+
+	return len;
+}
+
+/* restore a state exported from model_state_bin, reload the model */
+static ssize_t max1720x_set_model_state_bin(struct file *filp,
+					    const char __user *user_buf,
+					    size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	struct max_m5_state_bin bin;
+	int ret;
+
+	if (!chip->model_data)
+		return -EINVAL;
+	if (*ppos != 0 || count != sizeof(bin))
+		return -EINVAL;
+	if (copy_from_user(&bin, user_buf, sizeof(bin)))
+		return -EFAULT;
+
+	mutex_lock(&chip->model_lock);
+
+	/* read current state from gauge, overwrite with the binary state */
+	ret = max_m5_model_read_state(chip->model_data);
+	if (ret == 0)
+		ret = max_m5_model_state_bin_load(chip->model_data, &bin,
+						  sizeof(bin));
+	if (ret == 0) {
+		/* force model state (valid) */
+		chip->model_state_valid = true;
+		max1720x_model_reload(chip, true);
+	}
+
+	mutex_unlock(&chip->model_lock);
+
+	if (ret < 0)
+		return ret;
+
+	*ppos += count;
+	return count;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_m5_model_state_bin_fops,
+			max1720x_show_model_state_bin,
+			max1720x_set_model_state_bin);
+
 
 static int debug_sync_model(void *data, u64 val)
 {
@@ -3910,6 +4291,184 @@ static ssize_t max1720x_show_reg_all(struct file *filp, char __user *buf,
 
 BATTERY_DEBUG_ATTRIBUTE(debug_reg_all_fops, max1720x_show_reg_all, NULL);
 
+static ssize_t max1720x_show_outliers(struct file *filp, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	char *tmp;
+	int len;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	mutex_lock(&chip->model_lock);
+	len = max1720x_outliers_cstr(tmp, PAGE_SIZE, &chip->drift_data);
+	mutex_unlock(&chip->model_lock);
+	if (len > 0)
+		len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+
+	kfree(tmp);
+
+	return len;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_outliers_fops, max1720x_show_outliers, NULL);
+
+static const char *max1720x_maint_names[MAX1720X_MAINT_COUNT] = {
+	[MAX1720X_MAINT_IDLE] = "idle",
+	[MAX1720X_MAINT_MODEL_LOAD] = "model_load",
+	[MAX1720X_MAINT_MODEL_RETRY] = "model_retry",
+	[MAX1720X_MAINT_STATE_SAVE] = "state_save",
+	[MAX1720X_MAINT_STATE_SAME] = "state_same",
+	[MAX1720X_MAINT_RC_POLL] = "rc_poll",
+	[MAX1720X_MAINT_RC_CHECK] = "rc_check",
+	[MAX1720X_MAINT_RC_SWITCH] = "rc_switch",
+	[MAX1720X_MAINT_RC_RETRY] = "rc_retry",
+};
+
+static ssize_t max1720x_show_maint(struct file *filp, char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	const struct max1720x_maint *maint = &chip->maint;
+	long rc_next_ms = 0;
+	char *tmp;
+	int i, len = 0;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	if (chip->rc_switch.available && chip->rc_switch.enable &&
+	    time_after(maint->rc_next_jiffies, jiffies))
+		rc_next_ms = jiffies_to_msecs(maint->rc_next_jiffies - jiffies);
+
+	len += scnprintf(&tmp[len], PAGE_SIZE - len,
+			 "model: next=%s next_update=%d\n",
+			 max1720x_maint_names[maint->model_next],
+			 chip->model_next_update);
+	len += scnprintf(&tmp[len], PAGE_SIZE - len,
+			 "rc: next=%s in=%ldms zone=%d\n",
+			 max1720x_maint_names[maint->rc_next], rc_next_ms,
+			 chip->rc_switch.zone);
+
+	for (i = 0; i < MAX1720X_MAINT_COUNT; i++)
+		len += scnprintf(&tmp[len], PAGE_SIZE - len, "%s: %u\n",
+				 max1720x_maint_names[i], maint->count[i]);
+
+	len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+	kfree(tmp);
+
+	return len;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_maint_fops, max1720x_show_maint, NULL);
+
+static ssize_t max1720x_show_prop_cache(struct file *filp, char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	struct max1720x_prop_cache *cache = &chip->prop_cache;
+	struct max1720x_prop_cache_entry entry[MAX1720X_PCACHE_COUNT];
+	unsigned long flags;
+	u32 invalidated;
+	char *tmp;
+	int i, len = 0;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	memcpy(entry, cache->entry, sizeof(entry));
+	invalidated = cache->invalidated;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	len += scnprintf(&tmp[len], PAGE_SIZE - len,
+			 "bypass=%d invalidated=%u\n", cache->bypass,
+			 invalidated);
+	for (i = 0; i < MAX1720X_PCACHE_COUNT; i++)
+		len += scnprintf(&tmp[len], PAGE_SIZE - len,
+				 "%s: ttl=%u hits=%u misses=%u valid=%d val=%d\n",
+				 max1720x_prop_cache_desc[i].name,
+				 max1720x_prop_cache_desc[i].ttl_ms,
+				 entry[i].hits, entry[i].misses,
+				 entry[i].valid, entry[i].val);
+
+	len = simple_read_from_buffer(buf, count, ppos, tmp, len);
+	kfree(tmp);
+
+	return len;
+}
+
+/* any write resets the statistics and drops the cached values */
+static ssize_t max1720x_reset_prop_cache(struct file *filp,
+					 const char __user *user_buf,
+					 size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	struct max1720x_prop_cache *cache = &chip->prop_cache;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	for (i = 0; i < MAX1720X_PCACHE_COUNT; i++) {
+		cache->entry[i].valid = false;
+		cache->entry[i].hits = 0;
+		cache->entry[i].misses = 0;
+	}
+	cache->invalidated = 0;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return count;
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_prop_cache_fops, max1720x_show_prop_cache,
+			max1720x_reset_prop_cache);
+
+/* compare the specialized conversions with the generic ones on all inputs */
+static ssize_t max1720x_show_conv_check(struct file *filp, char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct max1720x_chip *chip = (struct max1720x_chip *)filp->private_data;
+	const int lsb = max_m5_cap_lsb(chip->model_data);
+	const u16 rsense = chip->RSense;
+	int err_ua = 0, err_uah = 0, err_res = 0, err_hr = 0;
+	struct max17x0x_conv conv;
+	char tmp[128];
+	u32 val;
+	int len;
+
+	if (!rsense)
+		return -ENODEV;
+
+	max17x0x_conv_init(&conv, rsense, lsb);
+
+	for (val = 0; val <= U16_MAX; val++) {
+		if (max17x0x_conv(&conv, MAX17X0X_CONV_MICRO_AMP, val) !=
+		    reg_to_micro_amp(val, rsense))
+			err_ua++;
+		if (max17x0x_conv(&conv, MAX17X0X_CONV_CAPACITY_UAH, val) !=
+		    reg_to_micro_amp_h(val, rsense, lsb))
+			err_uah++;
+		if (max17x0x_conv(&conv, MAX17X0X_CONV_RES_MICRO_OHMS, val) !=
+		    reg_to_resistance_micro_ohms(val, rsense))
+			err_res++;
+		if (max17x0x_conv(&conv, MAX17X0X_CONV_TIME_HR, val) !=
+		    (val * 32 * lsb) / 10)
+			err_hr++;
+	}
+
+	len = scnprintf(tmp, sizeof(tmp),
+			"rsense=%u lsb=%d ua=%d uah=%d res=%d hr=%d\n",
+			rsense, lsb, err_ua, err_uah, err_res, err_hr);
+
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+BATTERY_DEBUG_ATTRIBUTE(debug_conv_check_fops, max1720x_show_conv_check, NULL);
+
 static ssize_t max1720x_show_nvreg_all(struct file *filp, char __user *buf,
 					size_t count, loff_t *ppos)
 {
@@ -4058,6 +4617,12 @@ static int max17x0x_init_sysfs(struct max1720x_chip *chip)
 	debugfs_create_file("fake_battery", 0400, de, chip, &debug_fake_battery_fops);
 	debugfs_create_file("batt_id", 0600, de, chip, &debug_batt_id_fops);
 	debugfs_create_file("force_psy_update", 0600, de, chip, &debug_force_psy_update_fops);
+	debugfs_create_file("outliers", 0444, de, chip, &debug_outliers_fops);
+	debugfs_create_file("maint", 0444, de, chip, &debug_maint_fops);
+	debugfs_create_file("prop_cache", 0644, de, chip, &debug_prop_cache_fops);
+	debugfs_create_file("conv_check", 0400, de, chip, &debug_conv_check_fops);
+	debugfs_create_bool("prop_cache_bypass", 0644, de,
+			    &chip->prop_cache.bypass);
 
 	if (chip->regmap.reglog)
 		debugfs_create_file("regmap_writes", 0440, de,
@@ -4072,6 +4637,9 @@ static int max17x0x_init_sysfs(struct max1720x_chip *chip)
 	if (chip->gauge_type == MAX_M5_GAUGE_TYPE)
 		debugfs_create_file("fg_model", 0444, de, chip,
 				    &debug_m5_custom_model_fops);
+	if (chip->gauge_type == MAX_M5_GAUGE_TYPE)
+		debugfs_create_file("model_state_bin", 0600, de, chip,
+				    &debug_m5_model_state_bin_fops);
 	debugfs_create_bool("model_ok", 0444, de, &chip->model_ok);
 	debugfs_create_file("sync_model", 0400, de, chip,
 			    &debug_sync_model_fops);
@@ -4270,7 +4838,7 @@ static int max17x0x_dump_param(struct max1720x_chip *chip)
 		return ret;
 
 	dev_info(chip->dev, "IChgTerm: %d\n",
-		 reg_to_micro_amp(data, chip->RSense));
+		 max1720x_micro_amp(chip, data));
 
 	ret = REGMAP_READ(&chip->regmap, MAX1720X_VEMPTY, &data);
 	if (ret < 0)
@@ -4300,19 +4868,26 @@ static int max1720x_clear_por(struct max1720x_chip *chip)
 				  0x0);
 }
 
-/* read state from fg (if needed) and set the next update field */
-static int max1720x_set_next_update(struct max1720x_chip *chip)
+/*
+ * read state from fg (if needed) and set the next update field, reg_cycle
+ * is read from the gauge when < 0.
+ */
+static int max1720x_set_next_update(struct max1720x_chip *chip, int reg_cycle)
 {
+	u16 data;
 	int rc;
-	u16 reg_cycle;
 
 	/* do not save data when battery ID not clearly */
 	if (chip->batt_id == DEFAULT_BATTERY_ID)
 		return 0;
 
-	rc = REGMAP_READ(&chip->regmap, MAX1720X_CYCLES, &reg_cycle);
-	if (rc < 0)
-		return rc;
+	if (reg_cycle < 0) {
+		rc = REGMAP_READ(&chip->regmap, MAX1720X_CYCLES, &data);
+		if (rc < 0)
+			return rc;
+
+		reg_cycle = data;
+	}
 
 	if (chip->model_next_update && reg_cycle < chip->model_next_update)
 		return 0;
@@ -4328,8 +4903,17 @@ static int max1720x_set_next_update(struct max1720x_chip *chip)
 		}
 	}
 
-	if (rc == 0 && chip->model_next_update)
-		rc = max_m5_save_state_data(chip->model_data);
+	/* save only when the gauge learned something since the last save */
+	if (rc == 0 && chip->model_next_update) {
+		if (max_m5_model_state_changed(chip->model_data)) {
+			rc = max_m5_save_state_data(chip->model_data);
+			if (rc == 0)
+				chip->maint.count[MAX1720X_MAINT_STATE_SAVE] += 1;
+		} else {
+			chip->maint.count[MAX1720X_MAINT_STATE_SAME] += 1;
+		}
+	}
+
 	if (rc == 0)
 		chip->model_next_update = (reg_cycle + (1 << 6)) &
 					  ~((1 << 6) - 1);
@@ -4395,6 +4979,7 @@ static void max1720x_model_work(struct work_struct *work)
 	/* set model_reload to the #attempts, might change cycle count */
 	if (chip->model_reload >= MAX_M5_LOAD_MODEL_REQUEST) {
 
+		chip->maint.count[MAX1720X_MAINT_MODEL_LOAD] += 1;
 		rc = max1720x_model_load(chip);
 		if (rc == 0) {
 			rc = max1720x_clear_por(chip);
@@ -4410,6 +4995,7 @@ static void max1720x_model_work(struct work_struct *work)
 				chip->model_reload = MAX_M5_LOAD_MODEL_IDLE;
 				chip->model_ok = true;
 				new_model = true;
+				max1720x_prop_cache_invalidate(chip);
 				/* saved new value in max1720x_set_next_update */
 				chip->model_next_update = reg_cycle > 0 ? reg_cycle - 1 : 0;
 			}
@@ -4428,14 +5014,25 @@ static void max1720x_model_work(struct work_struct *work)
 	if (chip->model_reload >= MAX_M5_LOAD_MODEL_REQUEST) {
 		const unsigned long delay = msecs_to_jiffies(60 * 1000);
 
+		chip->maint.count[MAX1720X_MAINT_MODEL_RETRY] += 1;
+		chip->maint.model_next = MAX1720X_MAINT_MODEL_RETRY;
 		mod_delayed_work(system_wq, &chip->model_work, delay);
+	} else {
+		chip->maint.model_next = MAX1720X_MAINT_IDLE;
 	}
 
 	if (new_model) {
+		/* the model resets LearnCfg */
+		if (chip->rc_switch.available && chip->rc_switch.enable) {
+			chip->rc_switch.zone = MAX1720X_RC_ZONE_UNKNOWN;
+			mod_delayed_work(system_wq, &chip->rc_switch.switch_work, 0);
+		}
+
 		dev_info(chip->dev, "FG Model OK, ver=%d cap_lsb=%d next_update=%d\n",
 			 max_m5_fg_model_version(chip->model_data),
 			 max_m5_cap_lsb(chip->model_data),
 			 chip->model_next_update);
+		max1720x_conv_update(chip);
 		max1720x_prime_battery_qh_capacity(chip, POWER_SUPPLY_STATUS_UNKNOWN);
 		power_supply_changed(chip->psy);
 	}
@@ -4493,7 +5090,9 @@ static void max1720x_rc_work(struct work_struct *work)
 {
 	struct max1720x_chip *chip = container_of(work, struct max1720x_chip,
 						  rc_switch.switch_work.work);
+	enum max1720x_maint_event event = MAX1720X_MAINT_RC_POLL;
 	int interval = RC_WORK_TIME_MS;
+	enum max1720x_rc_zone zone;
 	u16 data, learncfg;
 	bool to_rc1, to_rc2;
 	int ret = 0, soc, temp;
@@ -4501,6 +5100,9 @@ static void max1720x_rc_work(struct work_struct *work)
 	if (!chip->rc_switch.available || !chip->rc_switch.enable)
 		return;
 
+	/* LearnCfg is not valid until the model is reloaded */
+	if (chip->por)
+		chip->rc_switch.zone = MAX1720X_RC_ZONE_UNKNOWN;
 	if (chip->por || !chip->resume_complete)
 		goto reschedule;
 
@@ -4518,6 +5120,16 @@ static void max1720x_rc_work(struct work_struct *work)
 
 	temp = reg_to_deci_deg_cel(data);
 
+	to_rc1 = soc < chip->rc_switch.soc || temp < chip->rc_switch.temp;
+	to_rc2 = soc >= chip->rc_switch.soc && temp >= chip->rc_switch.temp;
+
+	/* LearnCfg is checked (and fixed) only when crossing a threshold */
+	zone = to_rc2 ? MAX1720X_RC_ZONE_RC2 : MAX1720X_RC_ZONE_RC1;
+	if (zone == chip->rc_switch.zone)
+		goto reschedule;
+
+	event = MAX1720X_MAINT_RC_CHECK;
+
 	/* Read LearnCfg */
 	ret = REGMAP_READ(&chip->regmap, MAX_M5_LEARNCFG, &learncfg);
 	if (ret < 0)
@@ -4531,9 +5143,6 @@ static void max1720x_rc_work(struct work_struct *work)
 			dev_warn(chip->dev, "Unable to clear LearnTCO\n");
 	}
 
-	to_rc1 = soc < chip->rc_switch.soc || temp < chip->rc_switch.temp;
-	to_rc2 = soc >= chip->rc_switch.soc && temp >= chip->rc_switch.temp;
-
 	if (to_rc1 && ((learncfg & MAX_M5_LEARNCFG_RC_VER) == MAX_M5_LEARNCFG_RC2)) {
 		/*
 		 * 1: set LearnCfg.LearnRComp = 0
@@ -4553,6 +5162,7 @@ static void max1720x_rc_work(struct work_struct *work)
 		gbms_logbuffer_prlog(chip->monitor_log, LOGLEVEL_INFO, 0, LOGLEVEL_INFO,
 				     "%s to RC1. ret=%d soc=%d temp=%d tempco=0x%x, learncfg=0x%x",
 				     __func__, ret, soc, temp, chip->rc_switch.rc1_tempco, learncfg);
+		event = MAX1720X_MAINT_RC_SWITCH;
 
 	} else if (to_rc2 && ((learncfg & MAX_M5_LEARNCFG_RC_VER) == MAX_M5_LEARNCFG_RC1)) {
 		/*
@@ -4574,15 +5184,23 @@ static void max1720x_rc_work(struct work_struct *work)
 		gbms_logbuffer_prlog(chip->monitor_log, LOGLEVEL_INFO, 0, LOGLEVEL_INFO,
 				     "%s to RC2. ret=%d soc=%d temp=%d tempco=0x%x, learncfg=0x%x",
 				     __func__, ret, soc, temp, chip->rc_switch.rc2_tempco, learncfg);
+		event = MAX1720X_MAINT_RC_SWITCH;
 	}
 
+	if (ret == 0)
+		chip->rc_switch.zone = zone;
+
 reschedule:
 	if (ret != 0) {
 		interval = RC_WORK_TIME_QUICK_MS;
+		event = MAX1720X_MAINT_RC_RETRY;
 		gbms_logbuffer_prlog(chip->monitor_log, LOGLEVEL_WARNING, 0, LOGLEVEL_INFO,
 				     "%s didn't finish. ret=%d", __func__, ret);
 	}
 
+	chip->maint.count[event] += 1;
+	chip->maint.rc_next = event;
+	chip->maint.rc_next_jiffies = jiffies + msecs_to_jiffies(interval);
 	mod_delayed_work(system_wq, &chip->rc_switch.switch_work, msecs_to_jiffies(interval));
 }
 
@@ -4716,6 +5334,11 @@ static int max17201_init_fix_capacity(struct max1720x_chip *chip)
 		dev_info(chip->dev, "ini_filtercfg=0x%x\n",
 			 ddata->ini_filtercfg);
 
+	ret = max1720x_outliers_init(ddata, chip->batt_node ?
+				     chip->batt_node : chip->dev->of_node);
+	if (ret < 0)
+		dev_err(chip->dev, "invalid outlier rules (%d)\n", ret);
+
 	return 0;
 }
 
@@ -4827,7 +5450,7 @@ static int max1720x_init_max_m5(struct max1720x_chip *chip)
 		return 0;
 	}
 
-	ret = max1720x_set_next_update(chip);
+	ret = max1720x_set_next_update(chip, -1);
 	if (ret < 0)
 		dev_warn(chip->dev, "Error on Next Update, Will retry\n");
 
@@ -4835,6 +5458,7 @@ static int max1720x_init_max_m5(struct max1720x_chip *chip)
 			max_m5_model_read_version(chip->model_data),
 			max_m5_cap_lsb(chip->model_data),
 			chip->model_next_update);
+	max1720x_conv_update(chip);
 
 	chip->reg_prop_capacity_raw = MAX1720X_REPSOC;
 	chip->model_state_valid = true;
@@ -5003,6 +5627,7 @@ static int max1720x_init_chip(struct max1720x_chip *chip)
 	if (ret < 0)
 		return -EPROBE_DEFER;
 	dev_info(chip->dev, "RSense value %d micro Ohm\n", chip->RSense * 10);
+	max1720x_conv_update(chip);
 
 	ret = REGMAP_READ(&chip->regmap, MAX1720X_STATUS, &data);
 	if (!ret && data & MAX1720X_STATUS_BR) {
@@ -5839,8 +6464,8 @@ static int max17x0x_regmap_init(struct max1720x_chip *chip)
 		/* shadow override is not supported on early samples */
 		chip->shadow_override = (chip->devname >> 4) != 0x404;
 
-		chip->regmap.regtags.max = ARRAY_SIZE(max1730x);
-		chip->regmap.regtags.map = max1730x;
+		max17x0x_regtags_init(&chip->regmap.regtags, max1730x,
+				      ARRAY_SIZE(max1730x));
 		chip->fixups_fn = max1730x_fixups;
 	} else if (chip->gauge_type == MAX_M5_GAUGE_TYPE) {
 		int ret;
@@ -5865,8 +6490,8 @@ static int max17x0x_regmap_init(struct max1720x_chip *chip)
 		}
 
 		/* max1720x is default map */
-		chip->regmap.regtags.max = ARRAY_SIZE(max1720x);
-		chip->regmap.regtags.map = max1720x;
+		max17x0x_regtags_init(&chip->regmap.regtags, max1720x,
+				      ARRAY_SIZE(max1720x));
 	}
 
 	/* todo read secondary address from DT */
@@ -5896,8 +6521,8 @@ static int max17x0x_regmap_init(struct max1720x_chip *chip)
 			return -EINVAL;
 		}
 
-		chip->regmap_nvram.regtags.max = ARRAY_SIZE(max1730x);
-		chip->regmap_nvram.regtags.map = max1730x;
+		max17x0x_regtags_init(&chip->regmap_nvram.regtags, max1730x,
+				      ARRAY_SIZE(max1730x));
 	} else {
 		chip->regmap_nvram.regmap =
 			devm_regmap_init_i2c(chip->secondary,
@@ -5908,8 +6533,8 @@ static int max17x0x_regmap_init(struct max1720x_chip *chip)
 			return -EINVAL;
 		}
 
-		chip->regmap_nvram.regtags.max = ARRAY_SIZE(max1720x);
-		chip->regmap_nvram.regtags.map = max1720x;
+		max17x0x_regtags_init(&chip->regmap_nvram.regtags, max1720x,
+				      ARRAY_SIZE(max1720x));
 	}
 
 	return 0;
@@ -6043,6 +6668,7 @@ static int max1720x_probe(struct i2c_client *client,
 
 	/* fuel gauge model needs to know the batt_id */
 	mutex_init(&chip->model_lock);
+	spin_lock_init(&chip->prop_cache.lock);
 
 	chip->get_prop_ws = wakeup_source_register(NULL, "GetProp");
 	if (!chip->get_prop_ws)
@@ -6214,6 +6840,8 @@ static int max1720x_pm_resume(struct device *dev)
 	struct i2c_client *client = to_i2c_client(dev);
 	struct max1720x_chip *chip = i2c_get_clientdata(client);
 
+	max1720x_prop_cache_invalidate(chip);
+
 	pm_runtime_get_sync(chip->dev);
 	chip->resume_complete = true;
 	if (chip->irq_disabled) {
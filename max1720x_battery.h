@@ -49,6 +49,96 @@ static inline int reg_to_micro_volt(u16 val)
 	return div_u64((u64) val * 78125, 1000);
 }
 
+/*
+ * val * num / den truncated toward zero with a multiply and a shift.
+ * mul = ceil(num * 2^shift / den) with 2^shift > 2^16 * den gives the exact
+ * quotient for every 16 bit input: the error of the reciprocal is less than
+ * the smallest non zero fractional part (1/den) of the exact result.
+ * num must be less than 2^32, den less than 2^16 and not zero.
+ */
+struct max17x0x_qconv {
+	u64 mul;
+	u32 shift;
+};
+
+static inline void max17x0x_qconv_init(struct max17x0x_qconv *qc,
+				       u32 num, u16 den)
+{
+	qc->shift = 16 + fls(den);
+	qc->mul = div_u64(((u64)num << qc->shift) + den - 1, den);
+}
+
+static inline int max17x0x_qconv_s16(const struct max17x0x_qconv *qc, s16 val)
+{
+	const int mag = ((u64)abs(val) * qc->mul) >> qc->shift;
+
+	return val < 0 ? -mag : mag;
+}
+
+static inline int max17x0x_qconv_u16(const struct max17x0x_qconv *qc, u16 val)
+{
+	return ((u64)val * qc->mul) >> qc->shift;
+}
+
+enum max17x0x_conv_kind {
+	MAX17X0X_CONV_MICRO_AMP,	/* reg_to_micro_amp() */
+	MAX17X0X_CONV_CAPACITY_UAH,	/* reg_to_micro_amp_h() */
+	MAX17X0X_CONV_RES_MICRO_OHMS,	/* reg_to_resistance_micro_ohms() */
+	MAX17X0X_CONV_TIME_HR,		/* reg_to_time_hr() */
+};
+
+/* conversions specialized for rsense and cap_lsb (TaskPeriod) */
+struct max17x0x_conv {
+	u16 rsense;
+	int cap_lsb;
+	struct max17x0x_qconv micro_amp;
+	struct max17x0x_qconv micro_amp_h;
+	struct max17x0x_qconv res_micro_ohms;
+	struct max17x0x_qconv time_hr;
+};
+
+/*
+ * rsense == 0 is not valid, all the conversions return 0. Builds into a
+ * private struct: see max1720x_conv_update() for publishing to readers.
+ */
+static inline void max17x0x_conv_init(struct max17x0x_conv *conv, u16 rsense,
+				      int cap_lsb)
+{
+	memset(conv, 0, sizeof(*conv));
+	conv->rsense = rsense;
+	conv->cap_lsb = cap_lsb;
+
+	/* LSB: 32 * cap_lsb / 10 hours */
+	max17x0x_qconv_init(&conv->time_hr, 32 * cap_lsb, 10);
+	if (!rsense)
+		return;
+
+	/* LSB: 1.5625μV/RSENSE ; Rsense LSB is 10μΩ */
+	max17x0x_qconv_init(&conv->micro_amp, 156250, rsense);
+	/* LSB: 5.0μVh/RSENSE, multiplied by cap_lsb after the division */
+	max17x0x_qconv_init(&conv->micro_amp_h, 500000, rsense);
+	/* LSB: 1/4096 Ohm */
+	max17x0x_qconv_init(&conv->res_micro_ohms, 1000 * rsense, 4096);
+}
+
+static inline int max17x0x_conv(const struct max17x0x_conv *conv,
+				enum max17x0x_conv_kind kind, u16 val)
+{
+	switch (kind) {
+	case MAX17X0X_CONV_MICRO_AMP:
+		return max17x0x_qconv_s16(&conv->micro_amp, val);
+	case MAX17X0X_CONV_CAPACITY_UAH:
+		return max17x0x_qconv_s16(&conv->micro_amp_h, val) *
+		       conv->cap_lsb;
+	case MAX17X0X_CONV_RES_MICRO_OHMS:
+		return max17x0x_qconv_s16(&conv->res_micro_ohms, val);
+	case MAX17X0X_CONV_TIME_HR:
+		return max17x0x_qconv_u16(&conv->time_hr, val);
+	}
+
+	return 0;
+}
+
 enum max17x0x_reg_tags {
 	MAX17X0X_TAG_avgc,
 	MAX17X0X_TAG_cnfg,
@@ -67,6 +157,8 @@ enum max17x0x_reg_tags {
 	MAX17X0X_TAG_BCEA,
 	MAX17X0X_TAG_rset,
 	MAX17X0X_TAG_BRES,
+
+	MAX17X0X_TAG_COUNT,
 };
 
 enum max17x0x_reg_types {
@@ -128,11 +220,42 @@ struct max17x0x_reglog {
 	int count[NB_REGMAP_MAX];
 };
 
+/*
+ * map/max point to the static per-gauge table (max1720x[], max1730x[],
+ * max_m5[]), tag[] and reg16[] are resolved from it once at regmap init
+ * time. reg16[] is -1 for tags that are not a single 16 bit register on
+ * this gauge.
+ */
 struct max17x0x_regtags {
 	const struct max17x0x_reg *map;
 	unsigned int max;
+
+	const struct max17x0x_reg *tag[MAX17X0X_TAG_COUNT];
+	int reg16[MAX17X0X_TAG_COUNT];
 };
 
+/* holes in the tables are zero-filled, i.e. an empty GBMS_ATOM_TYPE_MAP */
+static inline void max17x0x_regtags_init(struct max17x0x_regtags *tags,
+					 const struct max17x0x_reg *map,
+					 unsigned int max)
+{
+	int i;
+
+	tags->map = map;
+	tags->max = max;
+
+	for (i = 0; i < MAX17X0X_TAG_COUNT; i++) {
+		const struct max17x0x_reg *reg = i < max ? &map[i] : NULL;
+
+		if (reg && reg->type == GBMS_ATOM_TYPE_MAP && !reg->size)
+			reg = NULL;
+
+		tags->tag[i] = reg;
+		tags->reg16[i] = reg && reg->type == GBMS_ATOM_TYPE_REG ?
+				 reg->reg : -1;
+	}
+}
+
 struct max17x0x_regmap {
 	struct regmap *regmap;
 	struct max17x0x_regtags regtags;
@@ -266,6 +389,26 @@ enum max1720x_drift_algo_version {
 #define max1720x_check_drift_delay(dd) \
 		((dd)->algo_ver == MAX1720X_DA_VER_MWA1 ? 351 : 0)
 
+/*
+ * Outlier rule: the field selected by mask in reg must stay in [min, max],
+ * the field is clamped to the range when outside. Rules come from DT
+ * (maxim,outlier-rules) and from the rcomp0/tempco drift limits.
+ */
+#define MAX1720X_OUTLIER_RULES_MAX	16
+
+/* MW A1: rcomp0 < 0x100 is scaled by 16 before checking the range */
+#define MAX1720X_OUTLIER_F_MWA1		(1 << 0)
+
+struct max1720x_outlier_rule {
+	u8 reg;
+	u8 flags;
+	u16 mask;
+	u16 clr;	/* bits cleared in reg when the rule triggers */
+	u16 min;
+	u16 max;
+	u32 count;	/* times the rule triggered */
+};
+
 /* fix to capacity estimation */
 struct max1720x_drift_data {
 	u16 rsense;
@@ -278,6 +421,11 @@ struct max1720x_drift_data {
 	int ini_rcomp0;
 	int ini_tempco;
 	int ini_filtercfg;
+
+	/* DT rules first, drift limits are rebuilt on every check */
+	struct max1720x_outlier_rule rules[MAX1720X_OUTLIER_RULES_MAX];
+	int nb_dt_rules;
+	int nb_rules;
 };
 
 struct max1720x_dyn_filtercfg {
@@ -291,12 +439,17 @@ struct max1720x_dyn_filtercfg {
 };
 
 extern int max1720x_fixup_comp(struct max1720x_drift_data *ddata,
-			       struct max17x0x_regmap *map,
-			       int plugged);
+			       struct max17x0x_regmap *map);
 extern int max1720x_fixup_dxacc(struct max1720x_drift_data *ddata,
 				struct max17x0x_regmap *map,
 				int cycle_count,
 				int plugged,
 				int lsb);
+extern int max1720x_outliers_init(struct max1720x_drift_data *ddata,
+				  struct device_node *node);
+extern int max1720x_fixup_outliers(struct max1720x_drift_data *ddata,
+				   struct max17x0x_regmap *map, bool drift);
+extern int max1720x_outliers_cstr(char *buff, int size,
+				  const struct max1720x_drift_data *ddata);
 
 #endif
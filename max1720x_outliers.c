@@ -7,6 +7,7 @@
 
 #include <linux/err.h>
 #include <linux/i2c.h>
+#include <linux/of.h>
 #include <linux/pm_runtime.h>
 #include <linux/regmap.h>
 #include <linux/time.h>
@@ -39,24 +40,27 @@ enum {
 	MAX17X0X_VFSOC		= 0xFF,
 };
 
-/* 1 = success, 0 compare error, < 0 error */
+/* write count consecutive registers, 1 = success, 0 compare error, < 0 error */
 static int max1720x_update_compare(struct max17x0x_regmap *map, int reg,
-				   u16 data0, u16 data1)
+				   const u16 *data, int count)
 {
-	u16 data[2] = {data0, data1};
+	u16 temp[MAX1720X_OUTLIER_RULES_MAX];
 	int ret;
 
-	ret = regmap_raw_write(map->regmap, reg, data, sizeof(data));
+	if (count > ARRAY_SIZE(temp))
+		return -EINVAL;
+
+	ret = regmap_raw_write(map->regmap, reg, data, count * sizeof(*data));
 	if (ret < 0)
 		return -EIO;
 
 	msleep(2);
 
-	ret = regmap_raw_read(map->regmap, reg, data, sizeof(data));
+	ret = regmap_raw_read(map->regmap, reg, temp, count * sizeof(*data));
 	if (ret < 0)
 		return -EIO;
 
-	return (data[0] == data0) && (data[1] == data1);
+	return memcmp(temp, data, count * sizeof(*data)) == 0;
 }
 
 /* 0 not updated, 1 updated, doesn't return IO errors */
@@ -212,7 +216,9 @@ int max1720x_fixup_dxacc(struct max1720x_drift_data *ddata,
 
 	/* 3 loops suggested from vendor */
 	for (loops = 0; loops < 3; loops++) {
-		err = max1720x_update_compare(map, MAX17X0X_DQACC, dqacc, dpacc);
+		const u16 data[2] = { dqacc, dpacc };
+
+		err = max1720x_update_compare(map, MAX17X0X_DQACC, data, 2);
 		if (err == -EIO || err > 0)
 			break;
 
@@ -240,142 +246,315 @@ int max1720x_fixup_dxacc(struct max1720x_drift_data *ddata,
 #define MAXIM_TEMPCO_LIM_HI	140
 #define MAXIM_TEMPCO_LIM_LO	70
 
-static u8 comp_check(int value, int scale, int lim_low, int lim_high)
+static void max1720x_outlier_rule_set(struct max1720x_outlier_rule *rule,
+				      u8 reg, u16 mask, u16 clr, int lim_low,
+				      int lim_high, u8 flags)
 {
-	if ((value * scale) < lim_low) {
-		value = lim_low / scale;
-	} else if ((value * scale) > lim_high) {
-		value = lim_high / scale;
-		if (value > 0xff)
-			value = 0xff;
+	const int scale = 100;
+	const int fmax = mask >> __ffs(mask);
+
+	rule->reg = reg;
+	rule->flags = flags;
+	rule->mask = mask;
+	rule->clr = clr;
+	rule->max = min(lim_high / scale, fmax);
+	rule->min = min(lim_low / scale, rule->max);
+}
+
+/*
+ * Rebuild the rcomp0 and tempco limits from the values in the model, these
+ * might change after a model load. Counters are kept across rebuilds.
+ * NOTE: rcomp0 high byte must be 0 when not in MW A1+
+ */
+static void max1720x_outliers_drift_rules(struct max1720x_drift_data *ddata)
+{
+	struct max1720x_outlier_rule *rule = &ddata->rules[ddata->nb_dt_rules];
+	const int ini_tc_lob = ddata->ini_tempco & 0xff;
+	const int ini_tc_hib = (ddata->ini_tempco >> 8) & 0xff;
+
+	ddata->nb_rules = ddata->nb_dt_rules;
+	if (ddata->ini_rcomp0 == -1 || ddata->ini_tempco == -1 ||
+	    ALGO_VER_CHECK(ddata->algo_ver))
+		return;
+
+	if (ddata->algo_ver == MAX1720X_DA_VER_ORIG) {
+		const int ini_rcomp0_lob = ddata->ini_rcomp0 & 0xff;
+
+		max1720x_outlier_rule_set(rule++, MAX17X0X_RCOMP0, 0x00ff, 0xff00,
+					  ini_rcomp0_lob * MAXIM_RCOMP0_LIM_LO,
+					  ini_rcomp0_lob * MAXIM_RCOMP0_LIM_HI,
+					  0);
+	} else if (ddata->algo_ver == MAX1720X_DA_VER_MWA1) {
+		max1720x_outlier_rule_set(rule++, MAX17X0X_RCOMP0, 0xffff, 0,
+					  ddata->ini_rcomp0 * MAXIM_RCOMP0_LIM_LO,
+					  ddata->ini_rcomp0 * MAXIM_RCOMP0_LIM_HI,
+					  MAX1720X_OUTLIER_F_MWA1);
 	}
 
-	return value;
+	max1720x_outlier_rule_set(rule++, MAX17X0X_TEMPCO, 0x00ff, 0,
+				  ini_tc_lob * MAXIM_TEMPCO_LIM_LO,
+				  ini_tc_lob * MAXIM_TEMPCO_LIM_HI, 0);
+	max1720x_outlier_rule_set(rule++, MAX17X0X_TEMPCO, 0xff00, 0,
+				  ini_tc_hib * MAXIM_TEMPCO_LIM_LO,
+				  ini_tc_hib * MAXIM_TEMPCO_LIM_HI, 0);
+
+	ddata->nb_rules = rule - ddata->rules;
 }
 
-/* NOT OK For MW A1+ */
-static u16 max1720x_check_rcomp0(const struct max1720x_drift_data *ddata,
-				      u16 rcomp0)
+/* true when the rule changed the value */
+static bool max1720x_outlier_rule_apply(const struct max1720x_outlier_rule *rule,
+					u16 *value)
 {
-	const int ini_rcomp0_lob = ddata->ini_rcomp0 & 0xff;
-	int rcomp0_lob = rcomp0 & 0xff;
+	const int shift = __ffs(rule->mask);
+	u16 data = *value;
+	int field, fixed;
+
+	if ((rule->flags & MAX1720X_OUTLIER_F_MWA1) && data < 0x100)
+		data = data << 4;
+
+	field = (data & rule->mask) >> shift;
+	if (field < rule->min)
+		fixed = rule->min;
+	else if (field > rule->max)
+		fixed = rule->max;
+	else
+		fixed = field;
+
+	if (fixed != field)
+		data = (data & ~(rule->mask | rule->clr)) |
+		       ((fixed << shift) & rule->mask);
+	if (data == *value)
+		return false;
+
+	pr_debug("outlier reg=%02x mask=%04x %04x->%04x min=%x max=%x\n",
+		 rule->reg, rule->mask, *value, data, rule->min, rule->max);
+
+	*value = data;
+	return true;
+}
+
+/* snapshot of the registers used in the rules, sorted by address */
+struct max1720x_outlier_snap {
+	int count;
+	u8 reg[MAX1720X_OUTLIER_RULES_MAX];
+	u16 data[MAX1720X_OUTLIER_RULES_MAX];
+	u16 fix[MAX1720X_OUTLIER_RULES_MAX];
+};
 
-	rcomp0_lob = comp_check(rcomp0_lob, 100,
-				ini_rcomp0_lob * MAXIM_RCOMP0_LIM_LO,
-				ini_rcomp0_lob * MAXIM_RCOMP0_LIM_HI);
+static int max1720x_outlier_snap_idx(const struct max1720x_outlier_snap *snap,
+				     u8 reg)
+{
+	int i;
 
-	pr_debug("rcomp0=%x rcomp0_lob=%x->%x min=%x max=%x\n",
-		 rcomp0, (rcomp0 & 0xff), rcomp0_lob,
-		 (ini_rcomp0_lob * MAXIM_RCOMP0_LIM_LO) / 100,
-		 (ini_rcomp0_lob * MAXIM_RCOMP0_LIM_HI) / 100);
+	for (i = 0; i < snap->count; i++)
+		if (snap->reg[i] == reg)
+			return i;
 
-	/* always write 0 to the high byte */
-	return rcomp0_lob & 0xff;
+	return -1;
 }
 
-/* MW A1+ */
-static u16 max1720x_check_mw_rcomp0(const struct max1720x_drift_data *ddata,
-				    u16 rcomp0)
+static void max1720x_outlier_snap_add(struct max1720x_outlier_snap *snap,
+				      u8 reg)
 {
-	const int lim_low = ddata->ini_rcomp0 * MAXIM_RCOMP0_LIM_LO;
-	const int lim_high = ddata->ini_rcomp0 * MAXIM_RCOMP0_LIM_HI;
-	const int scale = 100;
-	int value = rcomp0;
-
-	if ((value * scale) < lim_low) {
-		value = lim_low / scale;
-	} else if ((value * scale) > lim_high) {
-		value = lim_high / scale;
-		if (value > 0xffff)
-			value = 0xffff;
-	}
+	int i;
 
-	return value;
+	if (max1720x_outlier_snap_idx(snap, reg) >= 0)
+		return;
+
+	for (i = snap->count; i > 0 && snap->reg[i - 1] > reg; i--)
+		snap->reg[i] = snap->reg[i - 1];
+	snap->reg[i] = reg;
+	snap->count += 1;
 }
 
-/* 0 no changes, >0 changes */
-static bool max1720x_comp_check(u16 *new_rcomp0, u16 *new_tempco,
-				const struct max1720x_drift_data *ddata)
+/* length of the run of consecutive registers starting at idx */
+static int max1720x_outlier_snap_run(const struct max1720x_outlier_snap *snap,
+				     int idx, bool changed)
 {
-	const u16 rcomp0 = *new_rcomp0;
-	const u16 tempco = *new_tempco;
-	const int ini_tc_lob = ddata->ini_tempco & 0xff;
-	const int ini_tc_hib = (ddata->ini_tempco >> 8) & 0xff;
-	int tc_hib = (tempco >> 8) & 0xff;
-	int tc_lob = tempco & 0xff;
-	bool fix_rcomp0 = false;
+	int len = 1;
 
-	if (ddata->algo_ver == MAX1720X_DA_VER_ORIG) {
-		*new_rcomp0 = max1720x_check_rcomp0(ddata, rcomp0);
+	while (idx + len < snap->count &&
+	       snap->reg[idx + len] == snap->reg[idx] + len &&
+	       (!changed || snap->fix[idx + len] != snap->data[idx + len]))
+		len++;
 
-		fix_rcomp0 = (rcomp0 & 0xff) != *new_rcomp0;
-	} else if (ddata->algo_ver == MAX1720X_DA_VER_MWA1) {
-		if (*new_rcomp0 < 0x100)
-			*new_rcomp0 = *new_rcomp0 << 4;
-		*new_rcomp0 = max1720x_check_mw_rcomp0(ddata, *new_rcomp0);
+	return len;
+}
+
+/* consecutive registers are read with one transfer */
+static int max1720x_outlier_snap_read(struct max1720x_outlier_snap *snap,
+				      struct max17x0x_regmap *map)
+{
+	int i, len, ret;
 
-		fix_rcomp0 = rcomp0 != *new_rcomp0;
+	for (i = 0; i < snap->count; i += len) {
+		len = max1720x_outlier_snap_run(snap, i, false);
+
+		ret = regmap_raw_read(map->regmap, snap->reg[i], &snap->data[i],
+				      len * sizeof(snap->data[0]));
+		if (ret < 0)
+			return -EIO;
 	}
 
-	tc_lob = comp_check(tc_lob, 100, ini_tc_lob * MAXIM_TEMPCO_LIM_LO,
-			    ini_tc_lob * MAXIM_TEMPCO_LIM_HI);
-	tc_hib = comp_check(tc_hib, 100, ini_tc_hib * MAXIM_TEMPCO_LIM_LO,
-			    ini_tc_hib * MAXIM_TEMPCO_LIM_HI);
+	memcpy(snap->fix, snap->data, sizeof(snap->fix));
+	return 0;
+}
 
-	pr_debug("tempco=%x tempco_lob=%x->%x min=%x max=%x, tempco_hib=%x->%x min=%x max=%x\n",
-		 tempco, tempco & 0xff, tc_lob,
-		 (ini_tc_lob * MAXIM_TEMPCO_LIM_LO) / 100,
-		 (ini_tc_lob * MAXIM_TEMPCO_LIM_HI) / 100,
-		 (tempco >> 8) & 0xff, tc_hib,
-		 (ini_tc_hib * MAXIM_TEMPCO_LIM_LO) / 100,
-		 (ini_tc_hib * MAXIM_TEMPCO_LIM_HI) / 100);
+/* write the changed registers, consecutive registers in one transfer */
+static int max1720x_outlier_snap_write(struct max1720x_outlier_snap *snap,
+				       struct max17x0x_regmap *map)
+{
+	int i, len, err = 1, loops;
 
-	*new_tempco = (tc_hib << 8) | (tc_lob);
+	for (i = 0; i < snap->count; i += len) {
+		if (snap->fix[i] == snap->data[i]) {
+			len = 1;
+			continue;
+		}
 
-	/* fix for MW A1+ */
-	return fix_rcomp0 || (tempco != *new_tempco);
-}
+		len = max1720x_outlier_snap_run(snap, i, true);
 
+		/* 3 loops suggested from vendor */
+		for (loops = 0; loops < 3; loops++) {
+			err = max1720x_update_compare(map, snap->reg[i],
+						      &snap->fix[i], len);
+			if (err == -EIO || err > 0)
+				break;
 
-/* fix rcomp0 and tempco */
-int max1720x_fixup_comp(struct max1720x_drift_data *ddata,
-			struct max17x0x_regmap *map,
-			int plugged)
+			/* arbitrary delay between attempts */
+			msleep(MAX17201_FIXUP_UPDATE_DELAY_MS);
+		}
+
+		pr_info("Fix outliers reg=0x%x:0x%x->0x%x len=%d, retries=%d, (%d)\n",
+			snap->reg[i], snap->data[i], snap->fix[i], len, loops,
+			err);
+
+		if (loops == 3)
+			return -ETIMEDOUT;
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/*
+ * Evaluate the rules on one snapshot of the registers they use, write all
+ * the fixes in one write set. Drift rules are evaluated when drift is set.
+ * Returns the number of rules that triggered or < 0 on error.
+ */
+int max1720x_fixup_outliers(struct max1720x_drift_data *ddata,
+			    struct max17x0x_regmap *map, bool drift)
 {
-	u16 new_rcomp0, new_tempco, data[2] = { 0 };
-	int err, loops;
+	struct max1720x_outlier_snap snap = { 0 };
+	int i, idx, nb_rules, triggered = 0, ret;
 
-	if (ddata->ini_rcomp0 == -1 || ddata->ini_tempco == -1 ||
-	    ALGO_VER_CHECK(ddata->algo_ver))
+	if (drift)
+		max1720x_outliers_drift_rules(ddata);
+
+	nb_rules = drift ? ddata->nb_rules : ddata->nb_dt_rules;
+	if (!nb_rules)
 		return 0;
 
-	err = regmap_raw_read(map->regmap, MAX17X0X_RCOMP0, data,
-			      sizeof(data));
-	if (err < 0)
-		return -EIO;
+	for (i = 0; i < nb_rules; i++)
+		max1720x_outlier_snap_add(&snap, ddata->rules[i].reg);
 
-	new_rcomp0 = data[0];
-	new_tempco = data[1];
+	ret = max1720x_outlier_snap_read(&snap, map);
+	if (ret < 0)
+		return ret;
 
-	err = max1720x_comp_check(&new_rcomp0, &new_tempco, ddata);
-	pr_debug("rcomp0=0x%x tempco=0x%x (%d)\n", data[0], data[1], err);
-	if (err <= 0)
-		return err;
+	for (i = 0; i < nb_rules; i++) {
+		struct max1720x_outlier_rule *rule = &ddata->rules[i];
 
-	/* 3 loops suggested from vendor */
-	for (loops = 0; loops < 3; loops++) {
+		idx = max1720x_outlier_snap_idx(&snap, rule->reg);
+		if (!max1720x_outlier_rule_apply(rule, &snap.fix[idx]))
+			continue;
 
-		err = max1720x_update_compare(map, MAX17X0X_RCOMP0,
-					      new_rcomp0, new_tempco);
-		if (err == -EIO || err > 0)
-			break;
+		rule->count += 1;
+		triggered += 1;
+	}
 
-		/* arbitrary delay between attempts */
-		msleep(MAX17201_FIXUP_UPDATE_DELAY_MS);
+	if (!triggered)
+		return 0;
+
+	ret = max1720x_outlier_snap_write(&snap, map);
+	return ret < 0 ? ret : triggered;
+}
+
+/* fix rcomp0 and tempco, > 0 when fixed */
+int max1720x_fixup_comp(struct max1720x_drift_data *ddata,
+			struct max17x0x_regmap *map)
+{
+	return max1720x_fixup_outliers(ddata, map, true);
+}
+
+/* maxim,outlier-rules = <reg mask min max>, ... */
+int max1720x_outliers_init(struct max1720x_drift_data *ddata,
+			   struct device_node *node)
+{
+	/* leave room for the drift rules */
+	const int max_dt_rules = MAX1720X_OUTLIER_RULES_MAX - 3;
+	u32 data[4 * (MAX1720X_OUTLIER_RULES_MAX - 3)];
+	int i, count, ret;
+
+	ddata->nb_dt_rules = 0;
+	ddata->nb_rules = 0;
+
+	count = of_property_count_u32_elems(node, "maxim,outlier-rules");
+	if (count <= 0)
+		return 0;
+	if (count % 4 || count / 4 > max_dt_rules)
+		return -EINVAL;
+
+	ret = of_property_read_u32_array(node, "maxim,outlier-rules", data,
+					 count);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < count / 4; i++) {
+		struct max1720x_outlier_rule *rule = &ddata->rules[i];
+		const u32 *r = &data[i * 4];
+		u32 fmax;
+
+		if (r[0] > 0xff || !r[1] || r[1] > 0xffff)
+			return -EINVAL;
+
+		/* min and max are field values */
+		fmax = r[1] >> __ffs(r[1]);
+		if (r[2] > fmax)
+			return -EINVAL;
+
+		rule->reg = r[0];
+		rule->mask = r[1];
+		rule->clr = 0;
+		rule->flags = 0;
+		rule->min = r[2];
+		rule->max = min_t(u32, r[3], fmax);
+		rule->count = 0;
+
+		if (rule->min > rule->max)
+			return -EINVAL;
 	}
 
-	pr_info("Fix rcomp0=0x%x->0x%x tempco:0x%x->0x%x, retries=%d, (%d)\n",
-		data[0], new_rcomp0, data[1], new_tempco, loops, err);
+	ddata->nb_dt_rules = count / 4;
+	ddata->nb_rules = ddata->nb_dt_rules;
+	return 0;
+}
 
-	return (loops == 3) ? -ETIMEDOUT : err;
+int max1720x_outliers_cstr(char *buff, int size,
+			   const struct max1720x_drift_data *ddata)
+{
+	int i, len = 0;
+
+	for (i = 0; i < ddata->nb_rules; i++) {
+		const struct max1720x_outlier_rule *rule = &ddata->rules[i];
+
+		len += scnprintf(&buff[len], size - len,
+				 "%s%02x: mask=%04x clr=%04x min=%x max=%x flags=%x cnt=%u\n",
+				 i < ddata->nb_dt_rules ? "dt " : "drift ",
+				 rule->reg, rule->mask, rule->clr, rule->min,
+				 rule->max, rule->flags, rule->count);
+	}
+
+	return len;
 }
@@ -25,6 +25,7 @@
 #include <linux/regmap.h>
 #include <misc/gvotable.h>
 #include "gbms_power_supply.h"
+#include "google_bms.h"
 
 #ifdef CONFIG_DEBUG_FS
 # include <linux/debugfs.h>
@@ -327,44 +328,53 @@ static int max77729_is_online(struct max77729_chgr_data *data, int *online)
 }
 
 
-static int max77729_get_status(struct max77729_chgr_data *data, int *status)
+/* status from CHG_DETAILS_01 when online */
+static int max77729_dtls_to_status(uint8_t val)
 {
-	uint8_t val;
-	int online, ret;
-
-	ret = max77729_is_online(data, &online);
-	if (ret < 0 || !online) {
-		*status = POWER_SUPPLY_STATUS_DISCHARGING;
-		return 0;
-	}
-
-	ret = max77729_reg_read(data, MAX77729_CHG_DETAILS_01, &val);
-	if (ret < 0)
-		return ret;
+	int status;
 
 	switch (_details_01_chrg_dtls_get(val)) {
 		case CHGR_DTLS_DEAD_BATTERY_MODE:
 		case CHGR_DTLS_FAST_CHARGE_CONST_CURRENT_MODE:
 		case CHGR_DTLS_FAST_CHARGE_CONST_VOLTAGE_MODE:
-			*status = POWER_SUPPLY_STATUS_CHARGING;
+			status = POWER_SUPPLY_STATUS_CHARGING;
 			break;
 		case CHGR_DTLS_TOP_OFF_MODE:
 		case CHGR_DTLS_DONE_MODE:
 			/* same as POWER_SUPPLY_PROP_CHARGE_DONE */
-			*status = POWER_SUPPLY_STATUS_FULL;
+			status = POWER_SUPPLY_STATUS_FULL;
 			break;
 		case CHGR_DTLS_TIMER_FAULT_MODE:
 		case CHGR_DTLS_DETBAT_HIGH_SUSPEND_MODE:
 		case CHGR_DTLS_OFF_MODE:
 		case CHGR_DTLS_OFF_HIGH_TEMP_MODE:
 		case CHGR_DTLS_OFF_WATCHDOG_MODE:
-			*status = POWER_SUPPLY_STATUS_NOT_CHARGING;
+			status = POWER_SUPPLY_STATUS_NOT_CHARGING;
 			break;
 		default:
-			*status = POWER_SUPPLY_STATUS_UNKNOWN;
+			status = POWER_SUPPLY_STATUS_UNKNOWN;
 			break;
 	}
 
+	return status;
+}
+
+static int max77729_get_status(struct max77729_chgr_data *data, int *status)
+{
+	uint8_t val;
+	int online, ret;
+
+	ret = max77729_is_online(data, &online);
+	if (ret < 0 || !online) {
+		*status = POWER_SUPPLY_STATUS_DISCHARGING;
+		return 0;
+	}
+
+	ret = max77729_reg_read(data, MAX77729_CHG_DETAILS_01, &val);
+	if (ret < 0)
+		return ret;
+
+	*status = max77729_dtls_to_status(val);
 	return ret;
 }
 
@@ -549,22 +559,28 @@ static int max77729_set_ilim_max_ua(struct max77729_chgr_data *data, int ua)
 }
 
 
+/* CHG_CNFG_09 to ilim */
+static int max77729_cnfg_09_to_ua(struct max77729_chgr_data *data, uint8_t reg)
+{
+	const int steps = _cnfg_09_chgin_ilim_get(reg);
+
+	if (data->input_suspend)
+		return 0;
+
+	return chgr_x2y(steps, CHGIN_ILIM_25_RANGE_MIN_STEP,
+			CHGIN_ILIM_25_RANGE_MIN_UA, CHGIN_ILIM_25_RANGE_INC_UA);
+}
+
 static int max77729_get_ilim_max_ua(struct max77729_chgr_data *data, int *ua)
 {
 	uint8_t reg;
-	int ret, steps;
+	int ret;
 
 	ret = max77729_reg_read(data, MAX77729_CHG_CNFG_09, &reg);
 	if (ret < 0)
 		return ret;
 
-	steps = _cnfg_09_chgin_ilim_get(reg);
-	*ua = chgr_x2y(steps, CHGIN_ILIM_25_RANGE_MIN_STEP,
-		       CHGIN_ILIM_25_RANGE_MIN_UA, CHGIN_ILIM_25_RANGE_INC_UA);
-
-	if (data->input_suspend)
-		*ua = 0;
-
+	*ua = max77729_cnfg_09_to_ua(data, reg);
 	return 0;
 }
 
@@ -578,30 +594,35 @@ static int max77729_get_current_now_ua(struct max77729_chgr_data *data, int *ua)
 	return max77729_get_ilim_max_ua(data, ua);
 }
 
+/* CHG_CNFG_04 to charge voltage */
+static int max77729_cnfg_04_to_uv(uint8_t reg)
+{
+	const int steps = _cnfg_04_chg_cv_prm_get(reg);
+
+	if (steps >= CHG_CV_PRM_CONT_100_RANGE_MIN_STEP)
+		return chgr_x2y(steps, CHG_CV_PRM_CONT_100_RANGE_MIN_STEP,
+				CHG_CV_PRM_CONT_100_RANGE_MIN_UV,
+				CHG_CV_PRM_CONT_100_RANGE_INC_UV);
+	if (steps >= CHG_CV_PRM_CONT_10_RANGE_MIN_STEP)
+		return chgr_x2y(steps, CHG_CV_PRM_CONT_10_RANGE_MIN_STEP,
+				CHG_CV_PRM_CONT_10_RANGE_MIN_UV,
+				CHG_CV_PRM_CONT_10_RANGE_INC_UV);
+
+	return chgr_x2y(steps, CHG_CV_PRM_CONT_50_RANGE_MIN_STEP,
+			CHG_CV_PRM_CONT_50_RANGE_MIN_UV,
+			CHG_CV_PRM_CONT_50_RANGE_INC_UV);
+}
+
 static int max77729_get_charge_voltage_max_uv(struct max77729_chgr_data *data, int *uv)
 {
 	uint8_t reg;
-	int ret, steps;
+	int ret;
 
 	ret = max77729_reg_read(data, MAX77729_CHG_CNFG_04, &reg);
 	if (ret < 0)
 		return ret;
 
-	steps = _cnfg_04_chg_cv_prm_get(reg);
-	if (steps >= CHG_CV_PRM_CONT_100_RANGE_MIN_STEP) {
-		*uv = chgr_x2y(steps, CHG_CV_PRM_CONT_100_RANGE_MIN_STEP,
-				CHG_CV_PRM_CONT_100_RANGE_MIN_UV,
-				CHG_CV_PRM_CONT_100_RANGE_INC_UV);
-	} else if (steps >= CHG_CV_PRM_CONT_10_RANGE_MIN_STEP) {
-		*uv = chgr_x2y(steps, CHG_CV_PRM_CONT_10_RANGE_MIN_STEP,
-				CHG_CV_PRM_CONT_10_RANGE_MIN_UV,
-				CHG_CV_PRM_CONT_10_RANGE_INC_UV);
-	} else {
-		*uv = chgr_x2y(steps, CHG_CV_PRM_CONT_50_RANGE_MIN_STEP,
-				CHG_CV_PRM_CONT_50_RANGE_MIN_UV,
-				CHG_CV_PRM_CONT_50_RANGE_INC_UV);
-	}
-
+	*uv = max77729_cnfg_04_to_uv(reg);
 	return ret;
 }
 
@@ -726,14 +747,10 @@ static int max77729_get_charge_current_max_ua(struct max77729_chgr_data *data,
 }
 
 
-static int max77729_get_charge_type(struct max77729_chgr_data *data, int *type)
+/* charge type from CHG_DETAILS_01, -EINVAL on unknown details */
+static int max77729_dtls_to_charge_type(uint8_t reg, int *type)
 {
-	int ret;
-	uint8_t reg;
-
-	ret = max77729_reg_read(data, MAX77729_CHG_DETAILS_01, &reg);
-	if (ret < 0)
-		return ret;
+	int ret = 0;
 
 	switch(_details_01_chrg_dtls_get(reg)) {
 	case CHGR_DTLS_DEAD_BATTERY_MODE:
@@ -767,6 +784,67 @@ static int max77729_get_charge_type(struct max77729_chgr_data *data, int *type)
 	return ret;
 }
 
+static int max77729_get_charge_type(struct max77729_chgr_data *data, int *type)
+{
+	int ret;
+	uint8_t reg;
+
+	ret = max77729_reg_read(data, MAX77729_CHG_DETAILS_01, &reg);
+	if (ret < 0)
+		return ret;
+
+	return max77729_dtls_to_charge_type(reg, type);
+}
+
+#define MAX77729_CHG_STATE_FIRST	MAX77729_CHG_INT_OK
+#define MAX77729_CHG_STATE_LAST		MAX77729_CHG_CNFG_09
+#define MAX77729_CHG_STATE_REG(regs, reg) \
+	((regs)[(reg) - MAX77729_CHG_STATE_FIRST])
+
+/*
+ * Same encoding as gbms_read_charger_state() builds from STATUS,
+ * CHARGE_TYPE, VOLTAGE_NOW and CURRENT_NOW with one read of
+ * CHG_INT_OK..CHG_CNFG_09.
+ */
+static int max77729_get_chg_chgr_state(struct max77729_chgr_data *data,
+				       union gbms_charger_state *chg_state)
+{
+	uint8_t regs[MAX77729_CHG_STATE_LAST - MAX77729_CHG_STATE_FIRST + 1];
+	int ret, online, chg_type, chg_status, icl;
+	uint8_t int_ok, dtls;
+
+	ret = regmap_bulk_read(data->regmap, MAX77729_CHG_STATE_FIRST, regs,
+			       sizeof(regs));
+	if (ret < 0)
+		return ret;
+
+	dtls = MAX77729_CHG_STATE_REG(regs, MAX77729_CHG_DETAILS_01);
+	ret = max77729_dtls_to_charge_type(dtls, &chg_type);
+	if (ret < 0)
+		return ret;
+
+	/* same as max77729_is_online() */
+	int_ok = MAX77729_CHG_STATE_REG(regs, MAX77729_CHG_INT_OK);
+	online = _chg_int_ok_wcin_ok_get(int_ok) ||
+		 _chg_int_ok_chgin_ok_get(int_ok);
+	chg_status = online ? max77729_dtls_to_status(dtls) :
+		     POWER_SUPPLY_STATUS_DISCHARGING;
+
+	chg_state->v = 0;
+	chg_state->f.chg_status = chg_status;
+	chg_state->f.chg_type = chg_type;
+	chg_state->f.flags = gbms_gen_chg_flags(chg_status, chg_type);
+	chg_state->f.vchrg = max77729_cnfg_04_to_uv(
+		MAX77729_CHG_STATE_REG(regs, MAX77729_CHG_CNFG_04)) / 1000;
+
+	icl = max77729_cnfg_09_to_ua(data,
+		MAX77729_CHG_STATE_REG(regs, MAX77729_CHG_CNFG_09));
+	if (icl > 0)
+		chg_state->f.icl = icl / 1000;
+
+	return 0;
+}
+
 /* TODO: return if AICL is running  */
 static int max77729_get_current_limit(struct max77729_chgr_data *data,
 		int *limited)
@@ -797,6 +875,7 @@ static int max77729_psy_get_property(struct power_supply *psy,
 		union power_supply_propval *pval)
 {
 	struct max77729_chgr_data *data = power_supply_get_drvdata(psy);
+	union gbms_charger_state chg_state;
 	int enabled;
 	int ret;
 
@@ -844,9 +923,11 @@ static int max77729_psy_get_property(struct power_supply *psy,
 								 &pval->intval);
 			break;
 
-		/* TODO: implement charger state, fix *_PROP_VOLTAGE_MAX */
+		/* TODO: fix *_PROP_VOLTAGE_MAX */
 		case GBMS_PROP_CHARGE_CHARGER_STATE:
-			ret = -EINVAL;
+			ret = max77729_get_chg_chgr_state(data, &chg_state);
+			if (ret == 0)
+				gbms_propval_int64val(pval) = chg_state.v;
 			break;
 
 		case GBMS_PROP_TAPER_CONTROL:
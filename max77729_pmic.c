@@ -1077,39 +1077,104 @@ static void max77729_gpio_bus_lock(struct irq_data *d)
 	mutex_lock(&data->irq_lock);
 }
 
+/* switch all the GPIOs in pending to input with one MAXQ read and write */
+static int max77729_gpio_bus_irq_update_dir(struct max77729_pmic_data *data,
+					    u8 pending)
+{
+	uint8_t val, new_val;
+	int ret;
+
+	ret = maxq_gpio_control_read(data->maxq, &val);
+	if (ret < 0) {
+		dev_err(data->dev, "opcode read 0x23 failed\n");
+		return ret;
+	}
+
+	new_val = val;
+	if (pending & (1 << MAX77759_GPIO5_OFF)) {
+		new_val &= ~MAX77759_GPIO5_DIR_MASK;
+		new_val |= MAX77759_GPIO5_DIR(MAX77759_GPIO_DIR_IN);
+	}
+	if (pending & (1 << MAX77759_GPIO6_OFF)) {
+		new_val &= ~MAX77759_GPIO6_DIR_MASK;
+		new_val |= MAX77759_GPIO6_DIR(MAX77759_GPIO_DIR_IN);
+	}
+
+	if (new_val == val)
+		return 0;
+
+	ret = maxq_gpio_control_write(data->maxq, new_val);
+	if (ret < 0)
+		dev_err(data->dev, "opcode write 0x24 failed\n");
+
+	return ret;
+}
+
+/* pending is a bitmask of offsets, trigger bits are gpio5 bit 0, gpio6 bit 1 */
 static int max77729_gpio_bus_irq_update_trig(struct max77729_pmic_data *data,
-					     int offset, int trig)
+					     u8 pending)
 {
+	u8 mask = 0, trig = 0;
+	unsigned int offset;
 	int ret;
 
-	/* direction works with offset, trigger works with gpio number */
-	ret = max77759_gpio_direction_input(&data->gpio, offset);
-	if (ret == 0)
-		ret = 	maxq_gpio_trigger_write(data->maxq, offset + 1, trig);
+	ret = max77729_gpio_bus_irq_update_dir(data, pending);
+	if (ret < 0)
+		return ret;
+
+	for (offset = MAX77759_GPIO5_OFF; offset <= MAX77759_GPIO6_OFF; offset++) {
+		const int index = offset - MAX77759_GPIO5_OFF;
+
+		if (!(pending & (1 << offset)))
+			continue;
+
+		mask |= 1 << index;
+		if (data->irq_trig_falling[index])
+			trig |= 1 << index;
+	}
 
-	pr_debug("gpio%d: trig=%d (%d)\n", offset + 1, trig, ret);
+	ret = maxq_gpio_trigger_update(data->maxq, mask, trig);
+
+	pr_debug("gpio: pending=%x mask=%x trig=%x (%d)\n", pending, mask,
+		 trig, ret);
 
 	return ret;
 }
 
+/* one read-modify-write of UIC_INT1_M for all the pending mask changes */
 static int max77729_gpio_bus_irq_update_mask(struct max77729_pmic_data *data,
-					     int offset, int value)
+					     u8 pending)
 {
-	unsigned int mask = 0, val = 0;
+	unsigned int mask = 0, val = 0, offset;
 	int ret;
 
-	ret = max77729_gpio_to_irq_mask(offset, &mask, &val);
-	if (ret == 0)
-		ret = max77729_pmic_rmw8(data, MAX77759_PMIC_UIC_INT1_M, mask,
-					 value ? val : 0);
+	for (offset = MAX77759_GPIO5_OFF; offset <= MAX77759_GPIO6_OFF; offset++) {
+		unsigned int bit_mask, bit_val;
+
+		if (!(pending & (1 << offset)))
+			continue;
+
+		ret = max77729_gpio_to_irq_mask(offset, &bit_mask, &bit_val);
+		if (ret < 0)
+			continue;
+
+		mask |= bit_mask;
+		if (data->irq_mask & (1 << offset))
+			val |= bit_val;
+	}
+
+	if (!mask)
+		return 0;
+
+	ret = max77729_pmic_rmw8(data, MAX77759_PMIC_UIC_INT1_M, mask, val);
 	if (ret < 0) {
-		dev_err(data->dev, "gpio%d: cannot change mask=%x to %x (%d)\n",
-			offset + 1, mask, value ? val : 0, ret);
+		dev_err(data->dev, "gpio: cannot change mask=%x to %x (%d)\n",
+			mask, val, ret);
 		return ret;
 	}
 
-	pr_debug("gpio%d: value=%d mask=%x, val=%x (%d)\n",
-		 offset +1, value, mask, val, ret);
+	pr_debug("gpio: pending=%x mask=%x, val=%x (%d)\n",
+		 pending, mask, val, ret);
 
 	return 0;
 }
@@ -1119,22 +1184,15 @@ static void max77729_gpio_bus_sync_unlock(struct irq_data *d)
 {
 	struct gpio_chip *gc = irq_data_get_irq_chip_data(d);
 	struct max77729_pmic_data *data = gpiochip_get_data(gc);
-	unsigned int offset, value;
 
-	while (data->irq_trig_u) {
-		offset = __ffs(data->irq_trig_u);
-		value = data->irq_trig_falling[offset - MAX77759_GPIO5_OFF];
-
-		max77729_gpio_bus_irq_update_trig(data, offset, value);
-		data->irq_trig_u &= ~(1 << offset);
+	if (data->irq_trig_u) {
+		max77729_gpio_bus_irq_update_trig(data, data->irq_trig_u);
+		data->irq_trig_u = 0;
 	}
 
-	while (data->irq_mask_u) {
-		offset = __ffs(data->irq_mask_u);
-		value = data->irq_mask & (1 << offset);
-
-		max77729_gpio_bus_irq_update_mask(data, offset, value);
-		data->irq_mask_u &= ~(1 << offset);
+	if (data->irq_mask_u) {
+		max77729_gpio_bus_irq_update_mask(data, data->irq_mask_u);
+		data->irq_mask_u = 0;
 	}
 
 	mutex_unlock(&data->irq_lock);
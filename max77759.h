@@ -23,6 +23,7 @@
 #include "max77759_regs.h"
 
 #define MAX77759_CHG_INT_COUNT 2
+#define MAX77759_CHG_NR_IRQS (MAX77759_CHG_INT_COUNT * 8)
 
 #define MAX77759_PMIC_REV_A0		0x01
 #define MAX77759_PMIC_REV_A1		0x02
@@ -18,6 +18,8 @@
 #include <linux/ctype.h>
 #include <linux/i2c.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
@@ -262,6 +264,9 @@ int max77759_chg_reg_write(struct i2c_client *client, u8 reg, u8 value)
 	if (!data || !data->regmap)
 		return -ENODEV;
 
+	if (reg == MAX77759_CHG_CNFG_00)
+		return max77759_chg_cnfg_00_update(data, 0xff, value);
+
 	return max77759_reg_write(data->regmap, reg, value);
 }
 EXPORT_SYMBOL_GPL(max77759_chg_reg_write);
@@ -293,6 +298,9 @@ int max77759_chg_reg_update(struct i2c_client *client,
 	if (!data || !data->regmap)
 		return -ENODEV;
 
+	if (reg == MAX77759_CHG_CNFG_00)
+		return max77759_chg_cnfg_00_update(data, mask, value);
+
 	return regmap_write_bits(data->regmap, reg, mask, value);
 }
 EXPORT_SYMBOL_GPL(max77759_chg_reg_update);
@@ -309,9 +317,8 @@ int max77759_chg_mode_write(struct i2c_client *client,
 	if (!data || !data->regmap)
 		return -ENODEV;
 
-	return regmap_write_bits(data->regmap, MAX77759_CHG_CNFG_00,
-				 MAX77759_CHG_CNFG_00_MODE_MASK,
-				 mode);
+	return max77759_chg_cnfg_00_update(data, MAX77759_CHG_CNFG_00_MODE_MASK,
+					   mode);
 }
 EXPORT_SYMBOL_GPL(max77759_chg_mode_write);
 
@@ -1049,8 +1056,8 @@ static int max77759_mode_callback(struct gvotable_election *el,
 		goto unlock_done;
 	}
 
-	/* no caching */
-	ret = max77759_reg_read(data->regmap, MAX77759_CHG_CNFG_00, &reg);
+	/* no caching, resync the shadow */
+	ret = max77759_chg_cnfg_00_read(data, &reg, true);
 	if (ret < 0) {
 		dev_err(data->dev, "cannot read CNFG_00 (%d)\n", ret);
 		goto unlock_done;
@@ -1254,7 +1261,7 @@ static int max77759_enable_sw_recharge(struct max77759_chgr_data *data,
 	}
 
 	/* This: will not trigger the usecase state machine */
-	ret = max77759_reg_read(data->regmap, MAX77759_CHG_CNFG_00, &reg);
+	ret = max77759_chg_cnfg_00_read(data, &reg, false);
 	if (ret == 0)
 		ret = max77759_chg_mode_write(uc_data->client, MAX77759_CHGR_MODE_ALL_OFF);
 	if (ret == 0)
@@ -1713,7 +1720,7 @@ static bool max77759_current_check_mode(struct max77759_chgr_data *data)
 	int ret;
 	u8 reg;
 
-	ret = max77759_reg_read(data->regmap, MAX77759_CHG_CNFG_00, &reg);
+	ret = max77759_chg_cnfg_00_read(data, &reg, false);
 	if (ret < 0)
 		return false;
 
@@ -1952,19 +1959,10 @@ static int max77759_is_online(struct max77759_chgr_data *data)
 	       _chg_details_02_wcin_sts_get(val));
 }
 
-static int max77759_get_charge_type(struct max77759_chgr_data *data)
+/* charge type from CHG_DETAILS_01 when online */
+static int max77759_dtls_to_charge_type(uint8_t dtls)
 {
-	int ret;
-	uint8_t reg;
-
-	if (!max77759_is_online(data))
-		return POWER_SUPPLY_CHARGE_TYPE_NONE;
-
-	ret = max77759_reg_read(data->regmap, MAX77759_CHG_DETAILS_01, &reg);
-	if (ret < 0)
-		return POWER_SUPPLY_CHARGE_TYPE_UNKNOWN;
-
-	switch(_chg_details_01_chg_dtls_get(reg)) {
+	switch(_chg_details_01_chg_dtls_get(dtls)) {
 	case CHGR_DTLS_DEAD_BATTERY_MODE:
 		return POWER_SUPPLY_CHARGE_TYPE_TRICKLE;
 	case CHGR_DTLS_FAST_CHARGE_CONST_CURRENT_MODE:
@@ -1987,6 +1985,21 @@ static int max77759_get_charge_type(struct max77759_chgr_data *data)
 	return POWER_SUPPLY_CHARGE_TYPE_UNKNOWN;
 }
 
+static int max77759_get_charge_type(struct max77759_chgr_data *data)
+{
+	int ret;
+	uint8_t reg;
+
+	if (!max77759_is_online(data))
+		return POWER_SUPPLY_CHARGE_TYPE_NONE;
+
+	ret = max77759_reg_read(data->regmap, MAX77759_CHG_DETAILS_01, &reg);
+	if (ret < 0)
+		return POWER_SUPPLY_CHARGE_TYPE_UNKNOWN;
+
+	return max77759_dtls_to_charge_type(reg);
+}
+
 static bool max77759_is_full(struct max77759_chgr_data *data)
 {
 	int vlimit = data->chg_term_voltage;
@@ -2008,23 +2021,15 @@ static bool max77759_is_full(struct max77759_chgr_data *data)
 	return vbatt >= vlimit;
 }
 
-static int max77759_get_status(struct max77759_chgr_data *data)
+/*
+ * status from CHG_DETAILS_01 when online.
+ * EOC can be made sticky returning POWER_SUPPLY_STATUS_FULL on
+ * ->charge_done. Also need a check on max77759_is_full() or
+ * google_charger will fail to restart charging.
+ */
+static int max77759_dtls_to_status(struct max77759_chgr_data *data,
+				   uint8_t val)
 {
-	uint8_t val;
-	int ret;
-
-	if (!max77759_is_online(data))
-		return POWER_SUPPLY_STATUS_DISCHARGING;
-
-	/*
-	 * EOC can be made sticky returning POWER_SUPPLY_STATUS_FULL on
-	 * ->charge_done. Also need a check on max77759_is_full() or
-	 * google_charger will fail to restart charging.
-	 */
-	ret = max77759_reg_read(data->regmap, MAX77759_CHG_DETAILS_01, &val);
-	if (ret < 0)
-		return POWER_SUPPLY_STATUS_UNKNOWN;
-
 	switch (_chg_details_01_chg_dtls_get(val)) {
 		case CHGR_DTLS_DEAD_BATTERY_MODE:
 		case CHGR_DTLS_FAST_CHARGE_CONST_CURRENT_MODE:
@@ -2051,25 +2056,43 @@ static int max77759_get_status(struct max77759_chgr_data *data)
 	return POWER_SUPPLY_STATUS_UNKNOWN;
 }
 
+static int max77759_get_status(struct max77759_chgr_data *data)
+{
+	uint8_t val;
+	int ret;
+
+	if (!max77759_is_online(data))
+		return POWER_SUPPLY_STATUS_DISCHARGING;
+
+	ret = max77759_reg_read(data->regmap, MAX77759_CHG_DETAILS_01, &val);
+	if (ret < 0)
+		return POWER_SUPPLY_STATUS_UNKNOWN;
+
+	return max77759_dtls_to_status(data, val);
+}
+
+/*
+ * Same encoding as gbms_read_charger_state() builds from STATUS,
+ * CHARGE_TYPE and VOLTAGE_NOW but status, type, presence and input
+ * limit come from a single read of CHG_INT_OK..CHG_DETAILS_02.
+ */
 static int max77759_get_chg_chgr_state(struct max77759_chgr_data *data,
 				       union gbms_charger_state *chg_state)
 {
 	int usb_present, usb_valid, dc_present, dc_valid;
 	const char *source = "";
+	uint8_t regs[4]; /* INT_OK, DETAILS_00, DETAILS_01, DETAILS_02 */
 	uint8_t int_ok, dtls;
 	int vbatt, icl = 0;
 	int rc;
 
-	chg_state->v = 0;
-	chg_state->f.chg_status = max77759_get_status(data);
-	chg_state->f.chg_type = max77759_get_charge_type(data);
-	chg_state->f.flags = gbms_gen_chg_flags(chg_state->f.chg_status,
-						chg_state->f.chg_type);
+	rc = max77759_readn(data->regmap, MAX77759_CHG_INT_OK, regs,
+			    sizeof(regs));
+	if (rc < 0)
+		memset(regs, 0, sizeof(regs));
 
-	rc = max77759_reg_read(data->regmap, MAX77759_CHG_INT_OK, &int_ok);
-	if (rc == 0)
-		rc = max77759_reg_read(data->regmap, MAX77759_CHG_DETAILS_02,
-					&dtls);
+	int_ok = regs[MAX77759_CHG_INT_OK - MAX77759_CHG_INT_OK];
+	dtls = regs[MAX77759_CHG_DETAILS_02 - MAX77759_CHG_INT_OK];
 
 	/* present when connected, valid when FET is closed */
 	usb_present = (rc == 0) && _chg_int_ok_chgin_ok_get(int_ok);
@@ -2079,6 +2102,21 @@ static int max77759_get_chg_chgr_state(struct max77759_chgr_data *data,
 	dc_present = (rc == 0) && _chg_int_ok_wcin_ok_get(int_ok);
 	dc_valid = dc_present && _chg_details_02_wcin_sts_get(dtls);
 
+	/* same as max77759_is_online() */
+	chg_state->v = 0;
+	if ((usb_present || dc_present) &&
+	    (_chg_details_02_chgin_sts_get(dtls) ||
+	     _chg_details_02_wcin_sts_get(dtls))) {
+		dtls = regs[MAX77759_CHG_DETAILS_01 - MAX77759_CHG_INT_OK];
+		chg_state->f.chg_status = max77759_dtls_to_status(data, dtls);
+		chg_state->f.chg_type = max77759_dtls_to_charge_type(dtls);
+	} else {
+		chg_state->f.chg_status = POWER_SUPPLY_STATUS_DISCHARGING;
+		chg_state->f.chg_type = POWER_SUPPLY_CHARGE_TYPE_NONE;
+	}
+	chg_state->f.flags = gbms_gen_chg_flags(chg_state->f.chg_status,
+						chg_state->f.chg_type);
+
 	rc = max77759_read_vbatt(data, &vbatt);
 	if (rc == 0)
 		chg_state->f.vchrg = vbatt / 1000;
@@ -2086,8 +2124,7 @@ static int max77759_get_chg_chgr_state(struct max77759_chgr_data *data,
 	if (chg_state->f.chg_status == POWER_SUPPLY_STATUS_DISCHARGING)
 		goto exit_done;
 
-	rc = max77759_is_limited(data);
-	if (rc > 0)
+	if (_chg_int_ok_inlim_ok_get(int_ok) == 0)
 		chg_state->f.flags |= GBMS_CS_FLAG_ILIM;
 
 	/* TODO: b/ handle input MUX corner cases */
@@ -2148,37 +2185,82 @@ static int max77759_chgin_current_now(struct max77759_chgr_data *data, int *iic)
 	return 0;
 }
 
+#define MAX77759_WDT_PERIOD_MS	80000
+
+/* single write of the shadow with WDTCLR set, WDTCLR self clears */
 static int max77759_wd_tickle(struct max77759_chgr_data *data)
 {
-	int ret;
-	u8 reg, reg_new;
+	const ktime_t now = ktime_get();
+	unsigned int val;
+	s64 margin;
+	int ret = 0;
 
-	mutex_lock(&data->io_lock);
-	ret = max77759_reg_read(data->regmap, MAX77759_CHG_CNFG_00, &reg);
-	if (ret == 0) {
-		reg_new  = _chg_cnfg_00_wdtclr_set(reg, 0x1);
-		ret = max77759_reg_write(data->regmap, MAX77759_CHG_CNFG_00,
-					 reg_new);
+	mutex_lock(&data->cnfg_00_lock);
+	if (!data->cnfg_00_ok) {
+		ret = regmap_read(data->regmap, MAX77759_CHG_CNFG_00, &val);
+		data->cnfg_00_ok = ret == 0;
+		if (ret == 0)
+			data->cnfg_00 = val & MAX77759_CHG_CNFG_00_WDTCLR_CLEAR;
 	}
 
-	if (ret < 0)
+	if (ret == 0)
+		ret = max77759_reg_write(data->regmap, MAX77759_CHG_CNFG_00,
+					 _chg_cnfg_00_wdtclr_set(data->cnfg_00, 0x1));
+	if (ret < 0) {
+		data->wd_tickle_err += 1;
 		pr_err("WD Tickle failed %d\n", ret);
+	} else {
+		if (data->wd_last) {
+			margin = data->wd_period_ms -
+				 ktime_ms_delta(now, data->wd_last);
+			if (margin < data->wd_margin_min_ms)
+				data->wd_margin_min_ms = margin;
+		}
 
-	mutex_unlock(&data->io_lock);
+		data->wd_last = now;
+		data->wd_tickles += 1;
+	}
+
+	mutex_unlock(&data->cnfg_00_lock);
 	return ret;
 }
 
-/* online is used from DC charging to tickle the watchdog (if enabled) */
+static void max77759_wd_work(struct work_struct *work)
+{
+	struct max77759_chgr_data *data =
+		container_of(work, struct max77759_chgr_data, wd_work);
+
+	/* the timer keeps running, will retry on the next period */
+	if (max77759_resume_check(data))
+		return;
+
+	max77759_wd_tickle(data);
+}
+
+/* tickle twice per WDT period, the work runs on the highpri workqueue */
+static enum hrtimer_restart max77759_wd_timer(struct hrtimer *timer)
+{
+	struct max77759_chgr_data *data =
+		container_of(timer, struct max77759_chgr_data, wd_timer);
+
+	queue_work(system_highpri_wq, &data->wd_work);
+	hrtimer_forward_now(timer, ms_to_ktime(data->wd_period_ms / 2));
+	return HRTIMER_RESTART;
+}
+
+static void max77759_wd_start(struct max77759_chgr_data *data)
+{
+	data->wd_margin_min_ms = data->wd_period_ms;
+	max77759_wd_tickle(data);
+	hrtimer_start(&data->wd_timer, ms_to_ktime(data->wd_period_ms / 2),
+		      HRTIMER_MODE_REL);
+}
+
+/* online is used from DC charging, the watchdog is tickled by wd_timer */
 static int max77759_set_online(struct max77759_chgr_data *data, bool online)
 {
 	int ret = 0;
 
-	if (data->wden) {
-		ret = max77759_wd_tickle(data);
-		if (ret < 0)
-			pr_err("cannot tickle the watchdog\n");
-	}
-
 	if (data->online != online) {
 		ret = gvotable_cast_long_vote(data->mode_votable, "OFFLINE",
 					      GBMS_CHGR_MODE_STBY_ON, !online);
@@ -2248,10 +2330,6 @@ static int max77759_psy_set_property(struct power_supply *psy,
 		break;
 	}
 
-	if (ret == 0 && data->wden)
-		max77759_wd_tickle(data);
-
-
 	return ret;
 }
 
@@ -2620,11 +2698,39 @@ static int max77759_chg_debug_reg_write(void *d, u64 val)
 		return -EAGAIN;
 
 	pr_warn("debug write reg 0x%x, 0x%x", data->debug_reg_address, reg);
+	if (data->debug_reg_address == MAX77759_CHG_CNFG_00)
+		return max77759_chg_cnfg_00_update(data, 0xff, reg);
+
 	return max77759_reg_write(data->regmap, data->debug_reg_address, reg);
 }
 DEFINE_SIMPLE_ATTRIBUTE(debug_reg_rw_fops, max77759_chg_debug_reg_read,
 			max77759_chg_debug_reg_write, "%02llx\n");
 
+/* worst observed margin to WDT expiry, write anything to reset */
+static int wd_margin_min_ms_get(void *d, u64 *val)
+{
+	struct max77759_chgr_data *data = d;
+
+	mutex_lock(&data->cnfg_00_lock);
+	*val = data->wd_margin_min_ms;
+	mutex_unlock(&data->cnfg_00_lock);
+
+	return 0;
+}
+
+static int wd_margin_min_ms_set(void *d, u64 val)
+{
+	struct max77759_chgr_data *data = d;
+
+	mutex_lock(&data->cnfg_00_lock);
+	data->wd_margin_min_ms = data->wd_period_ms;
+	mutex_unlock(&data->cnfg_00_lock);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(wd_margin_min_ms_fops, wd_margin_min_ms_get,
+			wd_margin_min_ms_set, "%lld\n");
+
 
 static ssize_t max77759_chg_show_reg_all(struct file *filp, char __user *buf,
 					size_t count, loff_t *ppos)
@@ -2693,6 +2799,15 @@ static int dbg_init_fs(struct max77759_chgr_data *data)
 	debugfs_create_file("chg_restart", 0600, data->de, data,
 			    &charger_restart_fops);
 
+	/* watchdog */
+	debugfs_create_bool("wden", 0444, data->de, &data->wden);
+	debugfs_create_u32("wd_period_ms", 0444, data->de, &data->wd_period_ms);
+	debugfs_create_u32("wd_tickles", 0444, data->de, &data->wd_tickles);
+	debugfs_create_u32("wd_tickle_err", 0444, data->de,
+			   &data->wd_tickle_err);
+	debugfs_create_file("wd_margin_min_ms", 0600, data->de, data,
+			    &wd_margin_min_ms_fops);
+
 	debugfs_create_u32("address", 0600, data->de, &data->debug_reg_address);
 	debugfs_create_file("data", 0600, data->de, data, &debug_reg_rw_fops);
 	/* dump all registers */
@@ -2787,6 +2902,157 @@ static u8 max77759_int_mask[MAX77759_CHG_INT_COUNT] = {
 	  MAX77759_CHG_INT2_MASK_CHG_STA_DONE_M),
 };
 
+/*
+ * CHG_INT is exposed as a nested interrupt controller: hwirq is the bit
+ * position in CHG_INT (0..7) and CHG_INT2 (8..15). Consumers request the
+ * virtual IRQ from devicetree (#interrupt-cells = <1>). The handlers run
+ * nested in the charger irq thread after the single read/clear of CHG_INT.
+ * CHG_INT_MASK unmasks the sources used by this driver and the sources
+ * enabled by the consumers: mask/unmask update the cache and the register
+ * is written (I2C) from irq_bus_sync_unlock().
+ */
+static void max77759_chgr_irq_mask(struct irq_data *d)
+{
+	struct max77759_chgr_data *data = irq_data_get_irq_chip_data(d);
+	const irq_hw_number_t hwirq = irqd_to_hwirq(d);
+
+	data->irq_unmasked[hwirq / 8] &= ~BIT(hwirq % 8);
+}
+
+static void max77759_chgr_irq_unmask(struct irq_data *d)
+{
+	struct max77759_chgr_data *data = irq_data_get_irq_chip_data(d);
+	const irq_hw_number_t hwirq = irqd_to_hwirq(d);
+
+	data->irq_unmasked[hwirq / 8] |= BIT(hwirq % 8);
+}
+
+static void max77759_chgr_irq_bus_lock(struct irq_data *d)
+{
+	struct max77759_chgr_data *data = irq_data_get_irq_chip_data(d);
+
+	mutex_lock(&data->irq_lock);
+}
+
+/* call holding irq_lock */
+static int max77759_chgr_irq_mask_sync(struct max77759_chgr_data *data,
+				       bool force)
+{
+	u8 int_mask[MAX77759_CHG_INT_COUNT];
+	int i, ret;
+
+	for (i = 0; i < MAX77759_CHG_INT_COUNT; i++)
+		int_mask[i] = max77759_int_mask[i] & ~data->irq_unmasked[i];
+
+	if (!force && memcmp(int_mask, data->int_mask, sizeof(int_mask)) == 0)
+		return 0;
+
+	ret = max77759_writen(data->regmap, MAX77759_CHG_INT_MASK, int_mask,
+			      sizeof(int_mask));
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < MAX77759_CHG_INT_COUNT; i++)
+		WRITE_ONCE(data->int_mask[i], int_mask[i]);
+
+	return 0;
+}
+
+static void max77759_chgr_irq_bus_sync_unlock(struct irq_data *d)
+{
+	struct max77759_chgr_data *data = irq_data_get_irq_chip_data(d);
+	int ret;
+
+	ret = max77759_chgr_irq_mask_sync(data, false);
+	if (ret < 0)
+		dev_err(data->dev, "cannot set irq_mask (%d)\n", ret);
+
+	mutex_unlock(&data->irq_lock);
+}
+
+static struct irq_chip max77759_chgr_irq_chip = {
+	.name = "max77759_chgr",
+	.irq_mask = max77759_chgr_irq_mask,
+	.irq_unmask = max77759_chgr_irq_unmask,
+	.irq_bus_lock = max77759_chgr_irq_bus_lock,
+	.irq_bus_sync_unlock = max77759_chgr_irq_bus_sync_unlock,
+};
+
+static int max77759_chgr_irq_map(struct irq_domain *d, unsigned int virq,
+				 irq_hw_number_t hw)
+{
+	struct max77759_chgr_data *data = d->host_data;
+
+	irq_set_chip_data(virq, data);
+	irq_set_chip_and_handler(virq, &max77759_chgr_irq_chip,
+				 handle_simple_irq);
+	irq_set_nested_thread(virq, 1);
+	irq_set_noprobe(virq);
+	return 0;
+}
+
+static void max77759_chgr_irq_unmap(struct irq_domain *d, unsigned int virq)
+{
+	irq_set_nested_thread(virq, 0);
+	irq_set_chip_and_handler(virq, NULL, NULL);
+	irq_set_chip_data(virq, NULL);
+}
+
+static const struct irq_domain_ops max77759_chgr_irq_domain_ops = {
+	.map = max77759_chgr_irq_map,
+	.unmap = max77759_chgr_irq_unmap,
+	.xlate = irq_domain_xlate_onecell,
+};
+
+/* run the nested handlers of the unmasked (requested) interrupts in @pending */
+static void max77759_chgr_irq_nested(struct max77759_chgr_data *data,
+				     int index, u8 pending)
+{
+	unsigned long bits = pending & READ_ONCE(data->irq_unmasked[index]);
+	int bit;
+
+	if (!data->irq_domain)
+		return;
+
+	for_each_set_bit(bit, &bits, 8) {
+		const unsigned int virq =
+			irq_find_mapping(data->irq_domain, index * 8 + bit);
+
+		if (virq)
+			handle_nested_irq(virq);
+	}
+}
+
+static int max77759_chgr_irq_domain_init(struct max77759_chgr_data *data)
+{
+	data->irq_domain = irq_domain_add_linear(data->dev->of_node,
+						 MAX77759_CHG_NR_IRQS,
+						 &max77759_chgr_irq_domain_ops,
+						 data);
+	if (!data->irq_domain)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void max77759_chgr_irq_domain_remove(struct max77759_chgr_data *data)
+{
+	int hwirq;
+
+	if (!data->irq_domain)
+		return;
+
+	for (hwirq = 0; hwirq < MAX77759_CHG_NR_IRQS; hwirq++)
+		irq_dispose_mapping(irq_find_mapping(data->irq_domain, hwirq));
+
+	irq_domain_remove(data->irq_domain);
+	data->irq_domain = NULL;
+}
+
+#define MAX77759_CHG_INT2_BROWNOUT (MAX77759_CHG_INT2_SYS_UVLO1_I | \
+				    MAX77759_CHG_INT2_SYS_UVLO2_I | \
+				    MAX77759_CHG_INT2_BAT_OILO_I)
+
 static irqreturn_t max77759_chgr_irq(int irq, void *client)
 {
 	struct max77759_chgr_data *data = client;
@@ -2807,8 +3073,8 @@ static irqreturn_t max77759_chgr_irq(int irq, void *client)
 	if (ret < 0)
 		return IRQ_NONE;
 
-	if ((chg_int[0] & ~max77759_int_mask[0]) == 0 &&
-	    (chg_int[1] & ~max77759_int_mask[1]) == 0)
+	if ((chg_int[0] & ~READ_ONCE(data->int_mask[0])) == 0 &&
+	    (chg_int[1] & ~READ_ONCE(data->int_mask[1])) == 0)
 		return IRQ_NONE;
 
 	ret = max77759_writen(data->regmap, MAX77759_CHG_INT, chg_int,
@@ -2818,25 +3084,11 @@ static irqreturn_t max77759_chgr_irq(int irq, void *client)
 
 	pr_debug("INT : %02x %02x\n", chg_int[0], chg_int[1]);
 
-	/* always broadcast battery events */
-	broadcast = chg_int[0] & MAX77759_CHG_INT_MASK_BAT_M;
-
-	if (chg_int[1] & MAX77759_CHG_INT2_MASK_INSEL_M) {
-
-		if (data->insel_clear)
-			ret = max77759_chgr_input_mask_clear(data);
-
-		pr_debug("%s: INSEL insel_auto_clear=%d (%d)\n", __func__,
-			 data->insel_clear, data->insel_clear ? ret : 0);
-		atomic_inc(&data->insel_cnt);
-
-		ret = max77759_higher_headroom_enable(data, false); /* reset on plug/unplug */
-		if (ret)
-			return IRQ_NONE;
-	}
-
+	/*
+	 * Brown-out first: BCL and the UVLO consumers must not wait behind
+	 * the I2C traffic and the power supply broadcast below.
+	 */
 #if IS_ENABLED(CONFIG_GOOGLE_BCL)
-	/* TODO: make this an interrupt controller */
 	if (chg_int[1] & MAX77759_CHG_INT2_SYS_UVLO1_I) {
 		pr_debug("%s: SYS_UVLO1\n", __func__);
 
@@ -2859,6 +3111,26 @@ static irqreturn_t max77759_chgr_irq(int irq, void *client)
 	}
 #endif
 
+	max77759_chgr_irq_nested(data, 1, chg_int[1] &
+				 MAX77759_CHG_INT2_BROWNOUT);
+
+	/* always broadcast battery events */
+	broadcast = chg_int[0] & MAX77759_CHG_INT_MASK_BAT_M;
+
+	if (chg_int[1] & MAX77759_CHG_INT2_MASK_INSEL_M) {
+
+		if (data->insel_clear)
+			ret = max77759_chgr_input_mask_clear(data);
+
+		pr_debug("%s: INSEL insel_auto_clear=%d (%d)\n", __func__,
+			 data->insel_clear, data->insel_clear ? ret : 0);
+		atomic_inc(&data->insel_cnt);
+
+		ret = max77759_higher_headroom_enable(data, false); /* reset on plug/unplug */
+		if (ret)
+			return IRQ_NONE;
+	}
+
 	if (chg_int[1] & MAX77759_CHG_INT2_MASK_CHG_STA_TO_M) {
 		pr_debug("%s: TOP_OFF\n", __func__);
 
@@ -2944,6 +3216,10 @@ static irqreturn_t max77759_chgr_irq(int irq, void *client)
 		}
 	}
 
+	max77759_chgr_irq_nested(data, 0, chg_int[0]);
+	max77759_chgr_irq_nested(data, 1, chg_int[1] &
+				 ~MAX77759_CHG_INT2_BROWNOUT);
+
 	/* someting is changed */
 	if (data->psy && broadcast)
 		power_supply_changed(data->psy);
@@ -3110,8 +3386,19 @@ static int max77759_charger_probe(struct i2c_client *client,
 	data->dev = dev;
 	data->regmap = regmap;
 	data->fship_dtls = -1;
-	data->wden = false; /* TODO: read from DT */
+	data->wden = of_property_read_bool(dev->of_node, "max77759,wdt-enable");
 	mutex_init(&data->io_lock);
+	mutex_init(&data->cnfg_00_lock);
+	mutex_init(&data->irq_lock);
+	memcpy(data->int_mask, max77759_int_mask, sizeof(data->int_mask));
+
+	ret = of_property_read_u32(dev->of_node, "max77759,wdt-period-ms",
+				   &data->wd_period_ms);
+	if (ret < 0)
+		data->wd_period_ms = MAX77759_WDT_PERIOD_MS;
+	hrtimer_init(&data->wd_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	data->wd_timer.function = max77759_wd_timer;
+	INIT_WORK(&data->wd_work, max77759_wd_work);
 	atomic_set(&data->insel_cnt, 0);
 	atomic_set(&data->early_topoff_cnt, 0);
 	i2c_set_clientdata(client, data);
@@ -3160,6 +3447,11 @@ static int max77759_charger_probe(struct i2c_client *client,
 	} else {
 		client->irq = gpio_to_irq(data->irq_gpio);
 
+		/* consumers can request the CHG_INT sources as nested irqs */
+		ret = max77759_chgr_irq_domain_init(data);
+		if (ret < 0)
+			dev_warn(dev, "cannot create irq domain (%d)\n", ret);
+
 		ret = devm_request_threaded_irq(data->dev, client->irq, NULL,
 						max77759_chgr_irq,
 						IRQF_TRIGGER_LOW |
@@ -3172,9 +3464,9 @@ static int max77759_charger_probe(struct i2c_client *client,
 
 			/* might cause the isr to be called */
 			max77759_chgr_irq(-1, data);
-			ret = max77759_writen(regmap, MAX77759_CHG_INT_MASK,
-					      max77759_int_mask,
-					      sizeof(max77759_int_mask));
+			mutex_lock(&data->irq_lock);
+			ret = max77759_chgr_irq_mask_sync(data, true);
+			mutex_unlock(&data->irq_lock);
 			if (ret < 0)
 				dev_err(dev, "cannot set irq_mask (%d)\n", ret);
 
@@ -3191,6 +3483,8 @@ static int max77759_charger_probe(struct i2c_client *client,
 	ret = max77759_wdt_enable(data, data->wden);
 	if (ret < 0)
 		dev_err(dev, "wd enable=%d failed %d\n", data->wden, ret);
+	else if (data->wden)
+		max77759_wd_start(data);
 
 	/* disable fast charge safety timer */
 	max77759_chg_reg_update(data->uc_data.client, MAX77759_CHG_CNFG_01,
@@ -3286,6 +3580,11 @@ static int max77759_charger_remove(struct i2c_client *client)
 
 	if (data->de)
 		debugfs_remove(data->de);
+	hrtimer_cancel(&data->wd_timer);
+	cancel_work_sync(&data->wd_work);
+	if (data->irq_int)
+		devm_free_irq(data->dev, data->irq_int, data);
+	max77759_chgr_irq_domain_remove(data);
 	wakeup_source_unregister(data->usecase_wake_lock);
 	wakeup_source_unregister(data->otg_fccm_wake_lock);
 
@@ -4,6 +4,10 @@
  *
  */
 
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/regmap.h>
+#include <linux/workqueue.h>
 #include <soc/google/bcl.h>
 #include "gs101_usecase.h"
 
@@ -35,6 +39,11 @@ struct max77759_chgr_data {
 	int irq_gpio;
 	int irq_int;
 	bool irq_disabled;
+	struct irq_domain *irq_domain;	/* CHG_INT, CHG_INT2 */
+	/* irq_bus_lock, protects irq_unmasked and the CHG_INT_MASK write */
+	struct mutex irq_lock;
+	u8 irq_unmasked[MAX77759_CHG_INT_COUNT];	/* by the nested irqs */
+	u8 int_mask[MAX77759_CHG_INT_COUNT];		/* in CHG_INT_MASK */
 
 	struct i2c_client *fg_i2c_client;
 	struct i2c_client *pmic_i2c_client;
@@ -55,6 +64,20 @@ struct max77759_chgr_data {
 	bool online;
 	bool wden;
 
+	/* CHG_CNFG_00 shadow, see max77759_chg_cnfg_00_update() */
+	struct mutex cnfg_00_lock;
+	bool cnfg_00_ok;
+	u8 cnfg_00;
+
+	/* watchdog tickle, scheduled relative to the WDT period */
+	struct hrtimer wd_timer;
+	struct work_struct wd_work;
+	u32 wd_period_ms;
+	ktime_t wd_last;
+	u32 wd_tickles;
+	u32 wd_tickle_err;
+	s64 wd_margin_min_ms;
+
 	/* Force to change FCCM mode during OTG at high battery voltage */
 	bool otg_changed;
 	bool otg_fccm_reset;
@@ -77,4 +100,60 @@ struct max77759_chgr_data {
 	int chg_term_voltage;
 	int chg_term_volt_debounce;
 };
+
+/*
+ * CHG_CNFG_00 is written from the mode election, the usecase transitions
+ * (gs101_usecase.c, a different module) and the watchdog tickle. The shadow
+ * never holds WDTCLR so the tickle can be a single write of the shadow.
+ * Call with refresh set to resync with the hardware.
+ */
+static inline int max77759_chg_cnfg_00_read(struct max77759_chgr_data *data,
+					    u8 *value, bool refresh)
+{
+	unsigned int val;
+	int ret = 0;
+
+	mutex_lock(&data->cnfg_00_lock);
+	if (refresh || !data->cnfg_00_ok) {
+		ret = regmap_read(data->regmap, MAX77759_CHG_CNFG_00, &val);
+		data->cnfg_00_ok = ret == 0;
+		if (ret == 0)
+			data->cnfg_00 = val & MAX77759_CHG_CNFG_00_WDTCLR_CLEAR;
+	}
+
+	if (ret == 0)
+		*value = data->cnfg_00;
+	mutex_unlock(&data->cnfg_00_lock);
+
+	return ret;
+}
+
+static inline int max77759_chg_cnfg_00_update(struct max77759_chgr_data *data,
+					      u8 mask, u8 value)
+{
+	unsigned int val;
+	int ret = 0;
+	u8 reg;
+
+	mutex_lock(&data->cnfg_00_lock);
+	if (!data->cnfg_00_ok) {
+		ret = regmap_read(data->regmap, MAX77759_CHG_CNFG_00, &val);
+		if (ret < 0)
+			goto unlock_done;
+		data->cnfg_00 = val & MAX77759_CHG_CNFG_00_WDTCLR_CLEAR;
+	}
+
+	reg = (data->cnfg_00 & ~mask) | (value & mask);
+	reg &= MAX77759_CHG_CNFG_00_WDTCLR_CLEAR;
+
+	ret = regmap_write(data->regmap, MAX77759_CHG_CNFG_00, reg);
+	if (ret == 0)
+		data->cnfg_00 = reg;
+
+unlock_done:
+	data->cnfg_00_ok = ret == 0;
+	mutex_unlock(&data->cnfg_00_lock);
+	return ret;
+}
+
 #endif
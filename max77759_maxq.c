@@ -549,37 +549,42 @@ int maxq_gpio_trigger_read(struct max77759_maxq *maxq, u8 gpio, bool *trigger_fa
 }
 EXPORT_SYMBOL_GPL(maxq_gpio_trigger_read);
 
-int maxq_gpio_trigger_write(struct max77759_maxq *maxq, u8 gpio, bool trigger_falling)
+/*
+ * Update the trigger of the GPIOs in mask (MAX_GPIO5_TRIG_MASK and/or
+ * MAX_GPIO6_TRIG_MASK) with one write, the current trigger is read only
+ * when a GPIO is not in mask.
+ */
+int maxq_gpio_trigger_update(struct max77759_maxq *maxq, u8 mask, u8 trigger)
 {
-	int ret;
+	const u8 all = MAX_GPIO5_TRIG_MASK | MAX_GPIO6_TRIG_MASK;
 	u8 request[OPCODE_GPIO_TRIGGER_W_REQ_LEN], response[OPCODE_GPIO_TRIGGER_W_RES_LEN];
-	u8 trigger_val;
-	bool trigger_falling_other;
-
-	/* Only GPIO5 and GPIO6 supported */
-	if (gpio != 5 && gpio != 6) {
-		logbuffer_log(maxq->log, "MAXQ gpio trigger read invalid gpio %d", gpio);
-		return -EINVAL;
-	}
+	u8 trigger_val = 0;
+	int ret;
 
-	/* Read the other GPIO */
-	ret = maxq_gpio_trigger_read(maxq, gpio == 5 ? 6 : 5, &trigger_falling_other);
-	if (ret < 0)
-		return ret;
+	mask &= all;
+	if (!mask)
+		return 0;
+
+	if (mask != all) {
+		u8 read_request = OPCODE_GPIO_TRIGGER_READ;
+		u8 read_response[OPCODE_GPIO_TRIGGER_R_RES_LEN];
+
+		logbuffer_log(maxq->log, "MAXQ gpio trigger read opcode:%#x",
+			      read_request);
+		ret = maxq_issue_opcode_command(maxq, &read_request,
+						OPCODE_GPIO_TRIGGER_R_REQ_LEN,
+						read_response,
+						OPCODE_GPIO_TRIGGER_R_RES_LEN);
+		if (ret < 0) {
+			logbuffer_log(maxq->log, "MAXQ GPIO TRIGGER read failed");
+			return ret;
+		}
 
-	/* Compose trigger write val */
-	if (gpio == 5) {
-		trigger_val = MAX_GPIO6_TRIG(trigger_falling_other ? MAX_GPIO_TRIG_FALLING :
-					     MAX_GPIO_TRIG_RISING);
-		trigger_val |= MAX_GPIO5_TRIG(trigger_falling ? MAX_GPIO_TRIG_FALLING :
-					      MAX_GPIO_TRIG_RISING);
-	} else {
-		trigger_val = MAX_GPIO5_TRIG(trigger_falling_other ? MAX_GPIO_TRIG_FALLING :
-					     MAX_GPIO_TRIG_RISING);
-		trigger_val |= MAX_GPIO6_TRIG(trigger_falling ? MAX_GPIO_TRIG_FALLING :
-					      MAX_GPIO_TRIG_RISING);
+		trigger_val = read_response[OPCODE_GPIO_TRIGGER_R_RES_OFFSET];
 	}
 
+	trigger_val = (trigger_val & all & ~mask) | (trigger & mask);
+
 	request[REQUEST_OPCODE] = OPCODE_GPIO_TRIGGER_WRITE;
 	request[OPCODE_GPIO_TRIGGER_W_REQ_OFFSET] = trigger_val;
 	logbuffer_log(maxq->log, "MAXQ gpio trigger write opcode:%#x val:%#x",
@@ -592,6 +597,26 @@ int maxq_gpio_trigger_write(struct max77759_maxq *maxq, u8 gpio, bool trigger_fa
 
 	return ret;
 }
+EXPORT_SYMBOL_GPL(maxq_gpio_trigger_update);
+
+int maxq_gpio_trigger_write(struct max77759_maxq *maxq, u8 gpio, bool trigger_falling)
+{
+	const u8 trig = trigger_falling ? MAX_GPIO_TRIG_FALLING :
+					  MAX_GPIO_TRIG_RISING;
+
+	/* Only GPIO5 and GPIO6 supported */
+	if (gpio != 5 && gpio != 6) {
+		logbuffer_log(maxq->log, "MAXQ gpio trigger read invalid gpio %d", gpio);
+		return -EINVAL;
+	}
+
+	if (gpio == 5)
+		return maxq_gpio_trigger_update(maxq, MAX_GPIO5_TRIG_MASK,
+						MAX_GPIO5_TRIG(trig));
+
+	return maxq_gpio_trigger_update(maxq, MAX_GPIO6_TRIG_MASK,
+					MAX_GPIO6_TRIG(trig));
+}
 EXPORT_SYMBOL_GPL(maxq_gpio_trigger_write);
 
 struct max77759_maxq *maxq_init(struct device *dev, struct regmap *regmap,
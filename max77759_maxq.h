@@ -24,6 +24,7 @@ extern int maxq_gpio_control_read(struct max77759_maxq *maxq, u8 *gpio);
 extern int maxq_gpio_control_write(struct max77759_maxq *maxq, u8 gpio);
 extern int maxq_gpio_trigger_read(struct max77759_maxq *maxq, u8 gpio, bool *trigger_falling);
 extern int maxq_gpio_trigger_write(struct max77759_maxq *maxq, u8 gpio, bool trigger_falling);
+extern int maxq_gpio_trigger_update(struct max77759_maxq *maxq, u8 mask, u8 trigger);
 # else
 static inline int maxq_gpio_trigger_read(struct max77759_maxq *maxq, u8 gpio, bool *trigger_falling)
 {
@@ -35,6 +36,12 @@ static inline int maxq_gpio_trigger_write(struct max77759_maxq *maxq, u8 gpio,
 {
 	return -EINVAL;
 }
+
+static inline int maxq_gpio_trigger_update(struct max77759_maxq *maxq, u8 mask,
+					   u8 trigger)
+{
+	return -EINVAL;
+}
 static inline struct max77759_maxq *maxq_init(struct device *dev,
 					      struct regmap *regmap,
 					      bool poll)
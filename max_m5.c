@@ -255,6 +255,56 @@ static int max_m5_update_custom_model(struct max_m5_data *m5_data)
 	return 0;
 }
 
+/*
+ * Write the learned state (qresidual, rcomp0, tempco) with one bulk write,
+ * then verify all and rewrite only the registers that didn't stick.
+ */
+static int max_m5_write_state_regs(struct max_m5_data *m5_data)
+{
+	const struct max_m5_custom_parameters *cp = &m5_data->parameters;
+	struct max17x0x_regmap *regmap = m5_data->regmap;
+	struct reg_sequence seq[] = {
+		{ MAX_M5_QRTABLE00, cp->qresidual00 },
+		{ MAX_M5_QRTABLE10, cp->qresidual10 },
+		{ MAX_M5_QRTABLE20, cp->qresidual20 },
+		{ MAX_M5_QRTABLE30, cp->qresidual30 },
+		{ MAX_M5_RCOMP0, cp->rcomp0 },
+		{ MAX_M5_TEMPCO, cp->tempco },
+	};
+	int i, count = ARRAY_SIZE(seq), retries, ret;
+	unsigned int data;
+
+	for (retries = 3; retries > 0 && count > 0; retries--) {
+		int failed = 0;
+
+		ret = regmap_multi_reg_write(regmap->regmap, seq, count);
+		for (i = 0; i < count; i++)
+			max17x0x_reglog_log(regmap->reglog, seq[i].reg,
+					    seq[i].def, ret);
+		if (ret < 0)
+			continue;
+
+		usleep_range(WAIT_VERIFY, WAIT_VERIFY + 100);
+
+		/* keep the registers that need another write */
+		for (i = 0; i < count; i++) {
+			ret = regmap_read(regmap->regmap, seq[i].reg, &data);
+			if (ret < 0 || data != seq[i].def)
+				seq[failed++] = seq[i];
+		}
+
+		count = failed;
+	}
+
+	if (count) {
+		dev_err(m5_data->dev, "cannot write state, %d left (reg=%02x)\n",
+			count, seq[0].reg);
+		return -EIO;
+	}
+
+	return 0;
+}
+
 /* Step 7: Write custom parameters */
 static int max_m5_update_custom_parameters(struct max_m5_data *m5_data)
 {
@@ -308,21 +358,7 @@ static int max_m5_update_custom_parameters(struct max_m5_data *m5_data)
 	if (ret == 0)
 		ret = REGMAP_WRITE(regmap, MAX_M5_VEMPTY, cp->v_empty);
 	if (ret == 0)
-		ret = REGMAP_WRITE_VERIFY(regmap, MAX_M5_QRTABLE00,
-					  cp->qresidual00);
-	if (ret == 0)
-		ret = REGMAP_WRITE_VERIFY(regmap, MAX_M5_QRTABLE10,
-					  cp->qresidual10);
-	if (ret == 0)
-		ret = REGMAP_WRITE_VERIFY(regmap, MAX_M5_QRTABLE20,
-					  cp->qresidual20);
-	if (ret == 0)
-		ret = REGMAP_WRITE_VERIFY(regmap, MAX_M5_QRTABLE30,
-					  cp->qresidual30);
-	if (ret == 0)
-		ret = REGMAP_WRITE_VERIFY(regmap, MAX_M5_RCOMP0, cp->rcomp0);
-	if (ret == 0)
-		ret = REGMAP_WRITE_VERIFY(regmap, MAX_M5_TEMPCO, cp->tempco);
+		ret = max_m5_write_state_regs(m5_data);
 	if (ret == 0)
 		ret = REGMAP_WRITE(regmap, MAX_M5_TASKPERIOD, cp->taskperiod);
 	if (ret == 0)
@@ -418,6 +454,8 @@ int max_m5_reset_state_data(struct max_m5_data *m5_data)
 	ret = gbms_storage_write(GBMS_TAG_GMSR, &data, sizeof(data));
 	if (ret < 0)
 		dev_warn(m5_data->dev, "Erase GMSR fail (%d)\n", ret);
+	else
+		m5_data->model_save = data;
 
 	return ret;
 }
@@ -707,6 +745,71 @@ static u8 max_m5_data_crc(char *reason, struct model_state_save *state)
 	return crc;
 }
 
+static void max_m5_state_to_params(struct max_m5_data *m5_data,
+				   const struct model_state_save *state)
+{
+	struct max_m5_custom_parameters *cp = &m5_data->parameters;
+
+	cp->rcomp0 = state->rcomp0;
+	cp->tempco = state->tempco;
+	cp->fullcaprep = state->fullcaprep;
+	cp->fullcapnom = state->fullcapnom;
+	cp->qresidual00 = state->qresidual00;
+	cp->qresidual10 = state->qresidual10;
+	cp->qresidual20 = state->qresidual20;
+	cp->qresidual30 = state->qresidual30;
+	/* b/278492168 restore dpacc with fullcapnom for taskperiod=351ms */
+	if (cp->taskperiod == 0x2d00 && cp->dpacc == 0x3200)
+		cp->dqacc = cp->fullcapnom >> 2;
+	else if (cp->taskperiod == 0x2d00 && cp->dpacc == 0x0c80)
+		cp->dqacc = cp->fullcapnom >> 4;
+	else
+		dev_warn(m5_data->dev, "taskperiod:%#x, dpacc:%#x, dqacc:%#x\n",
+			 cp->taskperiod, cp->dpacc, cp->dqacc);
+
+	m5_data->cycles = state->cycles;
+	m5_data->cv_mixcap = state->cv_mixcap;
+	m5_data->halftime = state->halftime;
+}
+
+/* state record from the current parameters, crc is not computed */
+static void max_m5_params_to_state(const struct max_m5_data *m5_data,
+				   struct model_state_save *state)
+{
+	const struct max_m5_custom_parameters *cp = &m5_data->parameters;
+
+	state->rcomp0 = cp->rcomp0;
+	state->tempco = cp->tempco;
+	state->fullcaprep = cp->fullcaprep;
+	state->fullcapnom = cp->fullcapnom;
+	state->qresidual00 = cp->qresidual00;
+	state->qresidual10 = cp->qresidual10;
+	state->qresidual20 = cp->qresidual20;
+	state->qresidual30 = cp->qresidual30;
+
+	state->cycles = m5_data->cycles;
+	state->cv_mixcap = m5_data->cv_mixcap;
+	state->halftime = m5_data->halftime;
+}
+
+/* bit N set when the Nth u16 word of the record differs, crc excluded */
+static u16 max_m5_state_dirty(const struct model_state_save *a,
+			      const struct model_state_save *b)
+{
+	const int count = offsetof(struct model_state_save, crc) / sizeof(u16);
+	u16 dirty = 0, wa, wb;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		memcpy(&wa, (const u8 *)a + i * sizeof(u16), sizeof(u16));
+		memcpy(&wb, (const u8 *)b + i * sizeof(u16), sizeof(u16));
+		if (wa != wb)
+			dirty |= 1 << i;
+	}
+
+	return dirty;
+}
+
 /*
  * Load parameters and model state from permanent storage.
  * Called on boot after POR
@@ -736,36 +839,41 @@ int max_m5_load_state_data(struct max_m5_data *m5_data)
 	if (crc != m5_data->model_save.crc)
 		return -EINVAL;
 
-	cp->rcomp0 = m5_data->model_save.rcomp0;
-	cp->tempco = m5_data->model_save.tempco;
-	cp->fullcaprep = m5_data->model_save.fullcaprep;
-	cp->fullcapnom = m5_data->model_save.fullcapnom;
-	cp->qresidual00 = m5_data->model_save.qresidual00;
-	cp->qresidual10 = m5_data->model_save.qresidual10;
-	cp->qresidual20 = m5_data->model_save.qresidual20;
-	cp->qresidual30 = m5_data->model_save.qresidual30;
-	/* b/278492168 restore dpacc with fullcapnom for taskperiod=351ms */
-	if (cp->taskperiod == 0x2d00 && cp->dpacc == 0x3200)
-		cp->dqacc = cp->fullcapnom >> 2;
-	else if (cp->taskperiod == 0x2d00 && cp->dpacc == 0x0c80)
-		cp->dqacc = cp->fullcapnom >> 4;
-	else
-		dev_warn(m5_data->dev, "taskperiod:%#x, dpacc:%#x, dqacc:%#x\n",
-			 cp->taskperiod, cp->dpacc, cp->dqacc);
-
-	m5_data->cycles = m5_data->model_save.cycles;
-	m5_data->cv_mixcap = m5_data->model_save.cv_mixcap;
-	m5_data->halftime = m5_data->model_save.halftime;
-
+	max_m5_state_to_params(m5_data, &m5_data->model_save);
 	return 0;
 }
 
-/* save/commit parameters and model state to permanent storage */
+/*
+ * true when the learned parameters differ from the last saved (or restored)
+ * state. Cycles are not a learned parameter: they are restored from the
+ * cycle count history after loading the model.
+ */
+bool max_m5_model_state_changed(const struct max_m5_data *m5_data)
+{
+	const struct max_m5_custom_parameters *cp = &m5_data->parameters;
+	const struct model_state_save *ms = &m5_data->model_save;
+
+	return ms->rcomp0 != cp->rcomp0 ||
+	       ms->tempco != cp->tempco ||
+	       ms->fullcaprep != cp->fullcaprep ||
+	       ms->fullcapnom != cp->fullcapnom ||
+	       ms->qresidual00 != cp->qresidual00 ||
+	       ms->qresidual10 != cp->qresidual10 ||
+	       ms->qresidual20 != cp->qresidual20 ||
+	       ms->qresidual30 != cp->qresidual30 ||
+	       ms->cv_mixcap != m5_data->cv_mixcap ||
+	       ms->halftime != m5_data->halftime;
+}
+
+/*
+ * save/commit parameters and model state to permanent storage. Only the
+ * words that changed since the last save (or restore) are dirty, the save
+ * is skipped when nothing changed.
+ */
 int max_m5_save_state_data(struct max_m5_data *m5_data)
 {
-	struct max_m5_custom_parameters *cp = &m5_data->parameters;
-	struct model_state_save rb;
-	u16 learncfg;
+	struct model_state_save next, rb;
+	u16 learncfg, dirty;
 	int ret = 0;
 
 	/* Do not save when in RC1 stage b/213425610 */
@@ -776,29 +884,19 @@ int max_m5_save_state_data(struct max_m5_data *m5_data)
 	if ((learncfg & MAX_M5_LEARNCFG_RC_VER) == MAX_M5_LEARNCFG_RC1)
 		return -ENOSYS;
 
-	m5_data->model_save.rcomp0 = cp->rcomp0;
-	m5_data->model_save.tempco = cp->tempco;
-	m5_data->model_save.fullcaprep = cp->fullcaprep;
-	m5_data->model_save.fullcapnom = cp->fullcapnom;
-	m5_data->model_save.qresidual00 = cp->qresidual00;
-	m5_data->model_save.qresidual10 = cp->qresidual10;
-	m5_data->model_save.qresidual20 = cp->qresidual20;
-	m5_data->model_save.qresidual30 = cp->qresidual30;
-
-	m5_data->model_save.cycles = m5_data->cycles;
-	m5_data->model_save.cv_mixcap = m5_data->cv_mixcap;
-	m5_data->model_save.halftime = m5_data->halftime;
-
-	m5_data->model_save.crc = max_m5_data_crc("save",
-				  &m5_data->model_save);
-
-	ret = gbms_storage_write(GBMS_TAG_GMSR,
-				 (const void *)&m5_data->model_save,
-				 sizeof(m5_data->model_save));
+	max_m5_params_to_state(m5_data, &next);
+	dirty = max_m5_state_dirty(&next, &m5_data->model_save);
+	if (!dirty)
+		return 0;
+
+	next.crc = max_m5_data_crc("save", &next);
+
+	ret = gbms_storage_write(GBMS_TAG_GMSR, (const void *)&next,
+				 sizeof(next));
 	if (ret < 0)
 		return ret;
 
-	if (ret != sizeof(m5_data->model_save))
+	if (ret != sizeof(next))
 		return -ERANGE;
 
 	/* Read back to make sure data all good */
@@ -808,20 +906,11 @@ int max_m5_save_state_data(struct max_m5_data *m5_data)
 		return ret;
 	}
 
-	if (rb.rcomp0 != m5_data->model_save.rcomp0 ||
-	    rb.tempco != m5_data->model_save.tempco ||
-	    rb.fullcaprep != m5_data->model_save.fullcaprep ||
-	    rb.fullcapnom != m5_data->model_save.fullcapnom ||
-	    rb.qresidual00 != m5_data->model_save.qresidual00 ||
-	    rb.qresidual10 != m5_data->model_save.qresidual10 ||
-	    rb.qresidual20 != m5_data->model_save.qresidual20 ||
-	    rb.qresidual30 != m5_data->model_save.qresidual30 ||
-	    rb.cycles != m5_data->model_save.cycles ||
-	    rb.cv_mixcap != m5_data->model_save.cv_mixcap ||
-	    rb.halftime != m5_data->model_save.halftime ||
-	    rb.crc != m5_data->model_save.crc)
+	if (max_m5_state_dirty(&rb, &next) || rb.crc != next.crc)
 		return -EINVAL;
 
+	dev_dbg(m5_data->dev, "GMSR saved dirty=%#x\n", dirty);
+	m5_data->model_save = next;
 	return 0;
 }
 
@@ -955,6 +1044,59 @@ ssize_t max_m5_gmsr_state_cstr(char *buf, int max)
 	return len;
 }
 
+/* binary model state: header, state (same format as GMSR), crc8 of all */
+ssize_t max_m5_model_state_bin(void *buf, size_t max,
+			       struct max_m5_data *m5_data)
+{
+	struct max_m5_state_bin *bin = buf;
+
+	if (max < sizeof(*bin))
+		return -ENOMEM;
+
+	bin->magic = MAX_M5_STATE_BIN_MAGIC;
+	bin->version = MAX_M5_STATE_BIN_VERSION;
+	bin->size = sizeof(bin->state);
+	max_m5_params_to_state(m5_data, &bin->state);
+	bin->state.crc = max_m5_data_crc("export", &bin->state);
+	bin->crc = max_m5_crc((u8 *)bin, offsetof(struct max_m5_state_bin, crc),
+			      CRC8_INIT_VALUE);
+
+	return sizeof(*bin);
+}
+
+/* validate and restore a binary model state, 0 on success */
+int max_m5_model_state_bin_load(struct max_m5_data *m5_data, const void *buf,
+				size_t count)
+{
+	const struct max_m5_state_bin *bin = buf;
+	struct model_state_save state;
+	u8 crc;
+	int ret;
+
+	if (count != sizeof(*bin))
+		return -EINVAL;
+	if (bin->magic != MAX_M5_STATE_BIN_MAGIC ||
+	    bin->version != MAX_M5_STATE_BIN_VERSION ||
+	    bin->size != sizeof(bin->state))
+		return -EINVAL;
+
+	crc = max_m5_crc((u8 *)bin, offsetof(struct max_m5_state_bin, crc),
+			 CRC8_INIT_VALUE);
+	if (crc != bin->crc)
+		return -EBADMSG;
+
+	state = bin->state;
+	if (max_m5_data_crc("import", &state) != state.crc)
+		return -EBADMSG;
+
+	ret = max_m5_check_state_data(&state, &m5_data->parameters);
+	if (ret < 0)
+		return ret;
+
+	max_m5_state_to_params(m5_data, &state);
+	return 0;
+}
+
 /* can be use to restore parametes and model state after POR */
 int max_m5_model_state_sscan(struct max_m5_data *m5_data, const char *buf,
 			     int max)
@@ -1313,8 +1455,7 @@ int max_m5_regmap_init(struct max17x0x_regmap *regmap, struct i2c_client *clnt)
 	if (IS_ERR(map))
 		return IS_ERR_VALUE(map);
 
-	regmap->regtags.max = ARRAY_SIZE(max_m5);
-	regmap->regtags.map = max_m5;
+	max17x0x_regtags_init(&regmap->regtags, max_m5, ARRAY_SIZE(max_m5));
 	regmap->regmap = map;
 	return 0;
 }
@@ -103,6 +103,18 @@ struct model_state_save {
 	u8 crc;
 } __attribute__((packed));
 
+/* binary export/import of the model state (debugfs) */
+#define MAX_M5_STATE_BIN_MAGIC		0x52534d47	/* GMSR */
+#define MAX_M5_STATE_BIN_VERSION	1
+
+struct max_m5_state_bin {
+	u32 magic;
+	u16 version;
+	u16 size;	/* of state */
+	struct model_state_save state;
+	u8 crc;		/* crc8 of the fields above */
+} __attribute__((packed));
+
 struct max_m5_data {
 	struct device *dev;
 	struct max17x0x_regmap *regmap;
@@ -179,6 +191,7 @@ void max_m5_free_data(void *data);
 
 int max_m5_load_state_data(struct max_m5_data *m5_data);
 int max_m5_save_state_data(struct max_m5_data *m5_data);
+bool max_m5_model_state_changed(const struct max_m5_data *m5_data);
 
 /* read state from the gauge */
 int max_m5_model_read_state(struct max_m5_data *m5_data);
@@ -192,6 +205,10 @@ int max_m5_fixup_outliers(struct max1720x_drift_data *ddata,
 
 ssize_t max_m5_model_state_cstr(char *buf, int max,
 				struct max_m5_data *m5_data);
+ssize_t max_m5_model_state_bin(void *buf, size_t max,
+			       struct max_m5_data *m5_data);
+int max_m5_model_state_bin_load(struct max_m5_data *m5_data, const void *buf,
+				size_t count);
 int max_m5_model_state_sscan(struct max_m5_data *m5_data, const char *buf,
 			     int max);
 int max_m5_fg_model_sscan(struct max_m5_data *m5_data, const char *buf,
@@ -23,6 +23,7 @@
 #include <linux/thermal.h>
 #include <misc/gvotable.h>
 #include "gbms_power_supply.h"
+#include "google_bms.h"
 #include "google_psy.h"
 
 #define USB_OVERHEAT_MITIGATION_VOTER	"USB_OVERHEAT_MITIGATION_VOTER"
@@ -52,7 +53,7 @@ struct overheat_info {
 	struct gvotable_election   *usb_icl_votable;
 	struct gvotable_election   *disable_power_role_switch;
 	struct notifier_block      psy_nb;
-	struct delayed_work        port_overheat_work;
+	struct gbms_delayed_work   port_overheat_work;
 	struct wakeup_source	   *overheat_ws;
 	struct overheat_event_stats stats;
 	struct thermal_cooling_device *cooling_dev;
@@ -353,7 +354,7 @@ static int psy_changed(struct notifier_block *nb, unsigned long action,
 	    !strcmp(psy->desc->name, "usb")) {
 		dev_dbg(ovh_info->dev, "name=usb evt=%lu\n", action);
 		if (!ovh_info->overheat_work_running)
-			schedule_delayed_work(&ovh_info->port_overheat_work, 0);
+			gbms_queue_delayed_work(&ovh_info->port_overheat_work, 0);
 	}
 	return NOTIFY_OK;
 }
@@ -362,7 +363,7 @@ static void port_overheat_work(struct work_struct *work)
 {
 	struct overheat_info *ovh_info =
 			container_of(work, struct overheat_info,
-				     port_overheat_work.work);
+				     port_overheat_work.dwork.work);
 	int ret = 0;
 
 	// Take a wake lock to ensure we poll the temp regularly
@@ -396,8 +397,7 @@ static void port_overheat_work(struct work_struct *work)
 	return;
 
 rerun:
-	schedule_delayed_work(
-			&ovh_info->port_overheat_work,
+	gbms_queue_delayed_work(&ovh_info->port_overheat_work,
 			msecs_to_jiffies(ovh_info->overheat_work_delay_ms));
 }
 
@@ -440,7 +440,7 @@ static int usb_set_cur_state(struct thermal_cooling_device *cooling_dev,
 	if (current_state != state) {
 		dev_info(ovh_info->dev, "usb overheat throttle state=%lu\n",
 			 state);
-		mod_delayed_work(system_wq, &ovh_info->port_overheat_work, 0);
+		gbms_mod_delayed_work(&ovh_info->port_overheat_work, 0);
 	}
 	return 0;
 }
@@ -503,7 +503,8 @@ static int ovh_probe(struct platform_device *pdev)
 				__func__);
 		return -ENODEV;
 	}
-	INIT_DELAYED_WORK(&ovh_info->port_overheat_work, port_overheat_work);
+	gbms_init_delayed_work(&ovh_info->port_overheat_work, port_overheat_work,
+			       GBMS_WQ_SAFETY);
 
 	// register power supply change notifier to update usb metric data
 	ovh_info->psy_nb.notifier_call = psy_changed;
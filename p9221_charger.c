@@ -35,6 +35,7 @@
 
 #define WLC_ALIGNMENT_MAX		100
 #define WLC_CURRENT_FILTER_LENGTH	10
+#define WLC_FREQ_FILTER_LENGTH		4
 #define WLC_ALIGN_DEFAULT_SCALAR	4
 #define WLC_ALIGN_IRQ_THRESHOLD		10
 #define WLC_ALIGN_DEFAULT_HYSTERESIS	5000
@@ -1278,6 +1279,8 @@ static void p9221_init_align(struct p9221_charger_data *charger)
 	charger->alignment_last = -1;
 	charger->current_filtered = 0;
 	charger->current_sample_cnt = 0;
+	charger->freq_filtered = 0;
+	charger->freq_sample_cnt = 0;
 	charger->mfg_check_count = 0;
 	/* Disable misaligned message in high power mode, b/159066422 */
 	if (!charger->online || disabled) {
@@ -1288,9 +1291,77 @@ static void p9221_init_align(struct p9221_charger_data *charger)
 			      msecs_to_jiffies(P9221_ALIGN_DELAY_MS));
 }
 
+/*
+ * Sample op_freq and iout once per align_work: both checks use the filtered
+ * values. op_freq is averaged over WLC_FREQ_FILTER_LENGTH samples to avoid
+ * bouncing between buckets while the phone is moved on the pad.
+ */
+static int p9221_align_sample(struct p9221_charger_data *charger,
+			      bool read_iout)
+{
+	u32 wlc_freq, current_now;
+	int res;
+
+	res = charger->chip_get_op_freq(charger, &wlc_freq);
+	if (res != 0) {
+		logbuffer_log(charger->log, "align: failed to read op_freq");
+		return res;
+	}
+	wlc_freq = P9221_KHZ_TO_HZ(wlc_freq);
+
+	if (charger->freq_sample_cnt < WLC_FREQ_FILTER_LENGTH)
+		charger->freq_sample_cnt++;
+	else
+		charger->freq_filtered -= charger->freq_filtered /
+					  WLC_FREQ_FILTER_LENGTH;
+	charger->freq_filtered += wlc_freq / WLC_FREQ_FILTER_LENGTH;
+	charger->freq_now = wlc_freq;
+
+	if (!read_iout)
+		return 0;
+
+	res = charger->chip_get_iout(charger, &current_now);
+	if (res != 0) {
+		logbuffer_log(charger->log, "align: failed to read IOUT");
+		current_now = 0;
+	}
+
+	if (charger->current_sample_cnt < WLC_CURRENT_FILTER_LENGTH)
+		charger->current_sample_cnt++;
+	else
+		charger->current_filtered -= charger->current_filtered /
+					     WLC_CURRENT_FILTER_LENGTH;
+
+	charger->current_filtered += (current_now / WLC_CURRENT_FILTER_LENGTH);
+	if (charger->log_current_filtered)
+		dev_info(&charger->client->dev, "current = %umA, avg_current = %umA\n",
+			 current_now, charger->current_filtered);
+
+	return 0;
+}
+
+/* filtered frequency until the filter is primed */
+static u32 p9221_align_freq(const struct p9221_charger_data *charger)
+{
+	if (charger->freq_sample_cnt < WLC_FREQ_FILTER_LENGTH)
+		return charger->freq_now;
+
+	return charger->freq_filtered;
+}
+
+/* alignment changes are polled from sysfs, no need for a full uevent */
+static void p9221_align_publish(struct p9221_charger_data *charger, u32 freq)
+{
+	logbuffer_log(charger->log,
+		      "align: alignment=%i. op_freq=%u. current_avg=%u",
+		      charger->alignment, freq, charger->current_filtered);
+	charger->alignment_last = charger->alignment;
+	sysfs_notify(&charger->dev->kobj, NULL, "alignment");
+}
+
 static void p9xxx_align_check(struct p9221_charger_data *charger)
 {
-	int res, wlc_freq_threshold;
+	int wlc_freq_threshold;
 	u32 wlc_freq, current_scaling = 0, current_temp;
 
 	current_temp = (charger->current_filtered > 100) ? (charger->current_filtered - 100) : 0;
@@ -1310,65 +1381,64 @@ static void p9xxx_align_check(struct p9221_charger_data *charger)
 			current_scaling;
 	}
 
-	res = charger->chip_get_op_freq(charger, &wlc_freq);
-	if (res != 0) {
-		logbuffer_log(charger->log, "align: failed to read op_freq");
-		return;
-	}
-	wlc_freq = P9221_KHZ_TO_HZ(wlc_freq);
-
+	wlc_freq = p9221_align_freq(charger);
 	if (wlc_freq < wlc_freq_threshold)
 		charger->alignment = 0;
 	else
 		charger->alignment = 100;
 
-	if (charger->alignment != charger->alignment_last) {
-		logbuffer_log(charger->log,
-			      "align: alignment=%i. op_freq=%u. current_avg=%u",
-			      charger->alignment, wlc_freq,
-			      charger->current_filtered);
-		charger->alignment_last = charger->alignment;
-		schedule_work(&charger->uevent_work);
+	if (charger->alignment != charger->alignment_last)
+		p9221_align_publish(charger, wlc_freq);
+}
+
+/*
+ * bucket i covers (alignment_freq[i], alignment_freq[i + 1]], frequencies
+ * are sorted in DT so this is a binary search.
+ * Returns -ERANGE below range and -EINVAL above range.
+ */
+static int p9221_align_bucket(const struct p9221_charger_platform_data *pdata,
+			      int freq)
+{
+	int lo = 1, hi = pdata->nb_alignment_freq - 1;
+
+	if (freq <= pdata->alignment_freq[0])
+		return -ERANGE;
+	if (freq > pdata->alignment_freq[hi])
+		return -EINVAL;
+
+	while (lo < hi) {
+		const int mid = (lo + hi) / 2;
+
+		if (pdata->alignment_freq[mid] < freq)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+
+	return lo - 1;
 }
 
 static void p9221_align_check(struct p9221_charger_data *charger,
 			      u32 current_scaling)
 {
-	int res, align_buckets, i, wlc_freq_threshold, wlc_adj_freq;
+	int i, wlc_freq_threshold, wlc_adj_freq;
 	u32 wlc_freq;
 
-	res = charger->chip_get_op_freq(charger, &wlc_freq);
-	if (res != 0) {
-		logbuffer_log(charger->log, "align: failed to read op_freq");
-		return;
-	}
-	wlc_freq = P9221_KHZ_TO_HZ(wlc_freq);
-
-	align_buckets = charger->pdata->nb_alignment_freq - 1;
+	wlc_freq = p9221_align_freq(charger);
 
 	charger->alignment = -1;
 	wlc_adj_freq = wlc_freq + current_scaling;
 
-	if (wlc_adj_freq < charger->pdata->alignment_freq[0]) {
+	i = p9221_align_bucket(charger->pdata, wlc_adj_freq);
+	if (i == -ERANGE) {
 		logbuffer_log(charger->log, "align: freq below range");
 		return;
-	}
-
-	for (i = 0; i < align_buckets; i += 1) {
-		if ((wlc_adj_freq > charger->pdata->alignment_freq[i]) &&
-		    (wlc_adj_freq <= charger->pdata->alignment_freq[i + 1])) {
-			charger->alignment = (WLC_ALIGNMENT_MAX * i) /
-					     (align_buckets - 1);
-			break;
-		}
-	}
-
-	if (i >= align_buckets) {
+	} else if (i < 0) {
 		logbuffer_log(charger->log, "align: freq above range");
 		return;
 	}
 
+	charger->alignment = charger->pdata->alignment_score[i];
 	if (charger->alignment == charger->alignment_last)
 		return;
 
@@ -1380,21 +1450,13 @@ static void p9221_align_check(struct p9221_charger_data *charger,
 			     charger->pdata->alignment_hysteresis;
 
 	if ((charger->alignment < charger->alignment_last) ||
-	    (wlc_adj_freq >= wlc_freq_threshold)) {
-		logbuffer_log(charger->log,
-			      "align: alignment=%i. op_freq=%u. current_avg=%u",
-			      charger->alignment, wlc_freq,
-			      charger->current_filtered);
-		charger->alignment_last = charger->alignment;
-		schedule_work(&charger->uevent_work);
-	}
+	    (wlc_adj_freq >= wlc_freq_threshold))
+		p9221_align_publish(charger, wlc_freq);
 }
 
 static void p9221_align_work(struct work_struct *work)
 {
 	int res;
-	u16 current_filter_sample;
-	u32 current_now;
 	u32 current_scaling = 0;
 
 	struct p9221_charger_data *charger = container_of(work,
@@ -1446,28 +1508,12 @@ static void p9221_align_work(struct work_struct *work)
 	if (!p9221_check_feature(charger, WLCF_DREAM_ALIGN))
 		goto align_again;
 
-	if (charger->pdata->alignment_scalar != 0) {
-		res = charger->chip_get_iout(charger, &current_now);
-		if (res != 0) {
-			logbuffer_log(charger->log, "align: failed to read IOUT");
-			current_now = 0;
-		}
-
-		current_filter_sample =
-			charger->current_filtered / WLC_CURRENT_FILTER_LENGTH;
-
-		if (charger->current_sample_cnt < WLC_CURRENT_FILTER_LENGTH)
-			charger->current_sample_cnt++;
-		else
-			charger->current_filtered -= current_filter_sample;
-
-		charger->current_filtered += (current_now / WLC_CURRENT_FILTER_LENGTH);
-		if (charger->log_current_filtered)
-			dev_info(&charger->client->dev, "current = %umA, avg_current = %umA\n",
-				 current_now, charger->current_filtered);
+	res = p9221_align_sample(charger, charger->pdata->alignment_scalar != 0);
+	if (res != 0)
+		goto align_again;
 
+	if (charger->pdata->alignment_scalar != 0)
 		current_scaling = charger->pdata->alignment_scalar * charger->current_filtered;
-	}
 
 	if (charger->chip_id == P9221_CHIP_ID)
 		p9221_align_check(charger, current_scaling);
@@ -1781,6 +1827,48 @@ static int p9221_has_dc_in(struct p9221_charger_data *charger)
 	return prop.intval != 0;
 }
 
+/*
+ * Packed charger state for the charger loop: status tracks the field
+ * (DISCHARGING when no field, NOT_CHARGING in field, CHARGING when online)
+ * and icl the input current limit. vchrg is not reported to avoid a bus
+ * transaction on every charger tick.
+ */
+static int p9221_get_chg_chgr_state(struct p9221_charger_data *charger,
+				    union gbms_charger_state *chg_state)
+{
+	int online, present, icl = 0;
+
+	online = charger->wait_for_online ? 1 : p9221_get_psy_online(charger);
+	present = p9221_has_dc_in(charger);
+
+	chg_state->v = 0;
+	if (online > 0) {
+		chg_state->f.chg_status = POWER_SUPPLY_STATUS_CHARGING;
+		chg_state->f.chg_type = POWER_SUPPLY_CHARGE_TYPE_UNKNOWN;
+	} else {
+		chg_state->f.chg_status = present > 0 ?
+					  POWER_SUPPLY_STATUS_NOT_CHARGING :
+					  POWER_SUPPLY_STATUS_DISCHARGING;
+		chg_state->f.chg_type = POWER_SUPPLY_CHARGE_TYPE_NONE;
+	}
+	chg_state->f.flags = gbms_gen_chg_flags(chg_state->f.chg_status,
+						chg_state->f.chg_type);
+	if (charger->wlc_dc_enabled)
+		chg_state->f.flags |= GBMS_CS_FLAG_DIRECT_CHG;
+
+	if (online <= 0)
+		return 0;
+
+	if (charger->wlc_dc_enabled)
+		icl = charger->wlc_dc_current_now;
+	else if (charger->dc_icl_votable)
+		icl = gvotable_get_current_int_vote(charger->dc_icl_votable);
+	if (icl > 0)
+		chg_state->f.icl = icl / 1000;
+
+	return 0;
+}
+
 static void p9221_charge_stats_init(struct p9221_charge_stats *chg_data)
 {
 	memset(chg_data, 0, sizeof(struct p9221_charge_stats));
@@ -2013,6 +2101,7 @@ static int p9221_get_property(struct power_supply *psy,
 			      union power_supply_propval *val)
 {
 	struct p9221_charger_data *charger = power_supply_get_drvdata(psy);
+	union gbms_charger_state chg_state;
 	int rc, ret = 0;
 	u32 temp;
 
@@ -2161,6 +2250,11 @@ static int p9221_get_property(struct power_supply *psy,
 		if (rc)
 			val->intval = 0;
 		break;
+	case GBMS_PROP_CHARGE_CHARGER_STATE:
+		ret = p9221_get_chg_chgr_state(charger, &chg_state);
+		if (ret == 0)
+			gbms_propval_int64val(val) = chg_state.v;
+		break;
 
 	default:
 		ret = -EINVAL;
@@ -6178,7 +6272,7 @@ static void p9221_uevent_work(struct work_struct *work)
 static int p9221_parse_dt(struct device *dev,
 			  struct p9221_charger_platform_data *pdata)
 {
-	int ret = 0;
+	int ret = 0, i;
 	u32 data;
 	struct device_node *node = dev->of_node;
 	int vout_set_max_mv = P9221_VOUT_SET_MAX_MV;
@@ -6560,10 +6654,32 @@ static int p9221_parse_dt(struct device *dev,
 					 "failed to read google,alignment_frequencies: %d\n",
 					 ret);
 				devm_kfree(dev, pdata->alignment_freq);
+				pdata->alignment_freq = NULL;
 			}
 		}
 	}
 
+	/* score of each bucket, looked up from p9221_align_check() */
+	if (pdata->alignment_freq && pdata->nb_alignment_freq > 1) {
+		const int align_buckets = pdata->nb_alignment_freq - 1;
+
+		pdata->alignment_score = devm_kmalloc_array(dev, align_buckets,
+							    sizeof(int),
+							    GFP_KERNEL);
+		if (!pdata->alignment_score) {
+			devm_kfree(dev, pdata->alignment_freq);
+			pdata->alignment_freq = NULL;
+		}
+
+		for (i = 0; pdata->alignment_score && i < align_buckets; i++)
+			pdata->alignment_score[i] = align_buckets == 1 ?
+				WLC_ALIGNMENT_MAX :
+				(WLC_ALIGNMENT_MAX * i) / (align_buckets - 1);
+	} else if (pdata->alignment_freq) {
+		devm_kfree(dev, pdata->alignment_freq);
+		pdata->alignment_freq = NULL;
+	}
+
 	ret = of_property_read_u32(node, "google,alignment_scalar", &data);
 	if (ret < 0)
 		pdata->alignment_scalar = WLC_ALIGN_DEFAULT_SCALAR;
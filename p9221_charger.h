@@ -643,6 +643,7 @@ struct p9221_charger_platform_data {
 	int				needs_dcin_reset;
 	int				nb_alignment_freq;
 	int				*alignment_freq;
+	int				*alignment_score;
 	u32				alignment_scalar;
 	u32				alignment_hysteresis;
 	u32				icl_ramp_delay_ms;
@@ -801,6 +802,9 @@ struct p9221_charger_data {
 	u32				dc_icl_epp;
 	u32				current_filtered;
 	u32				current_sample_cnt;
+	u32				freq_filtered;
+	u32				freq_sample_cnt;
+	u32				freq_now;
 	bool				log_current_filtered;
 	struct delayed_work		dcin_pon_work;
 	bool				is_mfg_google;
@@ -489,6 +489,29 @@ int pca9468_set_ta_type(struct pca9468_charger *pca9468, int pps_index)
 
 /* GBMS integration ------------------------------------------------------ */
 
+/* Use SW state for now */
+static int pca9468_sw_charge_type(const struct pca9468_charger *pca9468)
+{
+	if (!pca9468->mains_online)
+		return POWER_SUPPLY_CHARGE_TYPE_NONE;
+
+	switch (pca9468->charging_state) {
+	case DC_STATE_ADJUST_CC:
+	case DC_STATE_CC_MODE:
+	case DC_STATE_ADJUST_TAVOL:
+	case DC_STATE_ADJUST_TACUR:
+		return POWER_SUPPLY_CHARGE_TYPE_FAST;
+	case DC_STATE_START_CV:
+	case DC_STATE_CV_MODE:
+		return POWER_SUPPLY_CHARGE_TYPE_TAPER;
+	case DC_STATE_CHECK_ACTIVE: /* in preset */
+	case DC_STATE_CHARGING_DONE:
+		break;
+	}
+
+	return POWER_SUPPLY_CHARGE_TYPE_NONE;
+}
+
 int pca9468_get_charge_type(struct pca9468_charger *pca9468)
 {
 	int ret, sts;
@@ -509,22 +532,7 @@ int pca9468_get_charge_type(struct pca9468_charger *pca9468)
 		 !!(sts & PCA9468_BIT_IIN_LOOP_STS),
 		 pca9468->charging_state);
 
-	/* Use SW state for now */
-	switch (pca9468->charging_state) {
-	case DC_STATE_ADJUST_CC:
-	case DC_STATE_CC_MODE:
-	case DC_STATE_ADJUST_TAVOL:
-	case DC_STATE_ADJUST_TACUR:
-		return POWER_SUPPLY_CHARGE_TYPE_FAST;
-	case DC_STATE_START_CV:
-	case DC_STATE_CV_MODE:
-		return POWER_SUPPLY_CHARGE_TYPE_TAPER;
-	case DC_STATE_CHECK_ACTIVE: /* in preset */
-	case DC_STATE_CHARGING_DONE:
-		break;
-	}
-
-	return POWER_SUPPLY_CHARGE_TYPE_NONE;
+	return pca9468_sw_charge_type(pca9468);
 }
 
 #define PCA9468_NOT_CHARGING \
@@ -533,18 +541,16 @@ int pca9468_get_charge_type(struct pca9468_charger *pca9468)
 	(PCA9468_BIT_CHG_LOOP_STS | PCA9468_BIT_IIN_LOOP_STS | \
 	PCA9468_BIT_VFLT_LOOP_STS)
 
-int pca9468_get_status(struct pca9468_charger *pca9468)
+/* read INT1_STS..STS_D in val[PCA9468_REG_INT1_STS..PCA9468_REG_STS_D] */
+static int pca9468_read_sts(struct pca9468_charger *pca9468, u8 *val)
 {
-	u8 val[8];
-	int ret;
-
-	ret = regmap_bulk_read(pca9468->regmap, PCA9468_REG_INT1_STS,
-			       &val[PCA9468_REG_INT1_STS], 5);
-	if (ret < 0) {
-		pr_debug("%s: ioerr=%d", __func__, ret);
-		return POWER_SUPPLY_STATUS_UNKNOWN;
-	}
+	return regmap_bulk_read(pca9468->regmap, PCA9468_REG_INT1_STS,
+				&val[PCA9468_REG_INT1_STS], 5);
+}
 
+static int pca9468_sts_to_status(const struct pca9468_charger *pca9468,
+				 const u8 *val)
+{
 	pr_debug("%s: int1_sts=0x%x,sts_a=0x%x,sts_b=0x%x,sts_c=0x%x,sts_d=0x%x\n",
 		 __func__,  val[3], val[4], val[5], val[6], val[7]);
 
@@ -579,6 +585,20 @@ int pca9468_get_status(struct pca9468_charger *pca9468)
 	return POWER_SUPPLY_STATUS_UNKNOWN;
 }
 
+int pca9468_get_status(struct pca9468_charger *pca9468)
+{
+	u8 val[8];
+	int ret;
+
+	ret = pca9468_read_sts(pca9468, val);
+	if (ret < 0) {
+		pr_debug("%s: ioerr=%d", __func__, ret);
+		return POWER_SUPPLY_STATUS_UNKNOWN;
+	}
+
+	return pca9468_sts_to_status(pca9468, val);
+}
+
 #define PCA9468_PRESENT_MASK \
 	(PCA9468_BIT_ACTIVE_STATE_STS | PCA9468_BIT_STANDBY_STATE_STS)
 
@@ -590,14 +610,22 @@ int pca9468_is_present(struct pca9468_charger *pca9468)
 	return !!(sts & PCA9468_PRESENT_MASK);
 }
 
+/* status and charge type from a single read of the status registers */
 int pca9468_get_chg_chgr_state(struct pca9468_charger *pca9468,
 				      union gbms_charger_state *chg_state)
 {
-	int vchrg;
+	int vchrg, ret;
+	u8 val[8];
 
 	chg_state->v = 0;
-	chg_state->f.chg_status = pca9468_get_status(pca9468);
-	chg_state->f.chg_type = pca9468_get_charge_type(pca9468);
+	ret = pca9468_read_sts(pca9468, val);
+	if (ret < 0) {
+		pr_debug("%s: ioerr=%d", __func__, ret);
+		chg_state->f.chg_status = POWER_SUPPLY_STATUS_UNKNOWN;
+	} else {
+		chg_state->f.chg_status = pca9468_sts_to_status(pca9468, val);
+	}
+	chg_state->f.chg_type = pca9468_sw_charge_type(pca9468);
 	chg_state->f.flags = gbms_gen_chg_flags(chg_state->f.chg_status,
 						chg_state->f.chg_type);
 	chg_state->f.flags |= GBMS_CS_FLAG_DIRECT_CHG;